@@ -0,0 +1,185 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 06:30
+ *
+ * The Old Implementations, for the Microbenchmarks to Beat
+ *
+ * These are the way things were before they got replaced, kept as close to
+ * the originals as possible (bugs that'd break the comparison aside), so
+ * the microbenchmarks always have the "before" to put next to the "after".
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "legacy.h"
+
+static int legacy_matchhere(char *regexp, char *text);
+static int legacy_matchstar(int c, char *regexp, char *text);
+static int legacy_url_encode_byte(unsigned char in);
+
+/* legacy_frame : the old irc_handle_data loop, a byte at a time into servbuf */
+int legacy_frame(char *data, int len, char *servbuf, int buflen,
+		legacy_line_t func, void *arg)
+{
+	int i, bufidx, n;
+
+	bufidx = 0;
+	n = 0;
+
+	for (i = 0; i < len; i++) {
+		switch (data[i]) {
+		case '\r':
+		case '\n':
+			servbuf[bufidx] = '\0';
+
+			if (strlen(servbuf) != 0) {
+				func(servbuf, arg);
+				n++;
+			}
+
+			bufidx = 0;
+			break;
+
+		default:
+			servbuf[bufidx] = data[i];
+			if (bufidx < buflen - 1)
+				bufidx++;
+		}
+	}
+
+	return n;
+}
+
+/* legacy_re_match : the backtracking matcher from "The Practice of Programming" */
+int legacy_re_match(char *regexp, char *text)
+{
+	if (regexp[0] == '^') {
+		return legacy_matchhere(regexp + 1, text);
+	}
+
+	do {
+		if (legacy_matchhere(regexp, text))
+			return 1;
+	} while (*text++ != '\0');
+
+	return 0;
+}
+
+/* legacy_matchhere : search for regex at the beginning of text */
+static int legacy_matchhere(char *regexp, char *text)
+{
+	if (regexp[0] == '\0')
+		return 1;
+
+	if (regexp[1] == '*')
+		return legacy_matchstar(regexp[0], regexp + 2, text);
+
+	if (regexp[0] == '$' && regexp[1] == '\0')
+		return *text == '\0';
+
+	if (*text != '\0' && (regexp[0] == '.' || regexp[0] == *text))
+		return legacy_matchhere(regexp + 1, text + 1);
+	return 0;
+}
+
+/* legacy_matchstar : recursively match a star character */
+static int legacy_matchstar(int c, char *regexp, char *text)
+{
+	do {
+		if (legacy_matchhere(regexp, text))
+			return 1;
+	} while (*text != '\0' && (*text++ == c || c == '.'));
+
+	return 0;
+}
+
+/* legacy_getline : the old fio_getline, rewinds and reads up to the line */
+int legacy_getline(FILE *fp, char *buf, int buflen, int line)
+{
+	char *ptr;
+	int curr;
+	char tmpbuf[256];
+
+	if (!fp)
+		return -1;
+
+	rewind(fp);
+	curr = 0;
+
+	while ((ptr = fgets(tmpbuf, sizeof(tmpbuf), fp)) == tmpbuf) {
+		if (curr++ == line)
+			break;
+	}
+
+	if (ptr == tmpbuf) {
+		curr = strlen(tmpbuf);
+		memcpy(buf, tmpbuf, curr > buflen ? buflen : curr);
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* legacy_url_encode : the old encoder, a strlen and snprintf every byte */
+int legacy_url_encode(char *buf, int buflen, char *src, char *prefix)
+{
+	int len;
+
+	snprintf(buf, buflen, "%s", prefix); /* plop the query prefix first */
+
+	/* then encode the rest of the URL */
+	for (len = strlen(buf); len < buflen && *src; src++, len = strlen(buf)) {
+		if (legacy_url_encode_byte(*src)) { /* encoding */
+			snprintf(buf + len, buflen-len, "%%%02x", *src);
+		} else { /* no encoding */
+			snprintf(buf + len, buflen-len, "%c", *src);
+		}
+	}
+
+	if (*src != '\0') {
+		return -1; /* couldn't encode the url, not enough space */
+	}
+
+	return 0;
+}
+
+/* legacy_url_encode_byte : determine if this byte needs to be encoded */
+static int legacy_url_encode_byte(unsigned char in)
+{
+	int rc;
+
+	rc = 1; /* assume we're going to encode it */
+
+	if (isdigit(in) || isalpha(in)) {
+		rc = 0;
+	}
+
+	switch (in) {
+	case '+':
+	case '/':
+	case '&':
+	case '=':
+		rc = 0;
+		break;
+	default:
+		break;
+	}
+
+	return rc;
+}
+
+/* legacy_lookup : the old command search, strcmp down the table */
+struct ircfunc_t *legacy_lookup(struct ircfunc_t *funcs, int n, char *name)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (strcmp(funcs[i].command, name) == 0)
+			return &funcs[i];
+	}
+
+	return NULL;
+}
@@ -0,0 +1,24 @@
+#ifndef LEGACY_H
+#define LEGACY_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 06:30
+ *
+ * The Old Implementations, for the Microbenchmarks to Beat
+ */
+
+#include <stdio.h>
+
+#include "botcmd.h"
+
+typedef void (*legacy_line_t)(char *line, void *arg);
+
+int legacy_frame(char *data, int len, char *servbuf, int buflen,
+		legacy_line_t func, void *arg);
+int legacy_re_match(char *regexp, char *text);
+int legacy_getline(FILE *fp, char *buf, int buflen, int line);
+int legacy_url_encode(char *buf, int buflen, char *src, char *prefix);
+struct ircfunc_t *legacy_lookup(struct ircfunc_t *funcs, int n, char *name);
+
+#endif
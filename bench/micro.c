@@ -0,0 +1,1093 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 06:30
+ *
+ * Microbenchmarks
+ *
+ * USAGE: micro [-l] [-c filter] [-r reps]
+ *
+ * Times the hot little pieces of the bot on their own: framing, parsing,
+ * command lookup, the regex engines, url encoding, the string helpers,
+ * logging, line lookups, channel tracking, rate limiting, the send queue
+ * and handling a PRIVMSG end to end. Where something replaced an older version, the
+ * old one (bench/legacy.c) runs right next to it on the same input.
+ *
+ * Every case gets calibrated until one repetition takes MB_MINRUN_NS, warmed
+ * up for MB_WARMUP repetitions, then timed for -r more. Output is one
+ * "micro.<case>.<stat>=<value>" per line, the same as tools/fakeircd, so
+ * it diffs and greps well between runs.
+ *
+ * It's built with the same FLAGS as the bot, so the numbers are for the code
+ * that actually ships, old and new alike.
+ *
+ * Every case also reports the heap allocations the bot's own code made per
+ * op. The Makefile links this with --wrap for malloc, calloc and realloc,
+ * so only calls from our objects get counted, not libc's.
+ *
+ * Cycles come from a perf_event_open counter where the kernel lets us have
+ * one, the TSC where it won't (which ticks at a constant rate, not the
+ * core's), and otherwise there aren't any cycle numbers.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "common.h"
+#include "frame.h"
+#include "ircmsg.h"
+#include "botcmd.h"
+#include "regex.h"
+#include "stringext.h"
+#include "fio.h"
+#include "chans.h"
+#include "irc.h"
+#include "pool.h"
+#include "ratelimit.h"
+#include "wheel.h"
+
+#include "legacy.h"
+
+#define MB_MINRUN_NS 10000000ULL /* calibrate repetitions to at least this */
+#define MB_WARMUP    3
+#define MB_REPS      15
+#define MB_MAXREPS   101
+
+#define MB_CORPUS    (1 << 20) /* bytes of server traffic to frame */
+#define MB_LINES     2000000   /* lines in the file for the getline cases */
+#define MB_BUFSIZE   1024
+#define MB_CHANS     10000     /* channels and users the chans cases track */
+#define MB_USERS     500000
+#define MB_PERUSER   5         /* channels each of those users is in */
+#define MB_HOSTS     100000    /* distinct hosts hitting the rate limiter */
+#define MB_SQLINES   20        /* PRIVMSGs per op in the sendq case, more than the pipe holds */
+#define MB_PIPESIZE  4096
+#define MB_TIMERS    1000000   /* timers pending in the wheel cases */
+#define MB_TIMERSPAN 3600000   /* spread over the next this many ms */
+
+struct mb_case_t {
+	char *name;
+	void (*setup)(void);
+	void (*run)(long n);
+	long bytes; /* bytes one op works through, 0 if that doesn't mean much */
+};
+
+enum {
+	MB_CYC_NONE,
+	MB_CYC_PERF,
+	MB_CYC_TSC
+};
+
+static void mb_usage(char *prog);
+static int mb_bench(struct mb_case_t *c, int reps);
+static uint64_t mb_now(void);
+static int mb_cycinit(void);
+static uint64_t mb_cycles(void);
+static int mb_cmp(const void *a, const void *b);
+
+static void mb_setup_corpus(void);
+static void mb_setup_regex(void);
+static void mb_setup_fio(void);
+static void mb_setup_file(void);
+static void mb_setup_chans(void);
+static void mb_setup_irc(void);
+static void mb_setup_wheel(void);
+static void mb_setup_sendq(void);
+
+static void mb_frame(long n);
+static void mb_frame_legacy(long n);
+static void mb_parse(long n);
+static void mb_lookup(long n);
+static void mb_lookup_1k(long n);
+static void mb_lookup_1k_legacy(long n);
+static void mb_regex_exec(long n);
+static void mb_regex_match(long n);
+static void mb_regex_legacy(long n);
+static void mb_regex_patho(long n);
+static void mb_regex_patho_legacy(long n);
+static void mb_url_short(long n);
+static void mb_url_long(long n);
+static void mb_url_long_legacy(long n);
+static void mb_strisupper(long n);
+static void mb_bstrtok(long n);
+static void mb_fio_printf(long n);
+static void mb_fio_printf_off(long n);
+static void mb_getline(long n);
+static void mb_getline_legacy(long n);
+static void mb_chans_ison(long n);
+static void mb_chans_partjoin(long n);
+static void mb_chans_nick(long n);
+static void mb_privmsg(long n);
+static void mb_privmsg_pool(long n);
+static void mb_sendq_short(long n);
+static void mb_ratelimit(long n);
+static void mb_wheel_rearm(long n);
+static void mb_wheel_advance(long n);
+static void mb_wheel_fire(tw_t *tw, tw_timer_t *t, void *arg);
+
+/* the synthetic 1000 command table, see the Makefile */
+extern struct ircfunc_t mbbigfuncs[];
+extern int mbbigfuncs_len;
+struct ircfunc_t *mbbigfunc_lookup(const char *name, int len);
+
+/* results go here, so the compiler can't throw the work away */
+static volatile uint64_t mb_sink;
+
+/* our own copy of stdout, the log writer echoes everything onto fd 1 */
+static FILE *mb_out;
+
+/* heap allocations from our code, see __wrap_malloc */
+static _Atomic unsigned long mb_allocs;
+
+static int mb_cycsrc;
+static int mb_perffd = -1;
+
+static char *mb_samples[] = {
+	":nick!user@host.example.com PRIVMSG #channel :hey, has anyone seen the build break?",
+	"PING :irc.example.net",
+	":irc.example.net 353 bot = #channel :@op +voice alice bob carol dave erin frank",
+	"@time=2026-10-18T06:30:00.000Z;msgid=abc123 :alice!a@b PRIVMSG #c :!google bread",
+	":bob!bob@10.0.0.1 JOIN #channel",
+	":irc.example.net 001 bot :Welcome to the Internet Relay Network bot!bot@host",
+	":carol!c@example.org QUIT :Ping timeout: 240 seconds",
+	":dave!d@example.org PRIVMSG #channel :WHY IS EVERYTHING ON FIRE",
+};
+
+#define MB_NSAMPLES ((int)(sizeof(mb_samples) / sizeof(mb_samples[0])))
+
+static char *mb_names[] = {
+	"help", "ping", "smack", "google", "8ball", "wiki", "g", "nope",
+};
+
+#define MB_NNAMES ((int)(sizeof(mb_names) / sizeof(mb_names[0])))
+
+static char mb_text[] =
+	"the quick brown fox jumps over the lazy dog, and then does it again "
+	"because nobody told it to stop, which is how most bots end up in the "
+	"channel at three in the morning printing the same line over and over";
+
+static char mb_shout[] =
+	"WHY IS THE BUILD BROKEN AGAIN, WHO PUSHED ON A FRIDAY AFTERNOON, AND WHY "
+	"DOES THE BOT KEEP SAYING THE SAME THING EVERY TIME SOMEBODY TYPES IN CAPS "
+	"LIKE THIS, IT IS NOT HELPING ANYONE, NOT EVEN A LITTLE BIT, PLEASE STOP";
+
+static char mb_url_s[] = "how do i exit vim";
+static char mb_url_l[1500];
+static char mb_patho[] = "aaaaaaaaaaaaaaaaaaaaaaaa";
+
+static char *mb_corpus;
+static int mb_corpuslen;
+static re_t mb_re;
+static re_t mb_re_patho;
+static FILE *mb_fp;
+static char mb_path[] = "/tmp/microXXXXXX";
+static chans_t mb_chans;
+static char (*mb_chan)[16];
+static char (*mb_nick)[16];
+static irc_t mb_irc;      /* answers inline, into /dev/null */
+static irc_t mb_ircpool;  /* hands everything to mb_pool */
+static pool_t mb_pool;
+static rl_t mb_rl;
+static tw_t mb_tw;
+static int mb_sqpipe[2] = {-1, -1};
+static char mb_sqline[300];
+static char mb_sqctrl[] = "PONG :irc.example.com\r\n";
+static tw_timer_t *mb_timers;
+static char mb_cmdline[] = ":nick!user@host.example.com PRIVMSG #channel :!ping";
+static char mb_chatline[] =
+	":nick!user@host.example.com PRIVMSG #channel :hey, has anyone seen the build break?";
+
+static struct mb_case_t mb_cases[] = {
+	{"frame",               mb_setup_corpus, mb_frame,              MB_CORPUS},
+	{"frame_legacy",        mb_setup_corpus, mb_frame_legacy,       MB_CORPUS},
+	{"ircmsg_parse",        NULL,            mb_parse,              0},
+	{"cmd_lookup",          NULL,            mb_lookup,             0},
+	{"cmd_lookup_1k",       NULL,            mb_lookup_1k,          0},
+	{"cmd_lookup_1k_legacy", NULL,           mb_lookup_1k_legacy,   0},
+	{"re_exec",             mb_setup_regex,  mb_regex_exec,         sizeof(mb_text) - 1},
+	{"re_match",            NULL,            mb_regex_match,        sizeof(mb_text) - 1},
+	{"re_match_legacy",     NULL,            mb_regex_legacy,       sizeof(mb_text) - 1},
+	{"re_patho",            mb_setup_regex,  mb_regex_patho,        sizeof(mb_patho) - 1},
+	{"re_patho_legacy",     NULL,            mb_regex_patho_legacy, sizeof(mb_patho) - 1},
+	{"url_encode_short",    NULL,            mb_url_short,          sizeof(mb_url_s) - 1},
+	{"url_encode_long",     NULL,            mb_url_long,           sizeof(mb_url_l) - 1},
+	{"url_encode_long_legacy", NULL,         mb_url_long_legacy,    sizeof(mb_url_l) - 1},
+	{"strisupper",          NULL,            mb_strisupper,         sizeof(mb_shout) - 1},
+	{"bstrtok",             NULL,            mb_bstrtok,            sizeof(mb_text) - 1},
+	{"fio_printf",          mb_setup_fio,    mb_fio_printf,         0},
+	{"fio_printf_off",      mb_setup_fio,    mb_fio_printf_off,     0},
+	{"fio_getline",         mb_setup_file,   mb_getline,            0},
+	{"fio_getline_legacy",  mb_setup_file,   mb_getline_legacy,     0},
+	{"chans_ison",          mb_setup_chans,  mb_chans_ison,         0},
+	{"chans_partjoin",      mb_setup_chans,  mb_chans_partjoin,     0},
+	{"chans_nick",          mb_setup_chans,  mb_chans_nick,         0},
+	{"irc_privmsg",         mb_setup_irc,    mb_privmsg,            0},
+	{"irc_privmsg_pool",    mb_setup_irc,    mb_privmsg_pool,       0},
+	{"sendq_short",         mb_setup_sendq,  mb_sendq_short,        0},
+	{"ratelimit",           NULL,            mb_ratelimit,          0},
+	{"wheel_rearm",         mb_setup_wheel,  mb_wheel_rearm,        0},
+	{"wheel_advance",       mb_setup_wheel,  mb_wheel_advance,      0},
+};
+
+#define MB_NCASES ((int)(sizeof(mb_cases) / sizeof(mb_cases[0])))
+
+int main(int argc, char **argv)
+{
+	char *filter;
+	int i, c, reps, list;
+
+	filter = NULL;
+	reps = MB_REPS;
+	list = 0;
+
+	while ((c = getopt(argc, argv, "lc:r:")) != -1) {
+		switch (c) {
+		case 'l':
+			list = 1;
+			break;
+		case 'c':
+			filter = optarg;
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		default:
+			mb_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (reps < 1 || reps > MB_MAXREPS) {
+		fprintf(stderr, "%s: reps has to be between 1 and %d\n",
+				argv[0], MB_MAXREPS);
+		return 1;
+	}
+
+	if (!(mb_out = fdopen(dup(STDOUT_FILENO), "w"))) {
+		perror("dup");
+		return 1;
+	}
+
+	if (list) {
+		for (i = 0; i < MB_NCASES; i++)
+			fprintf(mb_out, "%s\n", mb_cases[i].name);
+		return 0;
+	}
+
+	mb_cycsrc = mb_cycinit();
+	fprintf(mb_out, "micro.cycles_source=%s\n", mb_cycsrc == MB_CYC_PERF ? "perf" :
+			mb_cycsrc == MB_CYC_TSC ? "tsc" : "none");
+
+	for (i = 0; i < MB_NCASES; i++) {
+		if (filter && !strstr(mb_cases[i].name, filter))
+			continue;
+
+		if (mb_bench(&mb_cases[i], reps) < 0)
+			return 1;
+
+		fflush(mb_out);
+	}
+
+	if (mb_fp) {
+		fclose(mb_fp);
+		unlink(mb_path);
+	}
+
+	fio_closefp();
+
+	if (mb_perffd >= 0)
+		close(mb_perffd);
+
+	return 0;
+}
+
+/* mb_usage : prints out how to run us */
+static void mb_usage(char *prog)
+{
+	fprintf(stderr, "USAGE: %s [-l] [-c filter] [-r reps]\n", prog);
+	fprintf(stderr, "\t-l         list the cases and exit\n");
+	fprintf(stderr, "\t-c filter  only run cases with filter in the name\n");
+	fprintf(stderr, "\t-r reps    timed repetitions per case (default %d)\n",
+			MB_REPS);
+}
+
+/* mb_bench : calibrates, warms up, times and reports one case */
+static int mb_bench(struct mb_case_t *c, int reps)
+{
+	double ns[MB_MAXREPS], cyc[MB_MAXREPS];
+	unsigned long allocs;
+	uint64_t t, cy;
+	long n;
+	int i;
+
+	if (c->setup)
+		c->setup();
+
+	/* double the ops per repetition until it runs long enough to time */
+	for (n = 1;; n *= 2) {
+		t = mb_now();
+		c->run(n);
+		t = mb_now() - t;
+
+		if (t >= MB_MINRUN_NS || n >= (1L << 40))
+			break;
+	}
+
+	for (i = 0; i < MB_WARMUP; i++)
+		c->run(n);
+
+	allocs = atomic_load(&mb_allocs);
+
+	for (i = 0; i < reps; i++) {
+		cy = mb_cycles();
+		t = mb_now();
+		c->run(n);
+		t = mb_now() - t;
+		cy = mb_cycles() - cy;
+
+		ns[i] = (double)t / n;
+		cyc[i] = (double)cy / n;
+	}
+
+	allocs = atomic_load(&mb_allocs) - allocs;
+
+	qsort(ns, reps, sizeof(ns[0]), mb_cmp);
+	qsort(cyc, reps, sizeof(cyc[0]), mb_cmp);
+
+	fprintf(mb_out, "micro.%s.ops_per_rep=%ld\n", c->name, n);
+	fprintf(mb_out, "micro.%s.ns_min=%.2f\n", c->name, ns[0]);
+	fprintf(mb_out, "micro.%s.ns_p50=%.2f\n", c->name, ns[reps / 2]);
+	fprintf(mb_out, "micro.%s.ns_p90=%.2f\n", c->name, ns[(reps * 9) / 10]);
+	fprintf(mb_out, "micro.%s.ns_max=%.2f\n", c->name, ns[reps - 1]);
+
+	if (mb_cycsrc != MB_CYC_NONE)
+		fprintf(mb_out, "micro.%s.cycles_p50=%.1f\n", c->name, cyc[reps / 2]);
+
+	fprintf(mb_out, "micro.%s.allocs_per_op=%.3f\n", c->name,
+			(double)allocs / ((double)n * reps));
+
+	if (c->bytes) {
+		fprintf(mb_out, "micro.%s.bytes=%ld\n", c->name, c->bytes);
+		fprintf(mb_out, "micro.%s.mb_s=%.1f\n", c->name,
+				c->bytes / ns[reps / 2] * 1e9 / (1 << 20));
+		if (mb_cycsrc != MB_CYC_NONE)
+			fprintf(mb_out, "micro.%s.cpb_p50=%.3f\n", c->name,
+					cyc[reps / 2] / c->bytes);
+	}
+
+	return 0;
+}
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+/* __wrap_malloc : malloc, counted, the linker points our calls here */
+void *__wrap_malloc(size_t n)
+{
+	atomic_fetch_add_explicit(&mb_allocs, 1, memory_order_relaxed);
+	return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	atomic_fetch_add_explicit(&mb_allocs, 1, memory_order_relaxed);
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t n)
+{
+	atomic_fetch_add_explicit(&mb_allocs, 1, memory_order_relaxed);
+	return __real_realloc(p, n);
+}
+
+/* mb_now : monotonic nanoseconds */
+static uint64_t mb_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* mb_cycinit : opens a cycle counter, returns which kind we ended up with */
+static int mb_cycinit(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	mb_perffd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+	if (mb_perffd >= 0) {
+		ioctl(mb_perffd, PERF_EVENT_IOC_ENABLE, 0);
+		return MB_CYC_PERF;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	return MB_CYC_TSC;
+#else
+	return MB_CYC_NONE;
+#endif
+}
+
+/* mb_cycles : reads whichever cycle counter we've got */
+static uint64_t mb_cycles(void)
+{
+	uint64_t v;
+
+	if (mb_cycsrc == MB_CYC_PERF) {
+		if (read(mb_perffd, &v, sizeof(v)) != sizeof(v))
+			return 0;
+		return v;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (mb_cycsrc == MB_CYC_TSC)
+		return __rdtsc();
+#endif
+
+	return 0;
+}
+
+/* mb_cmp : qsort comparator for doubles */
+static int mb_cmp(const void *a, const void *b)
+{
+	double x, y;
+
+	x = *(const double *)a;
+	y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* mb_setup_corpus : a megabyte of server lines, CRLF terminated */
+static void mb_setup_corpus(void)
+{
+	int i, len;
+
+	if (mb_corpus)
+		return;
+
+	mb_corpus = malloc(MB_CORPUS);
+
+	for (i = 0; mb_corpuslen < MB_CORPUS; i++) {
+		len = strlen(mb_samples[i % MB_NSAMPLES]);
+		if (mb_corpuslen + len + 2 > MB_CORPUS)
+			break;
+
+		memcpy(mb_corpus + mb_corpuslen, mb_samples[i % MB_NSAMPLES], len);
+		mb_corpuslen += len;
+		mb_corpus[mb_corpuslen++] = '\r';
+		mb_corpus[mb_corpuslen++] = '\n';
+	}
+
+	/* pad the tail out with blank lines, so every case sees MB_CORPUS */
+	while (mb_corpuslen < MB_CORPUS)
+		mb_corpus[mb_corpuslen++] = '\n';
+}
+
+/* mb_setup_regex : compiles the patterns the re_exec cases hang on to */
+static void mb_setup_regex(void)
+{
+	static int done;
+
+	if (done)
+		return;
+
+	re_compile(&mb_re, "th.*ing", 0);
+	re_compile(&mb_re_patho, "a*a*a*a*a*a*a*b", 0);
+	done = 1;
+}
+
+/* mb_setup_fio : points the log at /dev/null, the writer thread still runs */
+static void mb_setup_fio(void)
+{
+	FILE *fp;
+	int fd;
+
+	if (fio_getstaticfp())
+		return;
+
+	if ((fd = open("/dev/null", O_WRONLY)) >= 0) {
+		dup2(fd, STDOUT_FILENO);
+		close(fd);
+	}
+
+	if ((fp = fopen("/dev/null", "w")))
+		fio_setfp(fp);
+}
+
+/* mb_setup_file : writes out a big file of chat for the getline cases */
+static void mb_setup_file(void)
+{
+	int fd, i;
+
+	if (mb_fp)
+		return;
+
+	if ((fd = mkstemp(mb_path)) < 0 || !(mb_fp = fdopen(fd, "w+"))) {
+		perror("mkstemp");
+		exit(1);
+	}
+
+	for (i = 0; i < MB_LINES; i++)
+		fprintf(mb_fp, "%d %s\n", i, mb_samples[i % MB_NSAMPLES]);
+
+	fflush(mb_fp);
+}
+
+/* mb_mchan : the kth channel user u is in */
+static int mb_mchan(int u, int k)
+{
+	return (u + k * 7919) % MB_CHANS;
+}
+
+/* mb_setup_chans : MB_USERS users spread over MB_CHANS channels */
+static void mb_setup_chans(void)
+{
+	int i, k;
+
+	if (mb_chan)
+		return;
+
+	mb_chan = malloc(MB_CHANS * sizeof(*mb_chan));
+	mb_nick = malloc(MB_USERS * sizeof(*mb_nick));
+
+	for (i = 0; i < MB_CHANS; i++)
+		snprintf(mb_chan[i], sizeof(mb_chan[i]), "#Chan%d", i);
+	for (i = 0; i < MB_USERS; i++)
+		snprintf(mb_nick[i], sizeof(mb_nick[i]), "Nick[%d]", i);
+
+	ch_init(&mb_chans);
+
+	for (i = 0; i < MB_USERS; i++) {
+		for (k = 0; k < MB_PERUSER; k++) {
+			ch_join(&mb_chans, mb_chan[mb_mchan(i, k)],
+					strlen(mb_chan[mb_mchan(i, k)]),
+					mb_nick[i], strlen(mb_nick[i]));
+		}
+	}
+}
+
+/* mb_setup_irc : two registered connections, writing into /dev/null */
+static void mb_setup_irc(void)
+{
+	irc_t *ircs[] = {&mb_irc, &mb_ircpool};
+	int i;
+
+	if (mb_irc.s > 0)
+		return;
+
+	mb_setup_fio();
+
+	for (i = 0; i < ARRSIZE(ircs); i++) {
+		irc_init(ircs[i]);
+		ircs[i]->s = open("/dev/null", O_WRONLY);
+		ircs[i]->state = IRC_UP;
+		ircs[i]->iothread = pthread_self();
+		snprintf(ircs[i]->nick, sizeof(ircs[i]->nick), "bot");
+		sq_setpace(&ircs[i]->sq, 0, 0);
+	}
+
+	pool_init(&mb_pool, POOL_WORKERS);
+	mb_ircpool.pool = &mb_pool;
+
+	/* the rate limits would have the same sender answered 5 times, tops */
+	irc_bot_admin_add("nick");
+}
+
+/* mb_line : counts lines the legacy framer hands back */
+static void mb_line(char *line, void *arg)
+{
+	(*(long *)arg) += line[0];
+}
+
+static void mb_frame(long n)
+{
+	static frame_t fr; /* too big for the stack, and not worth a malloc */
+	frame_t *f;
+	slice_t line;
+	char *p;
+	long i, sum;
+	int off, len;
+
+	f = &fr;
+	sum = 0;
+
+	for (i = 0; i < n; i++) {
+		frm_init(f);
+
+		/* the same 4K chunks a read off the socket would hand us */
+		for (off = 0; off < mb_corpuslen; off += len) {
+			p = frm_space(f, &len);
+			if (len > 4096)
+				len = 4096;
+			if (len > mb_corpuslen - off)
+				len = mb_corpuslen - off;
+
+			memcpy(p, mb_corpus + off, len);
+			frm_commit(f, len);
+
+			while (frm_next(f, &line))
+				sum += line.ptr[0];
+		}
+	}
+
+	mb_sink += sum;
+}
+
+static void mb_frame_legacy(long n)
+{
+	char servbuf[MB_BUFSIZE];
+	long i, sum;
+	int off, len;
+
+	sum = 0;
+
+	for (i = 0; i < n; i++) {
+		for (off = 0; off < mb_corpuslen; off += len) {
+			len = mb_corpuslen - off < 4096 ? mb_corpuslen - off : 4096;
+			legacy_frame(mb_corpus + off, len, servbuf, sizeof(servbuf),
+					mb_line, &sum);
+		}
+	}
+
+	mb_sink += sum;
+}
+
+static void mb_parse(long n)
+{
+	ircmsg_t msg;
+	long i;
+	int len;
+
+	/* ircmsg_parse only points into the line, so the samples can be reused */
+	for (i = 0; i < n; i++) {
+		len = strlen(mb_samples[i % MB_NSAMPLES]);
+		ircmsg_parse(&msg, mb_samples[i % MB_NSAMPLES], len);
+		mb_sink += msg.nparams;
+	}
+}
+
+static void mb_lookup(long n)
+{
+	long i;
+	char *s;
+
+	for (i = 0; i < n; i++) {
+		s = mb_names[i % MB_NNAMES];
+		mb_sink += (uintptr_t)ircfunc_lookup(s, strlen(s));
+	}
+}
+
+static void mb_lookup_1k(long n)
+{
+	char buf[32];
+	long i;
+	int len;
+
+	for (i = 0; i < n; i++) {
+		/* every 8th one misses, like somebody fat fingering a command */
+		len = snprintf(buf, sizeof(buf), i % 8 ? "cmd%ld" : "nocmd%ld",
+				(i * 7919) % 1000);
+		mb_sink += (uintptr_t)mbbigfunc_lookup(buf, len);
+	}
+}
+
+static void mb_lookup_1k_legacy(long n)
+{
+	char buf[32];
+	long i;
+
+	for (i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), i % 8 ? "cmd%ld" : "nocmd%ld",
+				(i * 7919) % 1000);
+		mb_sink += (uintptr_t)legacy_lookup(mbbigfuncs, mbbigfuncs_len, buf);
+	}
+}
+
+static void mb_regex_exec(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += re_exec(&mb_re, mb_text, sizeof(mb_text) - 1);
+}
+
+static void mb_regex_match(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += re_match("th.*ing", mb_text);
+}
+
+static void mb_regex_legacy(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += legacy_re_match("th.*ing", mb_text);
+}
+
+static void mb_regex_patho(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += re_exec(&mb_re_patho, mb_patho, sizeof(mb_patho) - 1);
+}
+
+static void mb_regex_patho_legacy(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += legacy_re_match("a*a*a*a*a*a*a*b", mb_patho);
+}
+
+static void mb_url_short(long n)
+{
+	char buf[MB_BUFSIZE];
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += url_encode(buf, sizeof(buf), mb_url_s,
+				sizeof(mb_url_s) - 1, URL_FORM);
+}
+
+/* mb_url_fill : a long argument, the text over and over */
+static void mb_url_fill(void)
+{
+	int j;
+
+	if (mb_url_l[0])
+		return;
+
+	for (j = 0; j < sizeof(mb_url_l) - 1; j++)
+		mb_url_l[j] = mb_text[j % (sizeof(mb_text) - 1)];
+}
+
+static void mb_url_long(long n)
+{
+	char buf[MB_BUFSIZE * 8];
+	long i;
+
+	mb_url_fill();
+
+	for (i = 0; i < n; i++)
+		mb_sink += url_encode(buf, sizeof(buf), mb_url_l,
+				sizeof(mb_url_l) - 1, URL_FORM);
+}
+
+static void mb_url_long_legacy(long n)
+{
+	char buf[MB_BUFSIZE * 8];
+	long i;
+
+	mb_url_fill();
+
+	for (i = 0; i < n; i++)
+		mb_sink += legacy_url_encode(buf, sizeof(buf), mb_url_l,
+				"https://en.wikipedia.org/wiki/Special:Search?search=");
+}
+
+static void mb_strisupper(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += strisupper(mb_shout);
+}
+
+static void mb_bstrtok(long n)
+{
+	char buf[sizeof(mb_text)];
+	char *p, *tok;
+	long i;
+
+	for (i = 0; i < n; i++) {
+		/* bstrtok writes into the string, so it needs a fresh copy */
+		memcpy(buf, mb_text, sizeof(buf));
+
+		for (p = buf; p;) {
+			tok = bstrtok(&p, " ");
+			mb_sink += tok[0];
+		}
+	}
+}
+
+static void mb_fio_printf(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		FIO_PRINTF(FIO_MSG, "%s %s\n", "#channel", mb_samples[i % MB_NSAMPLES]);
+}
+
+static void mb_fio_printf_off(long n)
+{
+	long i;
+
+	/* FIO_VER is off by default, so this is just the mask check */
+	for (i = 0; i < n; i++)
+		FIO_PRINTF(FIO_VER, "%s %s\n", "#channel", mb_samples[i % MB_NSAMPLES]);
+}
+
+static void mb_getline(long n)
+{
+	char buf[MB_BUFSIZE];
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += fio_getline(mb_fp, buf, sizeof(buf),
+				(i * 7919) % MB_LINES);
+}
+
+static void mb_getline_legacy(long n)
+{
+	char buf[MB_BUFSIZE];
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += legacy_getline(mb_fp, buf, sizeof(buf),
+				(i * 7919) % MB_LINES);
+}
+
+static void mb_chans_ison(long n)
+{
+	char *chan, *nick;
+	long i;
+	int u;
+
+	for (i = 0; i < n; i++) {
+		u = (i * 7919) % MB_USERS;
+		chan = mb_chan[mb_mchan(u, i % MB_PERUSER)];
+		nick = mb_nick[u];
+		mb_sink += ch_ison(&mb_chans, chan, strlen(chan), nick, strlen(nick));
+	}
+}
+
+static void mb_chans_partjoin(long n)
+{
+	char *chan, *nick;
+	long i;
+	int u;
+
+	/* one of each, so the tables stay the same size */
+	for (i = 0; i < n; i++) {
+		u = (i * 7919) % MB_USERS;
+		chan = mb_chan[mb_mchan(u, 0)];
+		nick = mb_nick[u];
+		ch_part(&mb_chans, chan, strlen(chan), nick, strlen(nick));
+		ch_join(&mb_chans, chan, strlen(chan), nick, strlen(nick));
+	}
+}
+
+static void mb_chans_nick(long n)
+{
+	char *nick;
+	long i;
+	int u;
+
+	/* case only changes, and back, the nick keeps its record */
+	for (i = 0; i < n; i++) {
+		u = (i * 7919) % MB_USERS;
+		nick = mb_nick[u];
+		nick[0] ^= 0x20;
+		mb_sink += ch_nick(&mb_chans, nick, strlen(nick), nick, strlen(nick));
+	}
+}
+
+static void mb_privmsg(long n)
+{
+	long i;
+
+	/* what irc_handle_data does with each line */
+	for (i = 0; i < n; i++) {
+		irc_parse_action(&mb_irc, mb_cmdline, sizeof(mb_cmdline) - 1);
+		arena_reset(&mb_irc.arena);
+	}
+}
+
+static void mb_privmsg_pool(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++) {
+		irc_parse_action(&mb_ircpool, mb_chatline, sizeof(mb_chatline) - 1);
+		arena_reset(&mb_ircpool.arena);
+
+		/* don't outrun the pool, a full one just drops them */
+		while (atomic_load(&mb_pool.pending) >= POOL_MAXJOBS / 2)
+			;
+	}
+
+	while (atomic_load(&mb_pool.pending) > 0)
+		;
+}
+
+/* mb_setup_sendq : a pipe that only takes a page, so writes come up short */
+static void mb_setup_sendq(void)
+{
+	int len;
+
+	if (mb_sqpipe[0] >= 0)
+		return;
+
+	if (pipe2(mb_sqpipe, O_NONBLOCK) < 0 ||
+			fcntl(mb_sqpipe[1], F_SETPIPE_SZ, MB_PIPESIZE) < 0) {
+		perror("pipe");
+		exit(1);
+	}
+
+	len = snprintf(mb_sqline, sizeof(mb_sqline), "PRIVMSG #channel :");
+	memset(mb_sqline + len, 'x', sizeof(mb_sqline) - len - 3);
+	strcpy(mb_sqline + sizeof(mb_sqline) - 3, "\r\n");
+}
+
+/*
+ * mb_sendq_short : more PRIVMSGs than the pipe takes, so the first write
+ * stops in the middle of one, then a PONG jumps the queue. Every line has
+ * to come out the other end whole, or we stop right there.
+ */
+static void mb_sendq_short(long n)
+{
+	static sendq_t sq;
+	char buf[MB_PIPESIZE * 4], *p, *end;
+	int len, got, i, msgs, pongs;
+	long k;
+
+	for (k = 0; k < n; k++) {
+		sq_init(&sq, 0);
+		sq_setpace(&sq, 0, 0);
+
+		for (i = 0; i < MB_SQLINES; i++)
+			sq_push(&sq, SQ_NORMAL, mb_sqline, sizeof(mb_sqline) - 1, 0);
+
+		got = sq_flush(&sq, mb_sqpipe[1], 0);
+		sq_push(&sq, SQ_CTRL, mb_sqctrl, sizeof(mb_sqctrl) - 1, 0);
+
+		if (got < 0) {
+			fprintf(stderr, "sendq_short: flush failed\n");
+			exit(1);
+		}
+
+		/* drain and flush until it's all out, keeping everything we read */
+		for (got = 0; ; ) {
+			if ((len = read(mb_sqpipe[0], buf + got, sizeof(buf) - got)) > 0)
+				got += len;
+			if (sq.depth == 0 && len <= 0)
+				break;
+			if (sq_flush(&sq, mb_sqpipe[1], 0) < 0)
+				break;
+		}
+
+		for (p = buf, end = buf + got, msgs = 0, pongs = 0; p < end; ) {
+			if (end - p >= sizeof(mb_sqline) - 1 &&
+					memcmp(p, mb_sqline, sizeof(mb_sqline) - 1) == 0) {
+				p += sizeof(mb_sqline) - 1;
+				msgs++;
+			} else if (end - p >= sizeof(mb_sqctrl) - 1 &&
+					memcmp(p, mb_sqctrl, sizeof(mb_sqctrl) - 1) == 0) {
+				p += sizeof(mb_sqctrl) - 1;
+				pongs++;
+			} else {
+				break;
+			}
+		}
+
+		if (p != end || msgs != MB_SQLINES || pongs != 1) {
+			fprintf(stderr, "sendq_short: lines got spliced, %d PRIVMSGs "
+					"and %d PONGs, bad bytes at %d of %d\n",
+					msgs, pongs, (int)(p - buf), got);
+			exit(1);
+		}
+
+		mb_sink += got;
+	}
+}
+
+static void mb_ratelimit(long n)
+{
+	static const rl_limit_t limits[2] = {{3, 10000}, {5, 4000}};
+	static int init;
+	uint64_t keys[2], now;
+	long i;
+
+	if (!init++)
+		rl_init(&mb_rl);
+
+	/* a raid, every request from somewhere else, a few channels taking it */
+	for (i = 0, now = now_ms(); i < n; i++) {
+		keys[0] = ((uint64_t)1 << 32) | (uint32_t)((i * 7919) % MB_HOSTS);
+		keys[1] = ((uint64_t)2 << 32) | (uint32_t)(i % 16);
+		mb_sink += rl_allow(&mb_rl, keys, limits, 2, now + (i >> 10));
+	}
+}
+
+/* mb_setup_wheel : a wheel with a million timers in the next hour */
+static void mb_setup_wheel(void)
+{
+	long i;
+
+	if (mb_timers)
+		return;
+
+	mb_timers = calloc(MB_TIMERS, sizeof(*mb_timers));
+	tw_init(&mb_tw, now_ms());
+
+	for (i = 0; i < MB_TIMERS; i++)
+		tw_add(&mb_tw, &mb_timers[i], mb_tw.now + 1 + (i * 7919) % MB_TIMERSPAN,
+				mb_wheel_fire, NULL);
+}
+
+/* mb_wheel_rearm : pushes a timer back, what a keepalive does, a million pending */
+static void mb_wheel_rearm(long n)
+{
+	tw_timer_t *t;
+	long i;
+
+	for (i = 0; i < n; i++) {
+		t = &mb_timers[(i * 104729) % MB_TIMERS];
+		tw_add(&mb_tw, t, mb_tw.now + 1 + (i * 7919) % MB_TIMERSPAN,
+				mb_wheel_fire, NULL);
+	}
+}
+
+/* mb_wheel_advance : a ms of the clock, with whatever fires and cascades */
+static void mb_wheel_advance(long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		mb_sink += tw_advance(&mb_tw, mb_tw.now + 1);
+}
+
+/* mb_wheel_fire : a timer that's due goes back in, so the count holds */
+static void mb_wheel_fire(tw_t *tw, tw_timer_t *t, void *arg)
+{
+	tw_add(tw, t, tw->now + MB_TIMERSPAN, mb_wheel_fire, arg);
+}
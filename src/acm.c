@@ -0,0 +1,191 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 00:05
+ *
+ * Aho-Corasick Multi-Pattern Matching
+ *
+ * Add every pattern, compile once, then acm_scan finds every occurrence of
+ * every pattern in one pass over the text. The cost per byte is one table
+ * lookup plus one per match, no matter how many patterns there are.
+ *
+ * The fail links get folded into a full transition table at compile time,
+ * so scanning never walks them. To keep that table small, bytes that don't
+ * show up in any pattern all share one column.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "acm.h"
+
+/* acm_init : sets up an empty automaton */
+void acm_init(acm_t *acm)
+{
+	memset(acm, 0, sizeof(*acm));
+}
+
+/* acm_add : adds a pattern, returns its id (in order, from 0) or -1 */
+int acm_add(acm_t *acm, const char *pat, int len)
+{
+	void *tmp;
+	int cap;
+
+	if (len <= 0 || acm->next) /* no empties, and nothing after compiling */
+		return -1;
+
+	if (acm->npats == acm->cappats) {
+		cap = acm->cappats ? acm->cappats * 2 : 64;
+
+		if (!(tmp = realloc(acm->pats, cap * sizeof(*acm->pats))))
+			return -1;
+		acm->pats = tmp;
+
+		if (!(tmp = realloc(acm->patlens, cap * sizeof(*acm->patlens))))
+			return -1;
+		acm->patlens = tmp;
+
+		acm->cappats = cap;
+	}
+
+	if (!(acm->pats[acm->npats] = malloc(len)))
+		return -1;
+
+	memcpy(acm->pats[acm->npats], pat, len);
+	acm->patlens[acm->npats] = len;
+
+	return acm->npats++;
+}
+
+/* acm_compile : builds the automaton out of everything that's been added */
+int acm_compile(acm_t *acm)
+{
+	int *fail, *queue;
+	int maxstates, nc, i, j, c, s, u, v, qhead, qtail;
+	unsigned char used[256];
+	void *tmp;
+
+	/* squash the alphabet down to the bytes the patterns actually use */
+	memset(used, 0, sizeof(used));
+	for (i = 0, maxstates = 1; i < acm->npats; i++) {
+		for (j = 0; j < acm->patlens[i]; j++)
+			used[(unsigned char)acm->pats[i][j]] = 1;
+		maxstates += acm->patlens[i];
+	}
+
+	for (i = 0, nc = 1; i < 256; i++)
+		acm->classes[i] = used[i] ? nc++ : 0;
+	acm->nclasses = nc;
+
+	acm->next = malloc((size_t)maxstates * nc * sizeof(*acm->next));
+	acm->pathead = malloc(maxstates * sizeof(*acm->pathead));
+	acm->dict = calloc(maxstates, sizeof(*acm->dict));
+	acm->patnext = malloc((acm->npats + 1) * sizeof(*acm->patnext));
+	fail = calloc(maxstates, sizeof(*fail));
+	queue = malloc(maxstates * sizeof(*queue));
+
+	if (!acm->next || !acm->pathead || !acm->dict || !acm->patnext ||
+			!fail || !queue) {
+		free(fail);
+		free(queue);
+		return -1;
+	}
+
+	memset(acm->next, 0xff, (size_t)maxstates * nc * sizeof(*acm->next));
+	memset(acm->pathead, 0xff, maxstates * sizeof(*acm->pathead));
+
+	/* the trie */
+	acm->nstates = 1;
+	for (i = 0; i < acm->npats; i++) {
+		for (j = 0, s = 0; j < acm->patlens[i]; j++) {
+			c = acm->classes[(unsigned char)acm->pats[i][j]];
+			if (acm->next[s * nc + c] < 0)
+				acm->next[s * nc + c] = acm->nstates++;
+			s = acm->next[s * nc + c];
+		}
+
+		acm->patnext[i] = acm->pathead[s];
+		acm->pathead[s] = i;
+	}
+
+	/* fail links, breadth first so a state's fail row is done before it */
+	qhead = qtail = 0;
+
+	for (c = 0; c < nc; c++) {
+		v = acm->next[c];
+		if (v < 0) {
+			acm->next[c] = 0;
+		} else {
+			fail[v] = 0;
+			queue[qtail++] = v;
+		}
+	}
+
+	while (qhead < qtail) {
+		u = queue[qhead++];
+
+		for (c = 0; c < nc; c++) {
+			v = acm->next[u * nc + c];
+
+			if (v < 0) {
+				acm->next[u * nc + c] = acm->next[fail[u] * nc + c];
+				continue;
+			}
+
+			fail[v] = acm->next[fail[u] * nc + c];
+			acm->dict[v] = acm->pathead[fail[v]] >= 0 ?
+				fail[v] : acm->dict[fail[v]];
+			queue[qtail++] = v;
+		}
+	}
+
+	free(fail);
+	free(queue);
+
+	/* give back what the trie didn't end up needing */
+	if ((tmp = realloc(acm->next, (size_t)acm->nstates * nc * sizeof(*acm->next))))
+		acm->next = tmp;
+
+	return 0;
+}
+
+/* acm_scan : calls func for every match, stops early if func returns != 0 */
+int acm_scan(acm_t *acm, const char *text, int len, acm_func_t func, void *arg)
+{
+	int i, s, t, id, n;
+
+	if (!acm->next)
+		return 0;
+
+	for (i = 0, s = 0, n = 0; i < len; i++) {
+		s = acm->next[s * acm->nclasses + acm->classes[(unsigned char)text[i]]];
+
+		/* every pattern ending here, and in every suffix of here */
+		for (t = acm->pathead[s] >= 0 ? s : acm->dict[s]; t > 0; t = acm->dict[t]) {
+			for (id = acm->pathead[t]; id >= 0; id = acm->patnext[id]) {
+				n++;
+				if (func(id, i + 1, arg))
+					return n;
+			}
+		}
+	}
+
+	return n;
+}
+
+/* acm_free : releases everything the automaton holds */
+void acm_free(acm_t *acm)
+{
+	int i;
+
+	for (i = 0; i < acm->npats; i++)
+		free(acm->pats[i]);
+
+	free(acm->pats);
+	free(acm->patlens);
+	free(acm->patnext);
+	free(acm->next);
+	free(acm->pathead);
+	free(acm->dict);
+
+	acm_init(acm);
+}
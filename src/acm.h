@@ -0,0 +1,37 @@
+#ifndef ACM_H
+#define ACM_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 00:05
+ *
+ * Aho-Corasick Multi-Pattern Matching
+ */
+
+struct acm_t {
+	/* patterns, as given to acm_add */
+	int npats, cappats;
+	char **pats;
+	int *patlens;
+	int *patnext; /* next pattern ending in the same state, -1 for none */
+
+	/* the automaton, after acm_compile */
+	int nstates;
+	int nclasses;
+	unsigned char classes[256]; /* byte to column in next */
+	int *next; /* [state * nclasses + class], a full DFA, no fail walking */
+	int *pathead; /* first pattern ending at state, -1 for none */
+	int *dict; /* nearest state down the fail chain that ends a pattern */
+};
+
+typedef struct acm_t acm_t;
+
+typedef int (*acm_func_t)(int id, int end, void *arg);
+
+void acm_init(acm_t *acm);
+int acm_add(acm_t *acm, const char *pat, int len);
+int acm_compile(acm_t *acm);
+int acm_scan(acm_t *acm, const char *text, int len, acm_func_t func, void *arg);
+void acm_free(acm_t *acm);
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 10:05
+ *
+ * Bump Arenas
+ *
+ * Scratch memory for one message at a time. Allocating is a pointer bump,
+ * there's no freeing anything on its own, and arena_reset throws it all
+ * away at once by putting the pointer back. The memory can be the caller's
+ * (the tail of a struct, a stack buffer) or malloc'd once up front.
+ *
+ * Something that doesn't fit still works, it just goes on the heap until
+ * the reset, and gets counted, so a too small arena shows up in the metrics
+ * instead of as a crash.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "arena.h"
+#include "metrics.h"
+
+/* arena_init : an arena over mem, or over cap malloc'd bytes if it's NULL */
+int arena_init(arena_t *a, void *mem, size_t cap)
+{
+	memset(a, 0, sizeof(*a));
+
+	if (!mem) {
+		if (!(mem = malloc(cap)))
+			return -1;
+		a->owned = 1;
+	}
+
+	a->base = mem;
+	a->cap = cap;
+
+	return 0;
+}
+
+/* arena_alloc : n bytes, aligned for anything, NULL only when out of memory */
+void *arena_alloc(arena_t *a, size_t n)
+{
+	struct arena_spill_t *s;
+	size_t off;
+
+	off = (a->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	if (off + n <= a->cap) {
+		a->used = off + n;
+		if (a->used + a->spilled > a->peak)
+			a->peak = a->used + a->spilled;
+		return a->base + off;
+	}
+
+	if (!(s = malloc(sizeof(*s) + n)))
+		return NULL;
+
+	s->next = a->spill;
+	a->spill = s;
+	a->spilled += n;
+	if (a->used + a->spilled > a->peak)
+		a->peak = a->used + a->spilled;
+
+	met_inc(MET_ARENA_SPILLS);
+
+	return s->mem;
+}
+
+/* arena_strndup : a NUL terminated copy of the first n bytes of s */
+char *arena_strndup(arena_t *a, const char *s, size_t n)
+{
+	char *p;
+
+	if ((p = arena_alloc(a, n + 1)) == NULL)
+		return NULL;
+
+	memcpy(p, s, n);
+	p[n] = '\0';
+
+	return p;
+}
+
+/* arena_printf : a formatted string, as long as it needs to be */
+char *arena_printf(arena_t *a, const char *fmt, ...)
+{
+	va_list args;
+	size_t off, room;
+	char *p;
+	int len;
+
+	/* try it in whatever's left first, that's nearly always enough */
+	off = a->used;
+	room = a->cap - off;
+
+	va_start(args, fmt);
+	len = vsnprintf(a->base + off, room, fmt, args);
+	va_end(args);
+
+	if (len < 0)
+		return NULL;
+
+	if (len < room) {
+		a->used = off + len + 1;
+		if (a->used + a->spilled > a->peak)
+			a->peak = a->used + a->spilled;
+		return a->base + off;
+	}
+
+	if ((p = arena_alloc(a, len + 1)) == NULL)
+		return NULL;
+
+	va_start(args, fmt);
+	vsnprintf(p, len + 1, fmt, args);
+	va_end(args);
+
+	return p;
+}
+
+/* arena_reset : frees everything allocated, in one go */
+void arena_reset(arena_t *a)
+{
+	struct arena_spill_t *s;
+
+	while ((s = a->spill)) {
+		a->spill = s->next;
+		free(s);
+	}
+
+	a->used = 0;
+	a->spilled = 0;
+}
+
+/* arena_free : resets a, and frees its memory if it's ours */
+void arena_free(arena_t *a)
+{
+	arena_reset(a);
+
+	if (a->owned)
+		free(a->base);
+
+	a->base = NULL;
+	a->cap = 0;
+	a->owned = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 10:05
+ *
+ * Bump Arenas
+ */
+
+#include <stddef.h>
+
+#define ARENA_ALIGN 16
+
+/* an allocation the arena couldn't fit, on the heap until the next reset */
+struct arena_spill_t {
+	struct arena_spill_t *next;
+	char mem[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+struct arena_t {
+	char *base;
+	size_t cap;
+	size_t used;
+	size_t peak; /* most used between resets, spills included */
+	struct arena_spill_t *spill;
+	size_t spilled;
+	int owned; /* arena_init malloc'd base, arena_free frees it */
+};
+
+typedef struct arena_t arena_t;
+
+int arena_init(arena_t *a, void *mem, size_t cap);
+void *arena_alloc(arena_t *a, size_t n);
+char *arena_strndup(arena_t *a, const char *s, size_t n);
+char *arena_printf(arena_t *a, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+void arena_reset(arena_t *a);
+void arena_free(arena_t *a);
+
+#endif
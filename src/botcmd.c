@@ -0,0 +1,694 @@
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 22:50
+ *
+ * Bot Commands
+ *
+ * Everything the bot does when somebody talks to it. These used to live in
+ * irc.c, which is supposed to just be the IRC library bits.
+ */
+
+#define FIO_SUBSYS FIO_SS_CMD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "irc.h"
+#include "ircmsg.h"
+#include "botcmd.h"
+#include "fio.h"
+#include "common.h"
+#include "stringext.h"
+#include "acm.h"
+#include "metrics.h"
+#include "chatlog.h"
+#include "search.h"
+
+struct strdict_t {
+	char *key;
+	char *val;
+};
+
+#define BANTER_MAXREPLIES 4
+#define BANTER_BOL 0x01 /* trigger has to start the message */
+#define BANTER_EOL 0x02 /* trigger has to end the message */
+
+#define WEBPREFIX_GOOGLE "https://www.google.com/search?q="
+#define WEBPREFIX_GITHUB "https://github.com/search?q="
+#define WEBPREFIX_WIKI   WEBPREFIX_GITHUB \
+	"user:retropie+repo:RetroPie-Setup+in:title+"
+#define WEBSUFFIX_WIKI   "&type=Wikis"
+
+#define BOT_LINELEN 512 /* replies longer than a line aren't worth sending */
+#define BOT_GREPHITS 3  /* lines !grep answers with */
+#define BOT_REMINDMAX (30 * 86400) /* seconds, the furthest out !remind goes */
+
+/* the built in banter, banter.txt rules get added after these */
+static struct strdict_t banter_dict[] = {
+	{"Hi", "Hello There!"},
+	{"Hello", "You may approach the bench"},
+	{"thank", "No, THANK YOU!"},
+	{"lol", "heh"},
+	{"heh", "lol"},
+	{"rofl", "OMFGWTFLMAO"},
+	{"lmao", "I'll bet you're laughing your ass off."}
+};
+
+struct banter_t {
+	char *reply;
+	int flags;
+};
+
+struct banter_match_t {
+	int textlen;
+	int n;
+	int ids[BANTER_MAXREPLIES];
+};
+
+static acm_t banter_acm;
+static struct banter_t *banter_rules;
+
+/* nick!user@host masks, or bare nicks, the admin commands answer to */
+static char admins[BOT_MAXADMINS][BOT_MASKLEN];
+static int nadmins;
+
+static int banter_add(char *trigger, char *reply);
+static int banter_onmatch(int id, int end, void *arg);
+static char *search_link(arena_t *ar, char *prefix, char *query, char *suffix);
+static int irc_bot_isadmin(ircmsg_t *msg);
+static int stats_ms(char *buf, int buflen, uint64_t us);
+static int seen_ago(char *buf, int buflen, time_t then);
+static int remind_delay(char *s, int len);
+
+/* irc_bot_banter_init : compiles the banter table, and path's rules, once */
+int irc_bot_banter_init(char *path)
+{
+	FILE *fp;
+	char line[1024], *tab, *end;
+	int i, lineno;
+
+	acm_init(&banter_acm);
+
+	for (i = 0; i < ARRSIZE(banter_dict); i++) {
+		if (banter_add(banter_dict[i].key, banter_dict[i].val) < 0)
+			return -1;
+	}
+
+	/*
+	 * the file is one rule a line, "trigger<TAB>reply". Triggers are plain
+	 * text, a leading ^ or trailing $ pins them to the start or end of the
+	 * message. Lines starting with a # are comments.
+	 */
+	if (path && (fp = fopen(path, "r")) != NULL) {
+		for (lineno = 1; fgets(line, sizeof(line), fp); lineno++) {
+			end = line + strlen(line);
+			while (end > line && (end[-1] == '\n' || end[-1] == '\r'))
+				*--end = '\0';
+
+			if (line[0] == '#' || line[0] == '\0')
+				continue;
+
+			if ((tab = strchr(line, '\t')) == NULL) {
+				FIO_PRINTF(FIO_WRN, "%s:%d: No Tab Between Trigger and Reply",
+						path, lineno);
+				continue;
+			}
+
+			*tab++ = '\0';
+			while (*tab == '\t')
+				tab++;
+
+			if (banter_add(line, tab) < 0) {
+				FIO_PRINTF(FIO_WRN, "%s:%d: Couldn't Add Rule", path, lineno);
+			}
+		}
+
+		fclose(fp);
+	}
+
+	if (acm_compile(&banter_acm) < 0) {
+		FIO_PRINTF(FIO_ERR, "Couldn't Compile Banter Rules");
+		return -1;
+	}
+
+	FIO_PRINTF(FIO_MSG, "%d Banter Rules, %d States",
+			banter_acm.npats, banter_acm.nstates);
+
+	return 0;
+}
+
+/* irc_bot_banter : wittily respond to quips in chat */
+int irc_bot_banter(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	struct banter_match_t match;
+	int i, j, tmp;
+	char *buf;
+
+	/* check if the message is in all upper case first */
+	if (strisupper(arg)) {
+		if (!irc_bot_allow(irc, msg, CMD_RATE_FREE))
+			return 0;
+
+		buf = arena_printf(ar, "%.*s QUIT SHOUTING!!",
+				msg->nick.len, msg->nick.ptr);
+		if (buf)
+			irc_answer(irc, msg, buf);
+		return 0;
+	}
+
+	/* one pass over the message finds every rule that matches */
+	match.textlen = strlen(arg);
+	match.n = 0;
+
+	acm_scan(&banter_acm, arg, match.textlen, banter_onmatch, &match);
+
+	/* answer in table order, same as we always have */
+	for (i = 1; i < match.n; i++) {
+		for (j = i; j > 0 && match.ids[j - 1] > match.ids[j]; j--) {
+			tmp = match.ids[j];
+			match.ids[j] = match.ids[j - 1];
+			match.ids[j - 1] = tmp;
+		}
+	}
+
+	/* however many rules it tripped, it's one answer to the limits */
+	if (match.n > 0 && !irc_bot_allow(irc, msg, CMD_RATE_FREE))
+		return 0;
+
+	for (i = 0; i < match.n; i++) {
+		if (irc_answer(irc, msg, banter_rules[match.ids[i]].reply) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* banter_add : adds one trigger and its reply to the (uncompiled) rules */
+static int banter_add(char *trigger, char *reply)
+{
+	struct banter_t *tmp;
+	int flags, len, id;
+
+	flags = 0;
+	len = strlen(trigger);
+
+	if (*trigger == '^') {
+		flags |= BANTER_BOL;
+		trigger++;
+		len--;
+	}
+
+	if (len > 0 && trigger[len - 1] == '$') {
+		flags |= BANTER_EOL;
+		len--;
+	}
+
+	if ((id = acm_add(&banter_acm, trigger, len)) < 0)
+		return -1;
+
+	/* the automaton hands out ids in order, so they index right into this */
+	if (id % 64 == 0) {
+		tmp = realloc(banter_rules, (id + 64) * sizeof(*banter_rules));
+		if (!tmp)
+			return -1;
+		banter_rules = tmp;
+	}
+
+	if (!(banter_rules[id].reply = strdup(reply)))
+		return -1;
+	banter_rules[id].flags = flags;
+
+	return 0;
+}
+
+/* banter_onmatch : acm_scan callback, collects each matching rule once */
+static int banter_onmatch(int id, int end, void *arg)
+{
+	struct banter_match_t *match;
+	int i;
+
+	match = arg;
+
+	if ((banter_rules[id].flags & BANTER_BOL) &&
+			end != banter_acm.patlens[id])
+		return 0;
+
+	if ((banter_rules[id].flags & BANTER_EOL) && end != match->textlen)
+		return 0;
+
+	for (i = 0; i < match->n; i++) {
+		if (match->ids[i] == id)
+			return 0;
+	}
+
+	match->ids[match->n++] = id;
+
+	/* a message that trips this many rules has gotten enough out of us */
+	return match->n == BANTER_MAXREPLIES;
+}
+
+/* irc_botcmd_help : handles help command and prints command usage info */
+int irc_botcmd_help(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	struct ircfunc_t *func;
+	int i, len;
+	char *buf;
+
+	/*
+	 * if no arguments are present, we print all of the available commands
+	 * if arguments were passed, check if it's a command, if so, print the usage
+	 */
+
+	if (arg) { /* we got an arg, find the one we need, and print the help */
+		if (*arg == '!') /* they asked about "!ping", not "ping" */
+			arg++;
+
+		if ((func = ircfunc_lookup(arg, strlen(arg))) == NULL) {
+			buf = arena_printf(ar, "%.*s: \"%s\" isn't a command",
+					msg->nick.len, msg->nick.ptr, arg);
+		} else {
+			buf = arena_printf(ar, "%.*s: %s",
+					msg->nick.len, msg->nick.ptr, func->usage);
+		}
+
+	} else { /* no arg, print out all of the commands that we can fit in here */
+		if ((buf = arena_alloc(ar, 256)) == NULL)
+			return 0;
+
+		snprintf(buf, 256, "%.*s: commands: ", msg->nick.len, msg->nick.ptr);
+		for (i = 0, len = strlen(buf); i < ircfuncs_len && len < 200;
+				i++, len = strlen(buf)) {
+			snprintf(buf + len, 256 - len, "!%s ", ircfuncs[i].command);
+		}
+	}
+
+	if (buf)
+		irc_answer(irc, msg, buf);
+
+	return 0;
+}
+
+/* irc_botcmd_wiki : adds a sloo of wiki functionality */
+int irc_botcmd_wiki(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	/*
+	 * Similar to the google command, this command generates a github query to
+	 * search the RetropieWiki.
+	 *
+	 * Github has special search rules, which can be found here:
+	 *     https://help.github.com/en/articles/searching-wikis
+	 * The jist is that we're setting
+	 *     user:retropie
+	 *     repo:retropie-setup
+	 *     in:title
+	 *     in:body
+	 *
+	 * Then plop the (form encoded) query string after it
+	 * https://github.com/search?q=user:retropie+
+	 *                repo:RetroPie-Setup+in:title+Nintendo+64&type=Wikis
+	 */
+
+	char *mesg;
+
+	if (!arg) {
+		return 0;
+	}
+
+	if ((mesg = search_link(ar, WEBPREFIX_WIKI, arg, WEBSUFFIX_WIKI)) == NULL) {
+		FIO_PRINTF(FIO_ERR, "Error Converting %s to proper URL", arg);
+		mesg = "Error Converting input to proper URL...";
+	}
+
+	return irc_answer(irc, msg, mesg);
+}
+
+/* irc_botcmd_8ball : responds to magic 8 ball requests */
+int irc_botcmd_8ball(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	/*
+	 * You'd think there were only 8 answers inside of a magic 8 ball, but it
+	 * turns out there's like, 20! Who knew!
+	 */
+
+	char *table[] = {
+		"It is certain.", "It is decidedly so.", "Without a doubt",
+		"Yes - definitely.", "You may rely on it.", "As I see it, yes.",
+		"Most likely.", "Outlook good.", "Yes.",
+		"Signs point to yes.", "Reply hazy, try again.", "Ask again later",
+		"Better not tell you now", "Cannot predict now",
+		"Concentrate and ask again", "Don't count on it.", "My reply is no.",
+		"My sources say no.", "Outlook not so good.", "Very doubtful."
+	};
+
+	int i;
+
+	i = rand() % ARRSIZE(table);
+
+	if (irc_answer(irc, msg, table[i]) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* irc_botcmd_ping : responds to a user with "pong" */
+int irc_botcmd_ping(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	if (irc_answer(irc, msg, "pong") < 0)
+		return -1;
+
+	return 0;
+}
+
+/* irc_botcmd_stats : a line of the metrics, for admins */
+int irc_botcmd_stats(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	char *mesg, p50[32], p99[32];
+	int nchans, nusers, nmembs;
+
+	if (!irc_bot_isadmin(msg))
+		return irc_answer(irc, msg, "Only admins can do that.");
+
+	stats_ms(p50, sizeof(p50), met_quantile(MET_H_REPLY, 0.5));
+	stats_ms(p99, sizeof(p99), met_quantile(MET_H_REPLY, 0.99));
+	ch_stats(&irc->members, &nchans, &nusers, &nmembs);
+
+	mesg = arena_printf(ar,
+			"rx %.1f MB %llu lines (%llu bad, %llu too long), tx %.1f MB, "
+			"%llu commands (%llu dropped), reply p50 %s p99 %s, "
+			"%llu reconnects, log %llu records (%llu dropped), "
+			"%d channels %d users",
+			met_get(MET_RX_BYTES) / 1048576.0,
+			(unsigned long long)met_get(MET_RX_LINES),
+			(unsigned long long)met_get(MET_PARSE_ERRORS),
+			(unsigned long long)met_get(MET_FRAME_OVERFLOWS),
+			met_get(MET_TX_BYTES) / 1048576.0,
+			(unsigned long long)met_get(MET_COMMANDS),
+			(unsigned long long)met_get(MET_COMMANDS_REJECTED),
+			p50, p99,
+			(unsigned long long)met_get(MET_RECONNECTS),
+			(unsigned long long)met_get(MET_LOG_RECORDS),
+			(unsigned long long)met_get(MET_LOG_DROPPED),
+			nchans, nusers);
+
+	return mesg ? irc_answer(irc, msg, mesg) : 0;
+}
+
+/* irc_botcmd_grep : the newest lines in this channel's logs with every word */
+int irc_botcmd_grep(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	sr_hit_t hits[BOT_GREPHITS];
+	char key[256], line[BOT_LINELEN], date[16], *mesg;
+	struct tm tm;
+	time_t when;
+	slice_t *t;
+	int i, n, rc;
+
+	t = irc_target(msg);
+	cl_key(key, sizeof(key), irc->server, t->ptr, t->len);
+
+	if ((n = sr_grep(key, arg, hits, BOT_GREPHITS)) == 0)
+		return irc_answer(irc, msg, "Nothing.");
+
+	for (i = 0, rc = 0; i < n && rc >= 0; i++) {
+		if (sr_line(&hits[i], line, sizeof(line)) < 0)
+			continue;
+
+		when = hits[i].time;
+		localtime_r(&when, &tm);
+		strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+
+		if ((mesg = arena_printf(ar, "%s %s", date, line)))
+			rc = irc_answer(irc, msg, mesg);
+	}
+
+	return rc;
+}
+
+/* irc_botcmd_seen : when someone last said something in this channel */
+int irc_botcmd_seen(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	sr_hit_t hit;
+	char key[256], line[BOT_LINELEN], ago[64], *mesg;
+	slice_t *t;
+	int len;
+
+	t = irc_target(msg);
+	cl_key(key, sizeof(key), irc->server, t->ptr, t->len);
+	len = strcspn(arg, " ");
+
+	if (!sr_seen(key, arg, len, &hit) || sr_line(&hit, line, sizeof(line)) < 0) {
+		mesg = arena_printf(ar, "I haven't seen %.*s here.", len, arg);
+	} else {
+		seen_ago(ago, sizeof(ago), hit.time);
+		mesg = arena_printf(ar, "%.*s was here %s ago, %s", len, arg, ago, line);
+	}
+
+	return mesg ? irc_answer(irc, msg, mesg) : 0;
+}
+
+/* irc_botcmd_lag : how long the server takes to answer our PINGs */
+int irc_botcmd_lag(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	char last[32], p50[32], p90[32], p99[32], *past, *mesg;
+	uint64_t l, a, b, c;
+	int n;
+
+	if ((n = irc_lagstats(irc, &l, &a, &b, &c)) == 0)
+		return irc_answer(irc, msg, "I haven't timed the server yet.");
+
+	stats_ms(last, sizeof(last), l);
+	stats_ms(p50, sizeof(p50), a);
+	stats_ms(p90, sizeof(p90), b);
+	stats_ms(p99, sizeof(p99), c);
+
+	past = "";
+	if (irc->lag_ms && !(past = arena_printf(ar, ", reconnecting past %dms", irc->lag_ms)))
+		return 0;
+
+	mesg = arena_printf(ar, "lag %s, p50 %s p90 %s p99 %s over the last %d PINGs%s",
+			last, p50, p90, p99, n, past);
+
+	return mesg ? irc_answer(irc, msg, mesg) : 0;
+}
+
+/* irc_botcmd_remind : says something back to whoever asked, later */
+int irc_botcmd_remind(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	char *text, *mesg, in[64];
+	int len, secs;
+
+	len = strcspn(arg, " ");
+	for (text = arg + len; *text == ' '; text++)
+		;
+
+	if ((secs = remind_delay(arg, len)) <= 0 || !*text)
+		return irc_answer(irc, msg, "USAGE: !remind <minutes|1h30m> <text>");
+
+	text = arena_printf(ar, "%.*s: %s", msg->nick.len, msg->nick.ptr, text);
+
+	if (!text || irc_answer_later(irc, msg, secs * 1000ULL, text) < 0)
+		return irc_answer(irc, msg, "I can't remember that many things.");
+
+	met_inc(MET_REMINDERS);
+	seen_ago(in, sizeof(in), time(NULL) - secs);
+
+	mesg = arena_printf(ar, "Okay, in %s.", in);
+
+	return mesg ? irc_answer(irc, msg, mesg) : 0;
+}
+
+/* irc_botcmd_smack : smacks someone over TCP/IP */
+int irc_botcmd_smack(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	int damage;
+	char *mesg;
+
+	damage = rand() % 21 + 1;
+
+	if (arg) { /* if we have an argument, we'll smack the arg */
+		mesg = arena_printf(ar, "smacks %s for %d damage%s.",
+				arg, damage, damage == 20 ? " (SUPER EFFECTIVE)" : "");
+	} else {
+		mesg = arena_printf(ar, "smacks %.*s for %d damage%s.",
+				msg->nick.len, msg->nick.ptr,
+				damage, damage == 20 ? " (SUPER EFFECTIVE)" : "");
+	}
+
+	if (!mesg)
+		return 0;
+
+	if (irc_answer_action(irc, msg, mesg) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* irc_botcmd_google : IRC command for generating Google Links */
+int irc_botcmd_google(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar)
+{
+	char *mesg;
+
+	if (!arg) {
+		return 0;
+	}
+
+	if ((mesg = search_link(ar, WEBPREFIX_GOOGLE, arg, "")) == NULL) {
+		mesg = "Search too long. Google it youself!";
+	}
+
+	if (irc_answer(irc, msg, mesg) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* search_link : prefix, the form encoded query and suffix, NULL if too long */
+static char *search_link(arena_t *ar, char *prefix, char *query, char *suffix)
+{
+	int plen, qlen, slen, elen;
+	char *buf;
+
+	plen = strlen(prefix);
+	qlen = strlen(query);
+	slen = strlen(suffix);
+
+	/* sized exactly, so the encoder never runs out of room */
+	elen = url_encodelen(query, qlen, URL_FORM);
+	if (plen + elen + slen >= BOT_LINELEN)
+		return NULL;
+
+	if ((buf = arena_alloc(ar, plen + elen + slen + 1)) == NULL)
+		return NULL;
+
+	memcpy(buf, prefix, plen);
+	url_encode(buf + plen, elen + 1, query, qlen, URL_FORM);
+	memcpy(buf + plen + elen, suffix, slen + 1);
+
+	return buf;
+}
+
+/* irc_bot_admin_add : lets mask (nick!user@host, or just a nick) run admin commands */
+int irc_bot_admin_add(char *mask)
+{
+	if (nadmins == BOT_MAXADMINS || strlen(mask) >= BOT_MASKLEN)
+		return -1;
+
+	strcpy(admins[nadmins++], mask);
+
+	return 0;
+}
+
+/* irc_bot_allow : true if msg's sender and channel have room for an answer */
+int irc_bot_allow(irc_t *irc, ircmsg_t *msg, int rate)
+{
+	rl_limit_t limits[2];
+	uint64_t keys[2];
+	slice_t *who, *target;
+	int n;
+
+	if (rate < 0 || rate >= CMD_RATES || irc_bot_isadmin(msg))
+		return 1;
+
+	/* by host, so a new nick doesn't get anyone a new bucket */
+	who = msg->host.len ? &msg->host : &msg->nick;
+	target = irc_target(msg);
+	n = 0;
+
+	if (ircrates[rate].user.burst > 0) {
+		keys[n] = rl_key(&irc->limits, rate * 2, who->ptr, who->len);
+		limits[n++] = ircrates[rate].user;
+	}
+
+	/* a query's target is the sender, their own bucket covers that */
+	if (ircrates[rate].chan.burst > 0 && target != &msg->nick) {
+		keys[n] = rl_key(&irc->limits, rate * 2 + 1, target->ptr, target->len);
+		limits[n++] = ircrates[rate].chan;
+	}
+
+	if (n == 0 || rl_allow(&irc->limits, keys, limits, n, now_ms()))
+		return 1;
+
+	FIO_PRINTF(FIO_VER, "Rate Limited %.*s in %.*s",
+			msg->prefix.len, msg->prefix.ptr, target->len, target->ptr);
+	met_inc(MET_RATE_LIMITED);
+
+	return 0;
+}
+
+/* irc_bot_isadmin : true if whoever sent msg is on the admin list */
+static int irc_bot_isadmin(ircmsg_t *msg)
+{
+	int i;
+
+	for (i = 0; i < nadmins; i++) {
+		if (strchr(admins[i], '!') ? slice_eq(&msg->prefix, admins[i]) :
+				slice_eq(&msg->nick, admins[i]))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* stats_ms : a histogram bound in us as milliseconds, for !stats */
+static int stats_ms(char *buf, int buflen, uint64_t us)
+{
+	if (us == UINT64_MAX)
+		return snprintf(buf, buflen, ">5s");
+
+	return snprintf(buf, buflen, "%.1fms", us / 1000.0);
+}
+
+/* seen_ago : how long ago then was, in the two biggest units, for !seen and !remind */
+static int seen_ago(char *buf, int buflen, time_t then)
+{
+	time_t secs;
+
+	secs = time(NULL) - then;
+	if (secs < 0)
+		secs = 0;
+
+	if (secs >= 86400)
+		return snprintf(buf, buflen, "%lldd %lldh",
+				(long long)secs / 86400, (long long)secs % 86400 / 3600);
+	if (secs >= 3600)
+		return snprintf(buf, buflen, "%lldh %lldm",
+				(long long)secs / 3600, (long long)secs % 3600 / 60);
+	if (secs >= 60)
+		return snprintf(buf, buflen, "%lldm %llds",
+				(long long)secs / 60, (long long)secs % 60);
+
+	return snprintf(buf, buflen, "%llds", (long long)secs);
+}
+
+/*
+ * remind_delay : seconds in a !remind delay, 90 or 1h30m or 2d, bare numbers
+ * are minutes, 0 if it's not one or it's too far out
+ */
+static int remind_delay(char *s, int len)
+{
+	long total, n;
+	int i, unit;
+
+	for (i = 0, total = 0; i < len; ) {
+		if (!isdigit((unsigned char)s[i]))
+			return 0;
+
+		for (n = 0; i < len && isdigit((unsigned char)s[i]) && n <= BOT_REMINDMAX; i++)
+			n = n * 10 + s[i] - '0';
+
+		switch (i < len ? tolower((unsigned char)s[i++]) : 'm') {
+		case 'd': unit = 86400; break;
+		case 'h': unit = 3600; break;
+		case 'm': unit = 60; break;
+		case 's': unit = 1; break;
+		default: return 0;
+		}
+
+		if ((total += n * unit) > BOT_REMINDMAX)
+			return 0;
+	}
+
+	return total;
+}
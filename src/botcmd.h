@@ -0,0 +1,70 @@
+#ifndef BOTCMD_H
+#define BOTCMD_H
+
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 22:50
+ *
+ * Bot Commands
+ *
+ * The table itself is generated from botcmd.def by tools/cmdgen, into
+ * botcmd_tab.c.
+ */
+
+#include "irc.h"
+#include "ircmsg.h"
+#include "arena.h"
+#include "ratelimit.h"
+
+enum {
+	CMD_RATE_FREE,      /* costs us basically nothing to answer */
+	CMD_RATE_NORMAL,
+	CMD_RATE_EXPENSIVE, /* lookups, searches, things worth throttling */
+	CMD_RATES
+};
+
+/* how often one sender, and one channel, get an answer from a rate class */
+struct ircrate_t {
+	rl_limit_t user;
+	rl_limit_t chan;
+};
+
+struct ircfunc_t {
+	char *command;
+	char *usage;
+	int (*func)(irc_t *, ircmsg_t *, char *, arena_t *);
+	int minargs;
+	int maxargs; /* -1 for as many as they'd like */
+	int rate;
+};
+
+extern struct ircfunc_t ircfuncs[];
+extern int ircfuncs_len;
+extern struct ircrate_t ircrates[CMD_RATES];
+
+struct ircfunc_t *ircfunc_lookup(const char *name, int len);
+
+#define BANTER_FILE "banter.txt"
+
+int irc_bot_banter_init(char *path);
+int irc_bot_banter(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+
+int irc_botcmd_help(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_ping(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_smack(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_google(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_wiki(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_8ball(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_stats(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_grep(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_seen(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_lag(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+int irc_botcmd_remind(irc_t *irc, ircmsg_t *msg, char *arg, arena_t *ar);
+
+#define BOT_MAXADMINS 16
+#define BOT_MASKLEN   256
+
+int irc_bot_admin_add(char *mask);
+int irc_bot_allow(irc_t *irc, ircmsg_t *msg, int rate);
+
+#endif
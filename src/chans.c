@@ -0,0 +1,785 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 08:50
+ *
+ * Channel and User Tracking
+ *
+ * Who's in which of our channels, kept up to date from JOIN, PART, KICK,
+ * QUIT, NICK and the NAMES replies. Channels, users and memberships are
+ * records in three growable arrays, found through open addressing tables
+ * (linear probing, deletes shift the run back instead of leaving
+ * tombstones). Every user is one record however many channels they're in,
+ * and memberships sit on a channel list and a user list both, so a QUIT or
+ * a PART is a walk of one short list.
+ *
+ * The arrays and tables double when they fill, and freed records go on a
+ * free list, so once they've grown to fit the network nothing allocates.
+ *
+ * Names compare with RFC 1459 casemapping, where A-Z[\]^ are the upper case
+ * of a-z{|}~. The I/O thread is the only writer, anyone can read, under the
+ * rwlock.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chans.h"
+
+static int ch_grow(void **arr, int *cap, size_t size);
+static int ch_tabinit(struct ch_tab_t *t, int cap);
+static int ch_tabput(struct ch_tab_t *t, uint32_t hash, int idx);
+static void ch_tabdel(struct ch_tab_t *t, int slot);
+static uint32_t ch_membhash(int chan, int user);
+
+static int ch_findchan(chans_t *cs, const char *name, int len, uint32_t hash);
+static int ch_finduser(chans_t *cs, const char *nick, int len, uint32_t hash);
+static int ch_findmemb(chans_t *cs, int chan, int user, uint32_t hash);
+static int ch_getchan(chans_t *cs, const char *name, int len);
+static int ch_getuser(chans_t *cs, const char *nick, int len);
+static int ch_addmemb(chans_t *cs, int chan, int user);
+static void ch_delmemb(chans_t *cs, int m);
+static void ch_delchan(chans_t *cs, int chan);
+static void ch_empty(chans_t *cs, int chan);
+
+/* ch_init : sets up empty tables, nothing's allocated until it's needed */
+int ch_init(chans_t *cs)
+{
+	memset(cs, 0, sizeof(*cs));
+
+	cs->chanfree = cs->userfree = cs->membfree = -1;
+
+	if (pthread_rwlock_init(&cs->lock, NULL) != 0)
+		return -1;
+
+	return 0;
+}
+
+/* ch_free : frees everything, cs is left empty, so a second call is fine */
+void ch_free(chans_t *cs)
+{
+	pthread_rwlock_wrlock(&cs->lock);
+
+	free(cs->chans);
+	free(cs->users);
+	free(cs->membs);
+	free(cs->chantab.slots);
+	free(cs->usertab.slots);
+	free(cs->membtab.slots);
+
+	cs->chans = NULL;
+	cs->users = NULL;
+	cs->membs = NULL;
+	memset(&cs->chantab, 0, sizeof(cs->chantab));
+	memset(&cs->usertab, 0, sizeof(cs->usertab));
+	memset(&cs->membtab, 0, sizeof(cs->membtab));
+
+	cs->nchans = cs->chanused = cs->chancap = 0;
+	cs->nusers = cs->userused = cs->usercap = 0;
+	cs->nmembs = cs->membused = cs->membcap = 0;
+	cs->chanfree = cs->userfree = cs->membfree = -1;
+
+	pthread_rwlock_unlock(&cs->lock);
+}
+
+/* ch_clear : forgets every channel and user, keeps the memory for next time */
+void ch_clear(chans_t *cs)
+{
+	pthread_rwlock_wrlock(&cs->lock);
+
+	cs->nchans = cs->chanused = 0;
+	cs->nusers = cs->userused = 0;
+	cs->nmembs = cs->membused = 0;
+	cs->chanfree = cs->userfree = cs->membfree = -1;
+
+	if (cs->chantab.slots)
+		ch_tabinit(&cs->chantab, cs->chantab.cap);
+	if (cs->usertab.slots)
+		ch_tabinit(&cs->usertab, cs->usertab.cap);
+	if (cs->membtab.slots)
+		ch_tabinit(&cs->membtab, cs->membtab.cap);
+
+	pthread_rwlock_unlock(&cs->lock);
+}
+
+/* ch_join : nick joined chan, -1 if we couldn't make room for it */
+int ch_join(chans_t *cs, const char *chan, int clen, const char *nick, int nlen)
+{
+	int c, u, rc;
+
+	pthread_rwlock_wrlock(&cs->lock);
+
+	rc = -1;
+
+	if ((c = ch_getchan(cs, chan, clen)) >= 0 &&
+			(u = ch_getuser(cs, nick, nlen)) >= 0) {
+		rc = ch_addmemb(cs, c, u) < 0 ? -1 : 0;
+
+		/* a user we just made, that we couldn't put anywhere */
+		if (cs->users[u].nchans == 0)
+			ch_delmemb(cs, -1 - u);
+	}
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return rc;
+}
+
+/* ch_part : nick left chan, or got kicked from it */
+int ch_part(chans_t *cs, const char *chan, int clen, const char *nick, int nlen)
+{
+	int c, u, m, rc;
+
+	pthread_rwlock_wrlock(&cs->lock);
+
+	rc = -1;
+
+	if ((c = ch_findchan(cs, chan, clen, ch_casehash(chan, clen))) >= 0 &&
+			(u = ch_finduser(cs, nick, nlen, ch_casehash(nick, nlen))) >= 0) {
+		c = cs->chantab.slots[c].idx;
+		u = cs->usertab.slots[u].idx;
+
+		if ((m = ch_findmemb(cs, c, u, ch_membhash(c, u))) >= 0) {
+			ch_delmemb(cs, cs->membtab.slots[m].idx);
+			rc = 0;
+		}
+	}
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return rc;
+}
+
+/* ch_quit : nick left every channel at once */
+int ch_quit(chans_t *cs, const char *nick, int nlen)
+{
+	int u;
+
+	pthread_rwlock_wrlock(&cs->lock);
+
+	if ((u = ch_finduser(cs, nick, nlen, ch_casehash(nick, nlen))) >= 0) {
+		u = cs->usertab.slots[u].idx;
+
+		/* the last membership takes the user with it */
+		while (cs->users[u].nchans > 0)
+			ch_delmemb(cs, cs->users[u].first);
+	}
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return u < 0 ? -1 : 0;
+}
+
+/* ch_nick : old is now nick, every channel they're in sees the same record */
+int ch_nick(chans_t *cs, const char *old, int olen, const char *nick, int nlen)
+{
+	struct ch_user_t *user;
+	uint32_t hash;
+	int slot, u, rc;
+
+	if (nlen >= CH_NICKLEN)
+		return -1;
+
+	pthread_rwlock_wrlock(&cs->lock);
+
+	rc = -1;
+	hash = ch_casehash(nick, nlen);
+
+	if ((slot = ch_finduser(cs, old, olen, ch_casehash(old, olen))) >= 0) {
+		u = cs->usertab.slots[slot].idx;
+		user = &cs->users[u];
+
+		/* a case only change doesn't move it in the table */
+		if (hash == user->hash && ch_caseeq(user->nick, strlen(user->nick),
+					nick, nlen)) {
+			memcpy(user->nick, nick, nlen);
+			user->nick[nlen] = '\0';
+			rc = 0;
+		} else if (ch_finduser(cs, nick, nlen, hash) < 0) {
+			ch_tabdel(&cs->usertab, slot);
+			memcpy(user->nick, nick, nlen);
+			user->nick[nlen] = '\0';
+			user->hash = hash;
+			rc = ch_tabput(&cs->usertab, hash, u);
+		}
+	}
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return rc;
+}
+
+/* ch_drop : we left chan, forget it and everyone in it */
+int ch_drop(chans_t *cs, const char *chan, int clen)
+{
+	int c;
+
+	pthread_rwlock_wrlock(&cs->lock);
+
+	if ((c = ch_findchan(cs, chan, clen, ch_casehash(chan, clen))) >= 0)
+		ch_delchan(cs, cs->chantab.slots[c].idx);
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return c < 0 ? -1 : 0;
+}
+
+/* ch_names : a 353, the space separated (maybe prefixed) nicks in chan */
+int ch_names(chans_t *cs, const char *chan, int clen, const char *names, int len)
+{
+	const char *p, *end, *nick;
+	int c, u, n, rc;
+
+	pthread_rwlock_wrlock(&cs->lock);
+
+	rc = 0;
+
+	if ((c = ch_getchan(cs, chan, clen)) < 0) {
+		pthread_rwlock_unlock(&cs->lock);
+		return -1;
+	}
+
+	/* the first 353 of a reply replaces whatever we thought we knew */
+	if (!(cs->chans[c].flags & CH_NAMES)) {
+		ch_empty(cs, c);
+		cs->chans[c].flags |= CH_NAMES;
+	}
+
+	for (p = names, end = names + len; p < end; p++) {
+		if (*p == ' ')
+			continue;
+
+		/* skip the mode prefixes, multi-prefix can send more than one */
+		while (p < end && strchr("~&@%+", *p) && *p)
+			p++;
+
+		/* and userhost-in-names tacks on the !user@host */
+		for (nick = p; p < end && *p != ' ' && *p != '!'; p++)
+			;
+		n = p - nick;
+
+		while (p < end && *p != ' ')
+			p++;
+
+		if (n == 0)
+			continue;
+
+		if ((u = ch_getuser(cs, nick, n)) < 0 || ch_addmemb(cs, c, u) < 0) {
+			rc = -1;
+			if (u >= 0 && cs->users[u].nchans == 0)
+				ch_delmemb(cs, -1 - u);
+		}
+	}
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return rc;
+}
+
+/* ch_namesend : a 366, the NAMES reply for chan is done */
+int ch_namesend(chans_t *cs, const char *chan, int clen)
+{
+	int c;
+
+	pthread_rwlock_wrlock(&cs->lock);
+
+	if ((c = ch_findchan(cs, chan, clen, ch_casehash(chan, clen))) >= 0)
+		cs->chans[cs->chantab.slots[c].idx].flags &= ~CH_NAMES;
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return c < 0 ? -1 : 0;
+}
+
+/* ch_ison : true if nick is in chan */
+int ch_ison(chans_t *cs, const char *chan, int clen, const char *nick, int nlen)
+{
+	int c, u, rc;
+
+	pthread_rwlock_rdlock(&cs->lock);
+
+	rc = 0;
+
+	if ((c = ch_findchan(cs, chan, clen, ch_casehash(chan, clen))) >= 0 &&
+			(u = ch_finduser(cs, nick, nlen, ch_casehash(nick, nlen))) >= 0) {
+		c = cs->chantab.slots[c].idx;
+		u = cs->usertab.slots[u].idx;
+		rc = ch_findmemb(cs, c, u, ch_membhash(c, u)) >= 0;
+	}
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return rc;
+}
+
+/* ch_members : how many are in chan, -1 if we aren't tracking it */
+int ch_members(chans_t *cs, const char *chan, int clen)
+{
+	int c, n;
+
+	pthread_rwlock_rdlock(&cs->lock);
+
+	n = -1;
+	if ((c = ch_findchan(cs, chan, clen, ch_casehash(chan, clen))) >= 0)
+		n = cs->chans[cs->chantab.slots[c].idx].nmembers;
+
+	pthread_rwlock_unlock(&cs->lock);
+
+	return n;
+}
+
+/* ch_stats : how many channels, users and memberships there are */
+void ch_stats(chans_t *cs, int *nchans, int *nusers, int *nmembs)
+{
+	pthread_rwlock_rdlock(&cs->lock);
+
+	*nchans = cs->nchans;
+	*nusers = cs->nusers;
+	*nmembs = cs->nmembs;
+
+	pthread_rwlock_unlock(&cs->lock);
+}
+
+/* ch_casehash : hashes s as if it were all lower case */
+uint32_t ch_casehash(const char *s, int len)
+{
+	uint32_t h;
+	int i;
+
+	h = 2166136261u;
+
+	for (i = 0; i < len; i++) {
+		h ^= ch_fold(s[i]);
+		h *= 16777619u;
+	}
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/* ch_caseeq : true if a and b are the same name, ignoring case */
+int ch_caseeq(const char *a, int alen, const char *b, int blen)
+{
+	int i;
+
+	if (alen != blen)
+		return 0;
+
+	for (i = 0; i < alen; i++) {
+		if (ch_fold(a[i]) != ch_fold(b[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* ch_ischan : true if s names a channel, rather than a nick */
+int ch_ischan(const char *s, int len)
+{
+	return len > 0 && strchr("#&+!", *s) && *s;
+}
+
+/* ch_grow : doubles an array of size byte records */
+static int ch_grow(void **arr, int *cap, size_t size)
+{
+	void *p;
+	int n;
+
+	n = *cap ? *cap * 2 : CH_MINCAP;
+
+	if (!(p = realloc(*arr, n * size)))
+		return -1;
+
+	*arr = p;
+	*cap = n;
+
+	return 0;
+}
+
+/* ch_tabinit : empties t, at cap slots */
+static int ch_tabinit(struct ch_tab_t *t, int cap)
+{
+	struct ch_slot_t *slots;
+	int i;
+
+	if (t->cap != cap || !t->slots) {
+		if (!(slots = malloc(cap * sizeof(*slots))))
+			return -1;
+		free(t->slots);
+		t->slots = slots;
+		t->cap = cap;
+	}
+
+	for (i = 0; i < cap; i++)
+		t->slots[i].idx = -1;
+
+	t->used = 0;
+
+	return 0;
+}
+
+/* ch_tabput : adds idx under hash, doubling t if it's getting full */
+static int ch_tabput(struct ch_tab_t *t, uint32_t hash, int idx)
+{
+	struct ch_tab_t bigger;
+	int i, mask;
+
+	/* keep it under 3/4 full, the probe runs get long after that */
+	if ((t->used + 1) * 4 > t->cap * 3) {
+		memset(&bigger, 0, sizeof(bigger));
+
+		if (ch_tabinit(&bigger, t->cap ? t->cap * 2 : CH_MINCAP) < 0)
+			return -1;
+
+		for (i = 0; i < t->cap; i++) {
+			if (t->slots[i].idx >= 0)
+				ch_tabput(&bigger, t->slots[i].hash, t->slots[i].idx);
+		}
+
+		free(t->slots);
+		*t = bigger;
+	}
+
+	mask = t->cap - 1;
+
+	for (i = hash & mask; t->slots[i].idx >= 0; i = (i + 1) & mask)
+		;
+
+	t->slots[i].hash = hash;
+	t->slots[i].idx = idx;
+	t->used++;
+
+	return 0;
+}
+
+/* ch_tabdel : empties slot, and shifts the rest of its run back over it */
+static void ch_tabdel(struct ch_tab_t *t, int slot)
+{
+	int i, j, home, mask;
+
+	mask = t->cap - 1;
+
+	for (i = slot, j = (slot + 1) & mask; t->slots[j].idx >= 0; j = (j + 1) & mask) {
+		home = t->slots[j].hash & mask;
+
+		/* j can move back to i if its home isn't in (i, j] */
+		if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+			t->slots[i] = t->slots[j];
+			i = j;
+		}
+	}
+
+	t->slots[i].idx = -1;
+	t->used--;
+}
+
+/* ch_membhash : hashes a (channel, user) pair */
+static uint32_t ch_membhash(int chan, int user)
+{
+	uint32_t h;
+
+	h = (uint32_t)chan * 0x9e3779b1u ^ (uint32_t)user;
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/* ch_findchan : the slot chan is in, -1 if it isn't */
+static int ch_findchan(chans_t *cs, const char *name, int len, uint32_t hash)
+{
+	struct ch_tab_t *t;
+	struct ch_chan_t *c;
+	int i, mask;
+
+	t = &cs->chantab;
+	if (!t->slots)
+		return -1;
+
+	mask = t->cap - 1;
+
+	for (i = hash & mask; t->slots[i].idx >= 0; i = (i + 1) & mask) {
+		if (t->slots[i].hash != hash)
+			continue;
+
+		c = &cs->chans[t->slots[i].idx];
+		if (ch_caseeq(c->name, strlen(c->name), name, len))
+			return i;
+	}
+
+	return -1;
+}
+
+/* ch_finduser : the slot nick is in, -1 if it isn't */
+static int ch_finduser(chans_t *cs, const char *nick, int len, uint32_t hash)
+{
+	struct ch_tab_t *t;
+	struct ch_user_t *u;
+	int i, mask;
+
+	t = &cs->usertab;
+	if (!t->slots)
+		return -1;
+
+	mask = t->cap - 1;
+
+	for (i = hash & mask; t->slots[i].idx >= 0; i = (i + 1) & mask) {
+		if (t->slots[i].hash != hash)
+			continue;
+
+		u = &cs->users[t->slots[i].idx];
+		if (ch_caseeq(u->nick, strlen(u->nick), nick, len))
+			return i;
+	}
+
+	return -1;
+}
+
+/* ch_findmemb : the slot the (chan, user) membership is in, -1 if it isn't */
+static int ch_findmemb(chans_t *cs, int chan, int user, uint32_t hash)
+{
+	struct ch_tab_t *t;
+	struct ch_memb_t *m;
+	int i, mask;
+
+	t = &cs->membtab;
+	if (!t->slots)
+		return -1;
+
+	mask = t->cap - 1;
+
+	for (i = hash & mask; t->slots[i].idx >= 0; i = (i + 1) & mask) {
+		if (t->slots[i].hash != hash)
+			continue;
+
+		m = &cs->membs[t->slots[i].idx];
+		if (m->chan == chan && m->user == user)
+			return i;
+	}
+
+	return -1;
+}
+
+/* ch_getchan : finds chan, or adds it, returns its record or -1 */
+static int ch_getchan(chans_t *cs, const char *name, int len)
+{
+	struct ch_chan_t *c;
+	uint32_t hash;
+	int slot, i;
+
+	if (len <= 0 || len >= CH_NAMELEN)
+		return -1;
+
+	hash = ch_casehash(name, len);
+
+	if ((slot = ch_findchan(cs, name, len, hash)) >= 0)
+		return cs->chantab.slots[slot].idx;
+
+	if (cs->chanfree >= 0) {
+		i = cs->chanfree;
+		cs->chanfree = cs->chans[i].link;
+	} else {
+		if (cs->chanused == cs->chancap &&
+				ch_grow((void **)&cs->chans, &cs->chancap, sizeof(*c)) < 0)
+			return -1;
+		i = cs->chanused++;
+	}
+
+	c = &cs->chans[i];
+	memcpy(c->name, name, len);
+	c->name[len] = '\0';
+	c->hash = hash;
+	c->first = -1;
+	c->nmembers = 0;
+	c->flags = 0;
+
+	if (ch_tabput(&cs->chantab, hash, i) < 0) {
+		c->link = cs->chanfree;
+		cs->chanfree = i;
+		return -1;
+	}
+
+	cs->nchans++;
+
+	return i;
+}
+
+/* ch_getuser : finds nick, or interns it, returns its record or -1 */
+static int ch_getuser(chans_t *cs, const char *nick, int len)
+{
+	struct ch_user_t *u;
+	uint32_t hash;
+	int slot, i;
+
+	if (len <= 0 || len >= CH_NICKLEN)
+		return -1;
+
+	hash = ch_casehash(nick, len);
+
+	if ((slot = ch_finduser(cs, nick, len, hash)) >= 0)
+		return cs->usertab.slots[slot].idx;
+
+	if (cs->userfree >= 0) {
+		i = cs->userfree;
+		cs->userfree = cs->users[i].link;
+	} else {
+		if (cs->userused == cs->usercap &&
+				ch_grow((void **)&cs->users, &cs->usercap, sizeof(*u)) < 0)
+			return -1;
+		i = cs->userused++;
+	}
+
+	u = &cs->users[i];
+	memcpy(u->nick, nick, len);
+	u->nick[len] = '\0';
+	u->hash = hash;
+	u->first = -1;
+	u->nchans = 0;
+
+	if (ch_tabput(&cs->usertab, hash, i) < 0) {
+		u->link = cs->userfree;
+		cs->userfree = i;
+		return -1;
+	}
+
+	cs->nusers++;
+
+	return i;
+}
+
+/* ch_addmemb : puts user in chan, if they aren't already */
+static int ch_addmemb(chans_t *cs, int chan, int user)
+{
+	struct ch_memb_t *m;
+	uint32_t hash;
+	int i;
+
+	hash = ch_membhash(chan, user);
+
+	if (ch_findmemb(cs, chan, user, hash) >= 0)
+		return 0;
+
+	if (cs->membfree >= 0) {
+		i = cs->membfree;
+		cs->membfree = cs->membs[i].cnext;
+	} else {
+		if (cs->membused == cs->membcap &&
+				ch_grow((void **)&cs->membs, &cs->membcap, sizeof(*m)) < 0)
+			return -1;
+		i = cs->membused++;
+	}
+
+	if (ch_tabput(&cs->membtab, hash, i) < 0) {
+		cs->membs[i].cnext = cs->membfree;
+		cs->membfree = i;
+		return -1;
+	}
+
+	m = &cs->membs[i];
+	m->chan = chan;
+	m->user = user;
+
+	/* on the front of both lists */
+	m->cprev = -1;
+	m->cnext = cs->chans[chan].first;
+	if (m->cnext >= 0)
+		cs->membs[m->cnext].cprev = i;
+	cs->chans[chan].first = i;
+	cs->chans[chan].nmembers++;
+
+	m->uprev = -1;
+	m->unext = cs->users[user].first;
+	if (m->unext >= 0)
+		cs->membs[m->unext].uprev = i;
+	cs->users[user].first = i;
+	cs->users[user].nchans++;
+
+	cs->nmembs++;
+
+	return 0;
+}
+
+/*
+ * ch_delmemb : takes membership m off both lists, and frees the user if it
+ * was their last channel. A negative m, -1 - user, frees a user that never
+ * got a membership.
+ */
+static void ch_delmemb(chans_t *cs, int m)
+{
+	struct ch_memb_t *mb;
+	struct ch_user_t *u;
+	int user, slot;
+
+	if (m >= 0) {
+		mb = &cs->membs[m];
+		user = mb->user;
+
+		if (mb->cprev >= 0)
+			cs->membs[mb->cprev].cnext = mb->cnext;
+		else
+			cs->chans[mb->chan].first = mb->cnext;
+		if (mb->cnext >= 0)
+			cs->membs[mb->cnext].cprev = mb->cprev;
+
+		if (mb->uprev >= 0)
+			cs->membs[mb->uprev].unext = mb->unext;
+		else
+			cs->users[user].first = mb->unext;
+		if (mb->unext >= 0)
+			cs->membs[mb->unext].uprev = mb->uprev;
+
+		cs->chans[mb->chan].nmembers--;
+		cs->users[user].nchans--;
+
+		slot = ch_findmemb(cs, mb->chan, user, ch_membhash(mb->chan, user));
+		ch_tabdel(&cs->membtab, slot);
+
+		mb->cnext = cs->membfree;
+		cs->membfree = m;
+		cs->nmembs--;
+	} else {
+		user = -1 - m;
+	}
+
+	u = &cs->users[user];
+	if (u->nchans > 0)
+		return;
+
+	slot = ch_finduser(cs, u->nick, strlen(u->nick), u->hash);
+	ch_tabdel(&cs->usertab, slot);
+
+	u->link = cs->userfree;
+	cs->userfree = user;
+	cs->nusers--;
+}
+
+/* ch_empty : takes everyone out of chan */
+static void ch_empty(chans_t *cs, int chan)
+{
+	while (cs->chans[chan].first >= 0)
+		ch_delmemb(cs, cs->chans[chan].first);
+}
+
+/* ch_delchan : empties chan, and forgets it */
+static void ch_delchan(chans_t *cs, int chan)
+{
+	struct ch_chan_t *c;
+
+	ch_empty(cs, chan);
+
+	c = &cs->chans[chan];
+	ch_tabdel(&cs->chantab,
+			ch_findchan(cs, c->name, strlen(c->name), c->hash));
+
+	c->link = cs->chanfree;
+	cs->chanfree = chan;
+	cs->nchans--;
+}
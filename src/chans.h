@@ -0,0 +1,103 @@
+#ifndef CHANS_H
+#define CHANS_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 08:50
+ *
+ * Channel and User Tracking
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define CH_NICKLEN 32 /* longer than any NICKLEN we've seen advertised */
+#define CH_NAMELEN 64
+#define CH_MINCAP  64 /* records and slots the tables start out with */
+
+#define CH_NAMES 0x01 /* a NAMES reply is coming in, 366 ends it */
+
+/* a slot in an open addressing table, idx is -1 when it's empty */
+struct ch_slot_t {
+	uint32_t hash;
+	int idx;
+};
+
+struct ch_tab_t {
+	struct ch_slot_t *slots;
+	int cap; /* a power of two */
+	int used;
+};
+
+/* a nick, interned, everything else refers to it by its index */
+struct ch_user_t {
+	char nick[CH_NICKLEN];
+	uint32_t hash;
+	int first;  /* the user's first membership */
+	int nchans;
+	int link;   /* next free record, when it's free */
+};
+
+struct ch_chan_t {
+	char name[CH_NAMELEN];
+	uint32_t hash;
+	int first;  /* the channel's first membership */
+	int nmembers;
+	int flags;
+	int link;
+};
+
+/* one user in one channel, on both of their lists */
+struct ch_memb_t {
+	int chan;
+	int user;
+	int cnext, cprev;
+	int unext, uprev;
+};
+
+struct chans_t {
+	pthread_rwlock_t lock;
+
+	struct ch_chan_t *chans;
+	int nchans, chanused, chancap, chanfree;
+
+	struct ch_user_t *users;
+	int nusers, userused, usercap, userfree;
+
+	struct ch_memb_t *membs;
+	int nmembs, membused, membcap, membfree;
+
+	struct ch_tab_t chantab;
+	struct ch_tab_t usertab;
+	struct ch_tab_t membtab;
+};
+
+typedef struct chans_t chans_t;
+
+int ch_init(chans_t *cs);
+void ch_free(chans_t *cs);
+void ch_clear(chans_t *cs);
+
+int ch_join(chans_t *cs, const char *chan, int clen, const char *nick, int nlen);
+int ch_part(chans_t *cs, const char *chan, int clen, const char *nick, int nlen);
+int ch_quit(chans_t *cs, const char *nick, int nlen);
+int ch_nick(chans_t *cs, const char *old, int olen, const char *nick, int nlen);
+int ch_drop(chans_t *cs, const char *chan, int clen);
+int ch_names(chans_t *cs, const char *chan, int clen, const char *names, int len);
+int ch_namesend(chans_t *cs, const char *chan, int clen);
+
+int ch_ison(chans_t *cs, const char *chan, int clen, const char *nick, int nlen);
+int ch_members(chans_t *cs, const char *chan, int clen);
+void ch_stats(chans_t *cs, int *nchans, int *nusers, int *nmembs);
+
+/* ch_fold : RFC 1459 lower case */
+static inline unsigned char ch_fold(unsigned char c)
+{
+	return c >= 'A' && c <= '^' ? c + 32 : c;
+}
+
+uint32_t ch_casehash(const char *s, int len);
+int ch_caseeq(const char *a, int alen, const char *b, int blen);
+int ch_ischan(const char *s, int len);
+
+#endif
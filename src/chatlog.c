@@ -0,0 +1,642 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 12:30
+ *
+ * Chat Logs
+ *
+ * What people say goes in its own file per network, channel and day,
+ * dir/network/#channel/YYYY-MM-DD.log, instead of in the middle of the
+ * debug log. Logging a line is a memcpy into a buffer under a lock, the
+ * clock is read, not formatted, and nothing touches the disk.
+ *
+ * A writer thread swaps the buffer out every CL_WAIT_MS (or sooner, if it's
+ * filling up), and sorts the records into shards, one per open file. Each
+ * shard gathers its lines and gets one write() per batch, however many
+ * lines it got. Timestamps come from a clock that's only formatted again
+ * when the second changes, and the day changing is just the next record
+ * for a shard having a different date, so the old file gets closed and the
+ * new one opened by the writer, the I/O thread never waits on it.
+ *
+ * With a sync interval, the writer fdatasync()s every file it's written to
+ * at most that often, so a crash loses no more than that much of the log
+ * and a busy channel doesn't pay a sync per line.
+ *
+ * A day's file that's been rotated away from is handed to logz to compress,
+ * and every line that's written goes to search to be indexed, with where it
+ * landed in its file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "chatlog.h"
+#include "chans.h"
+#include "logz.h"
+#include "search.h"
+#include "metrics.h"
+#include "fio.h"
+#include "common.h"
+
+#define CL_TEXTLEN 1024 /* longer lines get cut, IRC's are 512 anyway */
+
+/* a queued line, the names and text follow it, padded out to 8 bytes */
+struct cl_rec_t {
+	int64_t when;
+	uint16_t netlen;
+	uint16_t chanlen;
+	uint16_t nicklen;
+	uint16_t textlen;
+	uint32_t flags;
+};
+
+/* an open log file, and the lines it's gathered since the last write */
+struct cl_shard_t {
+	char net[CL_NAMELEN];
+	char chan[CL_NAMELEN]; /* casemapped, #Foo and #foo are the same file */
+	uint32_t hash;
+	int next; /* the bucket's chain, -1 at the end */
+	int used;
+	int fd;
+	int day;
+	char date[16]; /* day's, as it is in the file name */
+	int dirty; /* written since the last sync */
+	int chanid; /* the search index's */
+	uint64_t size; /* of the file, where the next write lands */
+	uint64_t last;
+	int len;
+	char buf[CL_SHARDBUF];
+};
+
+/* the last second we formatted, records mostly come in a second at a time */
+struct cl_clock_t {
+	time_t sec;
+	int day;
+	char hms[16];
+	char date[16];
+};
+
+static char cldir[PATH_MAX];
+static int clsync;
+
+static pthread_mutex_t qlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t qwake = PTHREAD_COND_INITIALIZER;
+static char *qbuf[2];
+static int qcur, qlen;
+static int running;
+static pthread_t writer;
+
+/* the writer's, nobody else touches these */
+static struct cl_shard_t *shards;
+static int buckets[CL_BUCKETS];
+static struct cl_clock_t clk;
+static uint64_t lastsync, lastsweep;
+
+static void *cl_writer(void *arg);
+static void cl_route(char *buf, int len);
+static struct cl_shard_t *cl_shard(const char *net, int netlen,
+		const char *chan, int chanlen, time_t when);
+static int cl_shardopen(struct cl_shard_t *sh);
+static void cl_shardflush(struct cl_shard_t *sh);
+static void cl_shardclose(struct cl_shard_t *sh);
+static void cl_tend(uint64_t now);
+static void cl_tick(time_t when);
+static int cl_name(char *dst, const char *src, int len, int fold);
+static int cl_mkdirs(char *path);
+static void cl_writeall(int fd, char *buf, int len);
+
+/* cl_open : starts logging chat under dir, syncing every sync_ms (0 never) */
+int cl_open(const char *dir, int sync_ms)
+{
+	sigset_t all, old;
+	char path[PATH_MAX];
+	int i;
+
+	if (running)
+		return 0;
+
+	snprintf(cldir, sizeof(cldir), "%s", dir);
+	clsync = sync_ms;
+
+	qbuf[0] = malloc(CL_BUFSIZE);
+	qbuf[1] = malloc(CL_BUFSIZE);
+	shards = calloc(CL_SHARDS, sizeof(*shards));
+
+	if (!qbuf[0] || !qbuf[1] || !shards)
+		goto err;
+
+	for (i = 0; i < CL_BUCKETS; i++)
+		buckets[i] = -1;
+	for (i = 0; i < CL_SHARDS; i++)
+		shards[i].fd = -1;
+
+	qcur = qlen = 0;
+	clk.sec = -1;
+	lastsync = lastsweep = now_ms();
+
+	/* what's logged gets indexed for searches, see search.c */
+	snprintf(path, sizeof(path), "%s", cldir);
+	if (cl_mkdirs(path) < 0 || sr_open(cldir) < 0)
+		FIO_PRINTF(FIO_WRN, "Chat Logs in %s Won't be Searchable", cldir);
+
+	running = 1;
+
+	/* signals belong to the main thread, the writer never sees them */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+
+	if (pthread_create(&writer, NULL, cl_writer, NULL) != 0) {
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		running = 0;
+		sr_close();
+		goto err;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	/* older days get compressed in the background, see logz.c */
+	if (lz_start(cldir) < 0)
+		FIO_PRINTF(FIO_WRN, "Couldn't Start the Chat Log Compressor");
+
+	return 0;
+
+err:
+	free(qbuf[0]);
+	free(qbuf[1]);
+	free(shards);
+	qbuf[0] = qbuf[1] = NULL;
+	shards = NULL;
+	return -1;
+}
+
+/* cl_close : writes out (and syncs) everything still queued, then stops */
+void cl_close(void)
+{
+	pthread_mutex_lock(&qlock);
+
+	if (!running) {
+		pthread_mutex_unlock(&qlock);
+		return;
+	}
+
+	running = 0;
+	pthread_cond_signal(&qwake);
+	pthread_mutex_unlock(&qlock);
+
+	pthread_join(writer, NULL);
+	sr_close();
+	lz_stop();
+
+	free(qbuf[0]);
+	free(qbuf[1]);
+	free(shards);
+	qbuf[0] = qbuf[1] = NULL;
+	shards = NULL;
+}
+
+/*
+ * cl_log : queues a line nick said in chan on net, -1 if it was dropped
+ * because the writer's that far behind. Messages that are a CTCP ACTION get
+ * logged as one, and with CL_SELF (our own) don't get indexed for searches.
+ */
+int cl_log(const char *net, const char *chan, int chanlen,
+		const char *nick, int nicklen, const char *text, int textlen, int flags)
+{
+	struct cl_rec_t rec;
+	char *p;
+	int netlen, need;
+
+	netlen = strlen(net);
+	rec.netlen = netlen < CL_NAMELEN ? netlen : CL_NAMELEN - 1;
+	rec.chanlen = chanlen < CL_NAMELEN ? chanlen : CL_NAMELEN - 1;
+	rec.nicklen = nicklen < CL_NAMELEN ? nicklen : CL_NAMELEN - 1;
+	rec.textlen = textlen < CL_TEXTLEN ? textlen : CL_TEXTLEN;
+	rec.when = time(NULL);
+	rec.flags = flags;
+
+	need = sizeof(rec) + rec.netlen + rec.chanlen + rec.nicklen + rec.textlen;
+	need = (need + 7) & ~7;
+
+	pthread_mutex_lock(&qlock);
+
+	if (!running) {
+		pthread_mutex_unlock(&qlock);
+		return 0;
+	}
+
+	if (qlen + need > CL_BUFSIZE) {
+		pthread_mutex_unlock(&qlock);
+		met_inc(MET_CHATLOG_DROPPED);
+		return -1;
+	}
+
+	p = qbuf[qcur] + qlen;
+	memcpy(p, &rec, sizeof(rec));
+	p += sizeof(rec);
+	memcpy(p, net, rec.netlen);
+	p += rec.netlen;
+	memcpy(p, chan, rec.chanlen);
+	p += rec.chanlen;
+	memcpy(p, nick, rec.nicklen);
+	p += rec.nicklen;
+	memcpy(p, text, rec.textlen);
+
+	/* the writer's on a timer, only hurry it when the buffer's half full */
+	if (qlen < CL_BUFSIZE / 2 && qlen + need >= CL_BUFSIZE / 2)
+		pthread_cond_signal(&qwake);
+	qlen += need;
+
+	pthread_mutex_unlock(&qlock);
+
+	met_inc(MET_CHATLOG_RECORDS);
+
+	return 0;
+}
+
+/* cl_key : where chan on net's logs are, under the log directory, "net/#chan" */
+int cl_key(char *buf, int len, const char *net, const char *chan, int chanlen)
+{
+	char nbuf[CL_NAMELEN], cbuf[CL_NAMELEN];
+
+	cl_name(nbuf, net, strlen(net), 0);
+	cl_name(cbuf, chan, chanlen, 1);
+
+	return snprintf(buf, len, "%s/%s", nbuf, cbuf);
+}
+
+/* cl_writer : the writer thread, a batch every CL_WAIT_MS until we stop */
+static void *cl_writer(void *arg)
+{
+	struct timespec ts;
+	char *buf;
+	int len, stop;
+
+	for (stop = 0; !stop;) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += CL_WAIT_MS * 1000000L;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&qlock);
+
+		while (running && qlen < CL_BUFSIZE / 2) {
+			if (pthread_cond_timedwait(&qwake, &qlock, &ts) == ETIMEDOUT)
+				break;
+		}
+
+		/* swap, the producers carry on in the other buffer */
+		buf = qbuf[qcur];
+		len = qlen;
+		qcur ^= 1;
+		qlen = 0;
+		stop = !running;
+
+		pthread_mutex_unlock(&qlock);
+
+		cl_route(buf, len);
+		cl_tend(stop ? UINT64_MAX : now_ms());
+		sr_tick(now_ms());
+	}
+
+	return NULL;
+}
+
+/* cl_route : sorts a batch of records into their shards' buffers */
+static void cl_route(char *buf, int len)
+{
+	struct cl_rec_t rec;
+	struct cl_shard_t *sh;
+	char *p, *net, *chan, *nick, *text;
+	uint64_t at;
+	int off, n, room, textlen;
+
+	for (off = 0; off < len;) {
+		memcpy(&rec, buf + off, sizeof(rec));
+		p = buf + off + sizeof(rec);
+		net = p;
+		chan = net + rec.netlen;
+		nick = chan + rec.chanlen;
+		text = nick + rec.nicklen;
+		textlen = rec.textlen;
+
+		off += (sizeof(rec) + rec.netlen + rec.chanlen + rec.nicklen +
+				rec.textlen + 7) & ~7;
+
+		cl_tick(rec.when);
+
+		if ((sh = cl_shard(net, rec.netlen, chan, rec.chanlen, rec.when)) == NULL)
+			continue;
+
+		/* room for the longest line we could make out of this record */
+		if (sh->len + CL_NAMELEN + CL_TEXTLEN + 32 > CL_SHARDBUF)
+			cl_shardflush(sh);
+
+		room = CL_SHARDBUF - sh->len;
+		at = sh->size + sh->len;
+
+		if (textlen >= 8 && memcmp(text, "\001ACTION ", 8) == 0) {
+			text += 8;
+			textlen -= 8;
+			if (textlen > 0 && text[textlen - 1] == '\001')
+				textlen--;
+			n = snprintf(sh->buf + sh->len, room, "[%s] * %.*s %.*s\n",
+					clk.hms, rec.nicklen, nick, textlen, text);
+		} else {
+			n = snprintf(sh->buf + sh->len, room, "[%s] <%.*s> %.*s\n",
+					clk.hms, rec.nicklen, nick, textlen, text);
+		}
+
+		sh->len += n < room ? n : room - 1;
+
+		if (!(rec.flags & CL_SELF))
+			sr_add(sh->chanid, rec.when, at, nick, rec.nicklen, text, textlen);
+	}
+}
+
+/*
+ * cl_shard : the shard for chan on net, opened for when's day. A new day
+ * closes yesterday's file first, and a new shard when they're all in use
+ * pushes out the one that's been quiet the longest. NULL if the file can't
+ * be opened.
+ */
+static struct cl_shard_t *cl_shard(const char *net, int netlen,
+		const char *chan, int chanlen, time_t when)
+{
+	struct cl_shard_t *sh;
+	char nbuf[CL_NAMELEN], cbuf[CL_NAMELEN], path[PATH_MAX];
+	uint32_t hash;
+	int i, *pp;
+
+	cl_name(nbuf, net, netlen, 0);
+	cl_name(cbuf, chan, chanlen, 1);
+	hash = ch_casehash(nbuf, strlen(nbuf)) * 31 + ch_casehash(cbuf, strlen(cbuf));
+
+	for (i = buckets[hash & (CL_BUCKETS - 1)]; i >= 0; i = shards[i].next) {
+		sh = &shards[i];
+		if (sh->hash == hash && strcmp(sh->net, nbuf) == 0 &&
+				strcmp(sh->chan, cbuf) == 0)
+			break;
+	}
+
+	if (i < 0) {
+		/* a free one, or the one that's been quiet the longest */
+		for (i = 0, sh = NULL; i < CL_SHARDS; i++) {
+			if (!shards[i].used) {
+				sh = &shards[i];
+				break;
+			}
+			if (!sh || shards[i].last < sh->last)
+				sh = &shards[i];
+		}
+
+		if (sh->used)
+			cl_shardclose(sh);
+
+		snprintf(sh->net, sizeof(sh->net), "%s", nbuf);
+		snprintf(sh->chan, sizeof(sh->chan), "%s", cbuf);
+		sh->hash = hash;
+		sh->used = 1;
+		sh->day = -1;
+		snprintf(path, sizeof(path), "%s/%s", nbuf, cbuf);
+		sh->chanid = sr_chan(path);
+		pp = &buckets[hash & (CL_BUCKETS - 1)];
+		sh->next = *pp;
+		*pp = sh - shards;
+	}
+
+	sh->last = now_ms();
+
+	if (sh->day != clk.day) {
+		cl_shardflush(sh);
+		if (sh->fd >= 0) {
+			if (clsync > 0 && sh->dirty)
+				fdatasync(sh->fd);
+			close(sh->fd);
+			sh->fd = -1;
+			sh->dirty = 0;
+
+			/* that day's done, it can be compressed */
+			if (snprintf(path, sizeof(path), "%s/%s/%s/%s.log", cldir,
+						sh->net, sh->chan, sh->date) < sizeof(path))
+				lz_queue(path);
+		}
+
+		/* once a day, a file we can't open doesn't get tried for every line */
+		sh->day = clk.day;
+		cl_shardopen(sh);
+	}
+
+	return sh->fd < 0 ? NULL : sh;
+}
+
+/* cl_shardopen : opens sh's file for today, making the directories it needs */
+static int cl_shardopen(struct cl_shard_t *sh)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	int n;
+
+	n = snprintf(path, sizeof(path), "%s/%s/%s", cldir, sh->net, sh->chan);
+	if (n >= sizeof(path) - 16 || cl_mkdirs(path) < 0) {
+		FIO_PRINTF(FIO_WRN, "Couldn't Make Chat Log Directory %s", path);
+		return -1;
+	}
+
+	snprintf(sh->date, sizeof(sh->date), "%s", clk.date);
+	snprintf(path + n, sizeof(path) - n, "/%s.log", sh->date);
+
+	sh->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (sh->fd < 0) {
+		FIO_PRINTF(FIO_WRN, "Couldn't Open Chat Log %s : %s", path,
+				strerror(errno));
+		return -1;
+	}
+
+	/* the index wants to know where each line is */
+	sh->size = fstat(sh->fd, &st) == 0 ? st.st_size : 0;
+
+	return 0;
+}
+
+/* cl_shardflush : writes out what sh's gathered, in one go */
+static void cl_shardflush(struct cl_shard_t *sh)
+{
+	if (sh->len == 0)
+		return;
+
+	if (sh->fd >= 0) {
+		cl_writeall(sh->fd, sh->buf, sh->len);
+		met_add(MET_CHATLOG_BYTES, sh->len);
+		sh->size += sh->len;
+		sh->dirty = 1;
+	}
+
+	sh->len = 0;
+}
+
+/* cl_shardclose : flushes, syncs and closes sh, and takes it off its chain */
+static void cl_shardclose(struct cl_shard_t *sh)
+{
+	int *pp;
+
+	cl_shardflush(sh);
+
+	if (sh->fd >= 0) {
+		if (clsync > 0 && sh->dirty)
+			fdatasync(sh->fd);
+		close(sh->fd);
+	}
+
+	for (pp = &buckets[sh->hash & (CL_BUCKETS - 1)]; *pp >= 0;
+			pp = &shards[*pp].next) {
+		if (*pp == sh - shards) {
+			*pp = sh->next;
+			break;
+		}
+	}
+
+	sh->used = 0;
+	sh->fd = -1;
+	sh->dirty = 0;
+	sh->len = 0;
+}
+
+/*
+ * cl_tend : after a batch, writes every shard out, syncs them if it's time,
+ * and closes the ones that have gone quiet. now of UINT64_MAX is shutting
+ * down, which closes the lot.
+ */
+static void cl_tend(uint64_t now)
+{
+	struct cl_shard_t *sh;
+	int i, sync;
+
+	sync = clsync > 0 && now - lastsync >= clsync;
+	if (sync)
+		lastsync = now;
+
+	for (i = 0; i < CL_SHARDS; i++) {
+		sh = &shards[i];
+		if (!sh->used)
+			continue;
+
+		cl_shardflush(sh);
+
+		if (sync && sh->dirty) {
+			fdatasync(sh->fd);
+			met_inc(MET_CHATLOG_SYNCS);
+			sh->dirty = 0;
+		}
+	}
+
+	/* closing quiet shards can wait for a second to go by */
+	if (now - lastsweep < 1000)
+		return;
+
+	lastsweep = now;
+
+	for (i = 0; i < CL_SHARDS; i++) {
+		sh = &shards[i];
+		if (sh->used && (now == UINT64_MAX || now - sh->last >= CL_IDLE_MS))
+			cl_shardclose(sh);
+	}
+}
+
+/* cl_tick : moves the clock to when, it's only formatted when that changes */
+static void cl_tick(time_t when)
+{
+	struct tm tm;
+
+	if (when == clk.sec)
+		return;
+
+	localtime_r(&when, &tm);
+
+	clk.sec = when;
+	clk.day = (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+	strftime(clk.hms, sizeof(clk.hms), "%H:%M:%S", &tm);
+	strftime(clk.date, sizeof(clk.date), "%Y-%m-%d", &tm);
+}
+
+/*
+ * cl_name : src as a single path component, in a CL_NAMELEN buffer. There's
+ * nothing stopping a channel from having a / in it, or being called "..".
+ * With fold, it's casemapped too.
+ */
+static int cl_name(char *dst, const char *src, int len, int fold)
+{
+	int i;
+	char c;
+
+	if (len > CL_NAMELEN - 2)
+		len = CL_NAMELEN - 2;
+
+	i = 0;
+	if (len == 0 || src[0] == '.')
+		dst[i++] = '_';
+
+	for (; len > 0; src++, len--) {
+		c = *src;
+		if (fold && c >= 'A' && c <= '^')
+			c += 32;
+		dst[i++] = c == '/' || c == '\0' ? '_' : c;
+	}
+
+	dst[i] = '\0';
+
+	return i;
+}
+
+/* cl_mkdirs : mkdir -p */
+static int cl_mkdirs(char *path)
+{
+	char *p;
+	int end;
+
+	for (p = path + 1; ; p++) {
+		if (*p != '/' && *p != '\0')
+			continue;
+
+		end = *p == '\0';
+
+		*p = '\0';
+		if (mkdir(path, 0755) < 0 && errno != EEXIST)
+			return -1;
+		*p = end ? '\0' : '/';
+
+		if (end)
+			break;
+	}
+
+	return 0;
+}
+
+/* cl_writeall : write(), until it's all gone or there's an error */
+static void cl_writeall(int fd, char *buf, int len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			FIO_PRINTF(FIO_WRN, "Couldn't Write Chat Log : %s", strerror(errno));
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
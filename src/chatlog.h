@@ -0,0 +1,29 @@
+#ifndef CHATLOG_H
+#define CHATLOG_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 12:30
+ *
+ * Chat Logs
+ */
+
+#define CL_DIR      "logs"
+#define CL_BUFSIZE  (256 << 10) /* bytes of records waiting on the writer */
+#define CL_SHARDBUF (16 << 10)  /* bytes a shard gathers before a write() */
+#define CL_SHARDS   256         /* shards open at once */
+#define CL_BUCKETS  512         /* a power of two */
+#define CL_NAMELEN  64
+#define CL_IDLE_MS  600000      /* a shard nobody's talked in gets closed */
+#define CL_WAIT_MS  100         /* longest a record waits to be written */
+
+/* cl_log flags */
+#define CL_SELF     0x01        /* the bot said it, it's not worth searching */
+
+int cl_open(const char *dir, int sync_ms);
+void cl_close(void);
+int cl_log(const char *net, const char *chan, int chanlen,
+		const char *nick, int nicklen, const char *text, int textlen, int flags);
+int cl_key(char *buf, int len, const char *net, const char *chan, int chanlen);
+
+#endif
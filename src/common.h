@@ -8,6 +8,33 @@
  * Just some common, helpful definitions that might be useful everywhere
  */
 
+#include <stdint.h>
+#include <time.h>
+
 #define ARRSIZE(x) (sizeof((x)) / sizeof((x)[0]))
 
+/* slice_t : a view into someone else's buffer, not necessarily terminated */
+struct slice_t {
+	char *ptr;
+	int len;
+};
+
+typedef struct slice_t slice_t;
+
+/* now_ms : monotonic milliseconds, for timeouts and not wall clock time */
+static inline uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* now_us : monotonic microseconds, for measuring latencies */
+static inline uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 #endif
@@ -0,0 +1,191 @@
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 20:40
+ *
+ * Readiness Based Event Loop (epoll)
+ *
+ * One of these drives every connection the process owns. Descriptors are
+ * level triggered, so a handler that stops reading early (to be fair to the
+ * other connections) just gets called again on the next ev_wait.
+ *
+ * The loop's timers live in a timing wheel, ev_wait never sleeps past the
+ * soonest one and runs whatever's due after the descriptors' handlers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "event.h"
+#include "common.h"
+
+static int ev_grow(ev_t *ev, int fd);
+static unsigned ev_toepoll(int events);
+
+/* ev_init : creates the epoll instance */
+int ev_init(ev_t *ev)
+{
+	memset(ev, 0, sizeof(*ev));
+
+	if ((ev->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return -1;
+
+	tw_init(&ev->timers, now_ms());
+
+	return 0;
+}
+
+/* ev_add : starts watching fd for events, calling func when they happen */
+int ev_add(ev_t *ev, int fd, int events, ev_func_t func, void *arg)
+{
+	struct epoll_event epev;
+
+	if (fd < 0 || ev_grow(ev, fd) < 0)
+		return -1;
+
+	memset(&epev, 0, sizeof(epev));
+	epev.events = ev_toepoll(events);
+	epev.data.fd = fd;
+
+	if (epoll_ctl(ev->epfd, EPOLL_CTL_ADD, fd, &epev) < 0)
+		return -1;
+
+	ev->handlers[fd].func = func;
+	ev->handlers[fd].arg = arg;
+	ev->handlers[fd].events = events;
+	ev->nfds++;
+
+	return 0;
+}
+
+/* ev_mod : changes the set of events we're interested in for fd */
+int ev_mod(ev_t *ev, int fd, int events)
+{
+	struct epoll_event epev;
+
+	if (fd < 0 || ev->cap <= fd || !ev->handlers[fd].func)
+		return -1;
+
+	if (ev->handlers[fd].events == events)
+		return 0; /* nothing to tell the kernel */
+
+	memset(&epev, 0, sizeof(epev));
+	epev.events = ev_toepoll(events);
+	epev.data.fd = fd;
+
+	if (epoll_ctl(ev->epfd, EPOLL_CTL_MOD, fd, &epev) < 0)
+		return -1;
+
+	ev->handlers[fd].events = events;
+
+	return 0;
+}
+
+/* ev_del : stops watching fd */
+int ev_del(ev_t *ev, int fd)
+{
+	if (fd < 0 || ev->cap <= fd || !ev->handlers[fd].func)
+		return -1;
+
+	/* the descriptor may already be closed, which removes it for us */
+	epoll_ctl(ev->epfd, EPOLL_CTL_DEL, fd, NULL);
+
+	memset(&ev->handlers[fd], 0, sizeof(ev->handlers[fd]));
+	ev->nfds--;
+
+	return 0;
+}
+
+/*
+ * ev_wait : waits up to timeout ms, or until the next timer, dispatches
+ * events and then the timers that are due, returns the count of events
+ */
+int ev_wait(ev_t *ev, int timeout)
+{
+	struct epoll_event events[EV_MAXEVENTS];
+	struct ev_handler_t *h;
+	int n, i, fd, flags;
+
+	timeout = tw_timeout(&ev->timers, now_ms(), timeout);
+
+	n = epoll_wait(ev->epfd, events, EV_MAXEVENTS, timeout);
+	if (n < 0) {
+		return errno == EINTR ? 0 : -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		fd = events[i].data.fd;
+		h = &ev->handlers[fd];
+
+		/* an earlier handler in this batch may have removed this one */
+		if (!h->func)
+			continue;
+
+		flags = 0;
+		if (events[i].events & EPOLLIN)
+			flags |= EV_READ;
+		if (events[i].events & EPOLLOUT)
+			flags |= EV_WRITE;
+		if (events[i].events & (EPOLLERR | EPOLLHUP))
+			flags |= EV_ERROR;
+
+		h->func(ev, fd, flags, h->arg);
+	}
+
+	tw_advance(&ev->timers, now_ms());
+
+	return n;
+}
+
+/* ev_free : releases the event loop, doesn't close registered descriptors */
+void ev_free(ev_t *ev)
+{
+	if (ev->epfd >= 0)
+		close(ev->epfd);
+	free(ev->handlers);
+	tw_free(&ev->timers);
+	memset(ev, 0, sizeof(*ev));
+	ev->epfd = -1;
+}
+
+/* ev_grow : makes sure the handler table can be indexed by fd */
+static int ev_grow(ev_t *ev, int fd)
+{
+	struct ev_handler_t *tmp;
+	int cap;
+
+	if (fd < ev->cap)
+		return 0;
+
+	for (cap = ev->cap ? ev->cap : 64; cap <= fd; cap *= 2)
+		;
+
+	tmp = realloc(ev->handlers, cap * sizeof(*tmp));
+	if (!tmp)
+		return -1;
+
+	memset(tmp + ev->cap, 0, (cap - ev->cap) * sizeof(*tmp));
+	ev->handlers = tmp;
+	ev->cap = cap;
+
+	return 0;
+}
+
+/* ev_toepoll : converts our event flags into epoll's */
+static unsigned ev_toepoll(int events)
+{
+	unsigned rc;
+
+	rc = 0;
+
+	if (events & EV_READ)
+		rc |= EPOLLIN | EPOLLRDHUP;
+	if (events & EV_WRITE)
+		rc |= EPOLLOUT;
+
+	return rc;
+}
@@ -0,0 +1,46 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 20:40
+ *
+ * Readiness Based Event Loop (epoll)
+ */
+
+#include "wheel.h"
+
+#define EV_READ  0x01
+#define EV_WRITE 0x02
+#define EV_ERROR 0x04 /* hangup or socket error, always reported */
+
+#define EV_MAXEVENTS 64
+
+struct ev_t;
+
+typedef void (*ev_func_t)(struct ev_t *ev, int fd, int events, void *arg);
+
+struct ev_handler_t {
+	ev_func_t func;
+	void *arg;
+	int events;
+};
+
+struct ev_t {
+	int epfd;
+	int nfds; /* number of registered descriptors */
+	int cap;
+	struct ev_handler_t *handlers; /* indexed by file descriptor */
+	tw_t timers; /* ev_wait sleeps until the soonest, and runs them */
+};
+
+typedef struct ev_t ev_t;
+
+int ev_init(ev_t *ev);
+int ev_add(ev_t *ev, int fd, int events, ev_func_t func, void *arg);
+int ev_mod(ev_t *ev, int fd, int events);
+int ev_del(ev_t *ev, int fd);
+int ev_wait(ev_t *ev, int timeout);
+void ev_free(ev_t *ev);
+
+#endif
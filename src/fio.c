@@ -3,73 +3,301 @@
  * Wed Feb 20, 2019 18:54
  *
  * File IO Handling
+ *
+ * Logging is asynchronous. fio_printf formats the record straight into a
+ * slot of a lock-free ring (any thread can log), and a writer thread drains
+ * the ring, batching whatever's there into one write() per output. When
+ * the ring is full, the overflow policy says whether the caller waits for
+ * room, or the record gets dropped (and, with FIO_OVF_COUNT, a line saying
+ * how many were lost gets written once there's room again).
+ *
+ * Filtering happens in the FIO_PRINTF macro, before fio_printf is even
+ * called: levels under FIO_MINLEVEL are compiled out, and the rest check
+ * their subsystem's bit in fio_masks, which fio_setlevels can change at any
+ * time.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
 
 #include "fio.h"
+#include "lindex.h"
+#include "metrics.h"
+#include "common.h"
 
 #define PRINTTOSTDOUT 1
 
-static char buf[512];
+#define FIO_RECSIZE   1024       /* biggest record, longer ones get cut */
+#define FIO_RINGSLOTS 1024       /* records the ring holds, a power of two */
+#define FIO_BATCHSIZE (64 << 10) /* bytes the writer gathers per write() */
+#define FIO_IDLE_MS   50         /* writer nap when there's nothing to do */
+
+struct fio_rec_t {
+	_Atomic uint64_t seq; /* pos when free, pos + 1 when it has a record */
+	int len;
+	char buf[FIO_RECSIZE];
+};
+
+/* every level at least as severe as level */
+#define FIO_LEVELMASK(level) \
+	((FIO_SEVERITY(FIO_NON) >= FIO_SEVERITY(level) ? 1u << FIO_NON : 0) | \
+	 (FIO_SEVERITY(FIO_LOG) >= FIO_SEVERITY(level) ? 1u << FIO_LOG : 0) | \
+	 (FIO_SEVERITY(FIO_MSG) >= FIO_SEVERITY(level) ? 1u << FIO_MSG : 0) | \
+	 (FIO_SEVERITY(FIO_WRN) >= FIO_SEVERITY(level) ? 1u << FIO_WRN : 0) | \
+	 (FIO_SEVERITY(FIO_ERR) >= FIO_SEVERITY(level) ? 1u << FIO_ERR : 0) | \
+	 (FIO_SEVERITY(FIO_VER) >= FIO_SEVERITY(level) ? 1u << FIO_VER : 0))
+
+#define FIO_DEFAULTMASK FIO_LEVELMASK(FIO_LOG)
+
+_Atomic unsigned fio_masks[FIO_SS_COUNT] = {
+	[0 ... FIO_SS_COUNT - 1] = FIO_DEFAULTMASK
+};
+
+static char *subsysnames[FIO_SS_COUNT] = {
+	[FIO_SS_MAIN] = "main",
+	[FIO_SS_IRC] = "irc",
+	[FIO_SS_CMD] = "cmd",
+};
+
+static char *levelnames[] = {
+	[FIO_NON] = "non",
+	[FIO_LOG] = "log",
+	[FIO_MSG] = "msg",
+	[FIO_WRN] = "wrn",
+	[FIO_ERR] = "err",
+	[FIO_VER] = "ver",
+};
+
 static FILE *modfp = NULL;
 
+static struct fio_rec_t ring[FIO_RINGSLOTS];
+static _Atomic uint64_t tail; /* next slot a producer claims */
+static uint64_t head;         /* next slot the writer drains, writer only */
+
+static _Atomic int policy = FIO_OVF_BLOCK;
+static _Atomic unsigned long dropped;  /* every record we've thrown out */
+static _Atomic unsigned long unsaid;   /* dropped, not yet reported in the log */
+static _Atomic int running;
+static _Atomic int sleeping;
+static pthread_t writer;
+static sem_t wakeup;
+
+static char batch[FIO_BATCHSIZE];
+
+/* fio_lines and fio_getline keep an index of the last file they were given */
+static pthread_mutex_t idxlock = PTHREAD_MUTEX_INITIALIZER;
+static lidx_t idx;
+static int idxfd = -1;
+static dev_t idxdev;
+static ino_t idxino;
+
+static void *fio_writer(void *arg);
+static int fio_drain(void);
+static void fio_writeall(int fd, char *buf, int len);
+static int fio_index(FILE *fp);
+
 FILE *fio_getstaticfp()
 {
 	return modfp;
 }
 
-/* fio_setfp : sets the module file pointer to fp, and sets line buffering */
+/* fio_setfp : sets the module file pointer to fp, and starts the writer */
 void fio_setfp(FILE *fp)
 {
-	if (fp) {
-		modfp = fp;
-		setvbuf(modfp, buf, _IOLBF, sizeof(buf));
+	sigset_t all, old;
+	uint64_t i;
+
+	if (!fp || modfp)
+		return;
+
+	for (i = 0; i < FIO_RINGSLOTS; i++)
+		atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+	atomic_store(&tail, 0);
+	head = 0;
+
+	if (sem_init(&wakeup, 0, 0) < 0)
+		return;
+
+	atomic_store(&running, 1);
+
+	/* signals belong to the main thread, the writer never sees them */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+
+	if (pthread_create(&writer, NULL, fio_writer, NULL) != 0) {
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		sem_destroy(&wakeup);
+		return;
 	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	modfp = fp;
 }
 
+/* fio_closefp : writes out everything still queued, then closes the file */
 void fio_closefp()
 {
+	if (!modfp)
+		return;
+
+	atomic_store(&running, 0);
+	sem_post(&wakeup);
+	pthread_join(writer, NULL);
+	sem_destroy(&wakeup);
+
 	fclose(modfp);
+	modfp = NULL;
+}
+
+/* fio_setoverflow : picks what fio_printf does when the ring is full */
+void fio_setoverflow(int ovf)
+{
+	atomic_store(&policy, ovf);
+}
+
+/* fio_dropped : returns the number of records lost to a full ring */
+unsigned long fio_dropped()
+{
+	return atomic_load(&dropped);
+}
+
+/* fio_setlevel : logs level, and everything more severe, for subsys */
+int fio_setlevel(int subsys, int level)
+{
+	if (subsys < 0 || subsys >= FIO_SS_COUNT)
+		return -1;
+
+	if (level < FIO_NON || level > FIO_VER)
+		return -1;
+
+	atomic_store(&fio_masks[subsys], FIO_LEVELMASK(level));
+
+	return 0;
+}
+
+/* fio_setlevels : applies a spec like "wrn,irc=ver", -1 if it's malformed */
+int fio_setlevels(char *spec)
+{
+	char buf[256];
+	char *tok, *rest, *eq, *lvl;
+	int i, j, subsys, level;
+
+	snprintf(buf, sizeof(buf), "%s", spec);
+
+	/* "level" on its own is every subsystem, "subsys=level" just the one */
+	for (rest = buf; rest;) {
+		tok = rest;
+		if ((rest = strchr(rest, ',')))
+			*rest++ = '\0';
+
+		if ((eq = strchr(tok, '='))) {
+			*eq = '\0';
+			lvl = eq + 1;
+		} else {
+			lvl = tok;
+		}
+
+		for (level = -1, i = 0; i < ARRSIZE(levelnames); i++) {
+			if (strcmp(levelnames[i], lvl) == 0)
+				level = i;
+		}
+
+		if (level < 0)
+			return -1;
+
+		if (!eq) {
+			for (j = 0; j < FIO_SS_COUNT; j++)
+				fio_setlevel(j, level);
+			continue;
+		}
+
+		for (subsys = -1, j = 0; j < FIO_SS_COUNT; j++) {
+			if (strcmp(subsysnames[j], tok) == 0)
+				subsys = j;
+		}
+
+		if (fio_setlevel(subsys, level) < 0)
+			return -1;
+	}
+
+	return 0;
 }
 
 /* fio_printf : printf to our specific, "staticish" FILE *ptr */
 int fio_printf(char *file, int line, int level, char *fmt, ...)
 {
+	struct fio_rec_t *rec;
 	va_list args;
+	uint64_t pos, seq;
+	int64_t diff;
 	char *ptr;
 	int rc, tmp;
-	char bigbuf[1024];
 
 	rc = 0;
 
 	if (!modfp)
 		return rc;
 
-	if (strlen(fmt) == 0)
+	if (*fmt == '\0')
 		return rc;
 
-	memset(bigbuf, 0, sizeof(bigbuf));
-
-	va_start(args, fmt); /* get the arguments from the stack */
+	/* claim a slot, the ring is a bounded MPSC queue with per slot tickets */
+	pos = atomic_load_explicit(&tail, memory_order_relaxed);
+	for (;;) {
+		rec = &ring[pos & (FIO_RINGSLOTS - 1)];
+		seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+		diff = (int64_t)(seq - pos);
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&tail, &pos, pos + 1,
+						memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (diff < 0) { /* full, the writer hasn't got to this slot */
+			if (atomic_load_explicit(&policy, memory_order_relaxed) != FIO_OVF_BLOCK) {
+				atomic_fetch_add(&dropped, 1);
+				met_inc(MET_LOG_DROPPED);
+				atomic_fetch_add(&unsaid, 1);
+				return rc;
+			}
+
+			if (atomic_load(&sleeping))
+				sem_post(&wakeup);
+			sched_yield();
+			pos = atomic_load_explicit(&tail, memory_order_relaxed);
+		} else {
+			pos = atomic_load_explicit(&tail, memory_order_relaxed);
+		}
+	}
 
 	switch (level) {
 	case FIO_MSG:
-		rc = snprintf(bigbuf, sizeof(bigbuf), "%s:%-4d MSG ", file, line);
+		rc = snprintf(rec->buf, FIO_RECSIZE, "%s:%-4d MSG ", file, line);
 		break;
 
 	case FIO_WRN:
-		rc = snprintf(bigbuf, sizeof(bigbuf), "%s:%-4d WRN ", file, line);
+		rc = snprintf(rec->buf, FIO_RECSIZE, "%s:%-4d WRN ", file, line);
 		break;
 
 	case FIO_ERR:
-		rc = snprintf(bigbuf, sizeof(bigbuf), "%s:%-4d ERR ", file, line);
+		rc = snprintf(rec->buf, FIO_RECSIZE, "%s:%-4d ERR ", file, line);
 		break;
 
 	case FIO_VER:
-		rc = snprintf(bigbuf, sizeof(bigbuf), "%s:%-4d VER ", file, line);
+		rc = snprintf(rec->buf, FIO_RECSIZE, "%s:%-4d VER ", file, line);
 		break;
 
 	case FIO_NON:
@@ -77,53 +305,152 @@ int fio_printf(char *file, int line, int level, char *fmt, ...)
 		break;
 
 	case FIO_LOG:
-		rc = snprintf(bigbuf, sizeof(bigbuf), "%s:%-4d LOG ", file, line);
-		// rc = snprintf(bigbuf, sizeof(bigbuf), "LOG ");
+		rc = snprintf(rec->buf, FIO_RECSIZE, "%s:%-4d LOG ", file, line);
+		// rc = snprintf(rec->buf, FIO_RECSIZE, "LOG ");
 		break;
 
-
 	default:
-		rc = fprintf(modfp, "%s:%-4d UNKNOWN ", file, line);
+		rc = snprintf(rec->buf, FIO_RECSIZE, "%s:%-4d UNKNOWN ", file, line);
 		break;
 	};
 
 	/* print the rest of the message */
-	tmp = strlen(bigbuf);
-	rc += vsnprintf(bigbuf + tmp, sizeof(bigbuf) - tmp, fmt, args);
+	tmp = rc < FIO_RECSIZE ? rc : FIO_RECSIZE - 1;
 
+	va_start(args, fmt); /* get the arguments from the stack */
+	rc += vsnprintf(rec->buf + tmp, FIO_RECSIZE - tmp, fmt, args);
 	va_end(args); /* cleanup stack arguments */
 
-	/* writes a newline if the last character of the buffer isn't a newline */
-	tmp = strlen(bigbuf);
-	ptr = fmt + strlen(fmt) - 1;
-	if (*ptr != '\n') {
-		sprintf(bigbuf + tmp, "\n");
+	/* writes a newline if the last character of the record isn't a newline */
+	tmp = rc < FIO_RECSIZE - 1 ? rc : FIO_RECSIZE - 2;
+	ptr = rec->buf + tmp - 1;
+	if (tmp == 0 || *ptr != '\n') {
+		ptr[1] = '\n';
+		tmp++;
+	}
+
+	rec->len = tmp;
+
+	met_inc(MET_LOG_RECORDS);
+
+	/* publish it, and poke the writer if it's napping */
+	atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+
+	if (atomic_load_explicit(&sleeping, memory_order_relaxed))
+		sem_post(&wakeup);
+
+	return rc;
+}
+
+/* fio_writer : the writer thread, drains the ring until we're shut down */
+static void *fio_writer(void *arg)
+{
+	struct timespec ts;
+
+	for (;;) {
+		if (fio_drain() > 0)
+			continue;
+
+		if (!atomic_load(&running) && fio_drain() == 0)
+			break;
+
+		/* nothing to do, so nap, a producer posts if it sees us sleeping */
+		atomic_store(&sleeping, 1);
+
+		if (fio_drain() == 0 && atomic_load(&running)) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += FIO_IDLE_MS * 1000000L;
+			if (ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+
+			while (sem_timedwait(&wakeup, &ts) < 0 && errno == EINTR)
+				;
+		}
+
+		atomic_store(&sleeping, 0);
+	}
+
+	return NULL;
+}
+
+/* fio_drain : batches up the ready records and writes them, returns count */
+static int fio_drain(void)
+{
+	struct fio_rec_t *rec;
+	unsigned long lost;
+	int len, n;
+
+	len = 0;
+
+	/* say how much we lost first, now that there's room again */
+	if ((lost = atomic_exchange(&unsaid, 0)) > 0 &&
+			atomic_load(&policy) == FIO_OVF_COUNT) {
+		len = snprintf(batch, sizeof(batch),
+				"%s:%-4d WRN %lu Log Records Dropped, Ring Full\n",
+				__FILE__, __LINE__, lost);
+	}
+
+	for (n = 0; ; n++) {
+		rec = &ring[head & (FIO_RINGSLOTS - 1)];
+
+		if (atomic_load_explicit(&rec->seq, memory_order_acquire) != head + 1)
+			break;
+
+		if (len + rec->len > sizeof(batch))
+			break;
+
+		memcpy(batch + len, rec->buf, rec->len);
+		len += rec->len;
+
+		/* hand the slot back for the next lap around the ring */
+		atomic_store_explicit(&rec->seq, head + FIO_RINGSLOTS,
+				memory_order_release);
+		head++;
 	}
 
-	/* finally, print the buffer out into our file, and optionally stdout */
-	fprintf(modfp, "%s", bigbuf);
+	if (len > 0) {
+		fio_writeall(fileno(modfp), batch, len);
+		met_add(MET_LOG_BYTES, len);
 #ifdef PRINTTOSTDOUT
-	printf("%s", bigbuf);
+		fio_writeall(STDOUT_FILENO, batch, len);
 #endif
+	}
 
-	return rc;
+	return n;
+}
+
+/* fio_writeall : write(2) that keeps going through partial writes */
+static void fio_writeall(int fd, char *buf, int len)
+{
+	ssize_t rc;
+
+	while (len > 0) {
+		if ((rc = write(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return; /* nowhere left to complain to */
+		}
+
+		buf += rc;
+		len -= rc;
+	}
 }
 
 /* fio_lines : get the number of lines in a FILE *fp */
 int fio_lines(FILE *fp)
 {
-	int lines, c;
+	int lines;
 
 	if (!fp)
 		return -1;
 
-	rewind(fp);
+	pthread_mutex_lock(&idxlock);
 
-	/* read lines until you run out */
-	for (lines = 0, c = getc(fp); c != EOF; c = getc(fp)) {
-		if (c == '\n')
-			lines++;
-	}
+	lines = fio_index(fp) < 0 ? -1 : lidx_lines(&idx);
+
+	pthread_mutex_unlock(&idxlock);
 
 	return lines;
 }
@@ -131,29 +458,54 @@ int fio_lines(FILE *fp)
 /* fio_getline : gets linenumber line from fp storing buflen chars in buf */
 int fio_getline(FILE *fp, char *buf, int buflen, int line)
 {
-	char *ptr;
-	int curr;
-	char tmpbuf[256];
+	slice_t s;
+	int rc;
 
-	if (!fp)
+	if (!fp || buflen <= 0)
 		return -1;
 
-	rewind(fp);
-	curr = 0;
+	pthread_mutex_lock(&idxlock);
 
-	while ((ptr = fgets(tmpbuf, sizeof(tmpbuf), fp)) == tmpbuf) {
-		if (curr++ == line)
-			break;
-	}
+	rc = -1;
 
 	/* have to see if the file has that line */
-	if (ptr == tmpbuf) {
-		curr = strlen(tmpbuf);
-		strncpy(buf, tmpbuf, curr > buflen ? buflen : curr);
-	} else {
-		return -1;
+	if (fio_index(fp) == 0 && lidx_getline(&idx, line, &s) == 0) {
+		if (s.len > buflen - 1)
+			s.len = buflen - 1;
+		memcpy(buf, s.ptr, s.len);
+		buf[s.len] = '\0';
+		rc = 0;
 	}
 
-	return 0;
+	pthread_mutex_unlock(&idxlock);
+
+	return rc;
 }
 
+/* fio_index : points the cached line index at fp's file, and brings it current */
+static int fio_index(FILE *fp)
+{
+	struct stat st;
+
+	if (fstat(fileno(fp), &st) < 0)
+		return -1;
+
+	/* a different file than last time, index it from scratch */
+	if (idxfd != fileno(fp) || idxdev != st.st_dev || idxino != st.st_ino) {
+		if (idxfd >= 0)
+			lidx_free(&idx);
+		idxfd = -1;
+
+		if (lidx_init(&idx, fileno(fp)) < 0) {
+			lidx_free(&idx);
+			return -1;
+		}
+
+		idxfd = fileno(fp);
+		idxdev = st.st_dev;
+		idxino = st.st_ino;
+		return 0;
+	}
+
+	return lidx_refresh(&idx);
+}
@@ -2,6 +2,7 @@
 #define FILE_IO
 
 #include <stdarg.h>
+#include <stdatomic.h>
 
 enum {
 	FIO_NON,
@@ -12,14 +13,70 @@ enum {
 	FIO_VER
 };
 
+/* what fio_printf does when the log ring is full */
+enum {
+	FIO_OVF_BLOCK, /* wait for the writer to make room */
+	FIO_OVF_DROP,  /* throw the record out */
+	FIO_OVF_COUNT  /* throw it out, and log how many were lost later */
+};
+
 FILE *fio_getstaticfp();
 int fio_lines(FILE *fp);
 int fio_printf(char *file, int line, int level, char *fmt, ...);
 int fio_getline(FILE *fp, char *buf, int buflen, int line);
 void fio_closefp();
 void fio_setfp(FILE *fp);
+void fio_setoverflow(int ovf);
+unsigned long fio_dropped();
+
+/*
+ * Every file logs as one subsystem, by defining FIO_SUBSYS before it
+ * includes this header, and each subsystem has its own set of levels turned
+ * on at runtime (fio_setlevels). The default is everything but FIO_VER.
+ */
+enum {
+	FIO_SS_MAIN,
+	FIO_SS_IRC,
+	FIO_SS_CMD,
+	FIO_SS_COUNT
+};
+
+#ifndef FIO_SUBSYS
+#define FIO_SUBSYS FIO_SS_MAIN
+#endif
+
+/*
+ * FIO_MINLEVEL is the least severe level that gets compiled in at all, so
+ * building with -DFIO_MINLEVEL=FIO_MSG turns every FIO_VER and FIO_LOG into
+ * nothing. From least to most severe: VER, LOG, MSG, WRN, ERR (and NON,
+ * the bare message, rides along with ERR).
+ */
+#define FIO_SEVERITY(level) \
+	((level) == FIO_VER ? 0 : (level) == FIO_LOG ? 1 : (level) == FIO_MSG ? 2 : \
+	 (level) == FIO_WRN ? 3 : 4)
+
+#ifndef FIO_MINLEVEL
+#define FIO_MINLEVEL FIO_VER
+#endif
+
+extern _Atomic unsigned fio_masks[FIO_SS_COUNT];
+
+/* fio_enabled : true if level is turned on for subsys right now */
+static inline int fio_enabled(int subsys, int level)
+{
+	return atomic_load_explicit(&fio_masks[subsys], memory_order_relaxed) >>
+		level & 1;
+}
+
+int fio_setlevel(int subsys, int level);
+int fio_setlevels(char *spec);
 
+/* the arguments aren't evaluated, let alone formatted, unless it's wanted */
 #define FIO_PRINTF(level, fmt, ...) \
-	fio_printf(__FILE__, __LINE__, (level), (fmt), ##__VA_ARGS__)
+	do { \
+		if (FIO_SEVERITY(level) >= FIO_SEVERITY(FIO_MINLEVEL) && \
+				fio_enabled(FIO_SUBSYS, (level))) \
+			fio_printf(__FILE__, __LINE__, (level), (fmt), ##__VA_ARGS__); \
+	} while (0)
 
 #endif
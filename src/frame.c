@@ -0,0 +1,146 @@
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 21:30
+ *
+ * Line Framing for the receive path
+ *
+ * Each connection owns one of these. The socket reads straight into the free
+ * space at the end of the buffer, and frm_next hands complete lines back out
+ * as slices pointing into that same buffer, CR/LF swapped for a NUL so the
+ * rest of the bot can keep treating them as C strings.
+ *
+ * Instead of wrapping around like a ring, a partial line left at the end of
+ * the buffer gets slid back to the front when we run out of room, so a line
+ * is always contiguous. That's at most one line's worth of memmove, and
+ * usually nothing at all since most reads end on a line boundary.
+ *
+ * A slice is only good until the next frm_space call.
+ */
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "frame.h"
+#include "metrics.h"
+
+/* frm_init : empties the framer */
+void frm_init(frame_t *f)
+{
+	f->head = 0;
+	f->scan = 0;
+	f->tail = 0;
+	f->discard = 0;
+	f->overflow = 0;
+}
+
+/* frm_space : returns where the next read should go, and how much fits */
+char *frm_space(frame_t *f, int *len)
+{
+	if (f->head == f->tail) { /* everything's been consumed, start over */
+		f->head = f->scan = f->tail = 0;
+
+	} else if (f->tail == FRAME_SIZE && f->head > 0) {
+		memmove(f->buf, f->buf + f->head, f->tail - f->head);
+		f->scan -= f->head;
+		f->tail -= f->head;
+		f->head = 0;
+	}
+
+	*len = FRAME_SIZE - f->tail;
+
+	return f->buf + f->tail;
+}
+
+/* frm_commit : marks n bytes of the space from frm_space as received */
+void frm_commit(frame_t *f, int n)
+{
+	f->tail += n;
+}
+
+/* frm_next : gets the next complete line, returns 0 when there isn't one */
+int frm_next(frame_t *f, slice_t *line)
+{
+	char *eol;
+	int start;
+
+	for (;;) {
+		eol = frm_findeol(f->buf + f->scan, f->buf + f->tail);
+
+		if (!eol) {
+			f->scan = f->tail;
+
+			/* a line as big as the whole buffer is never going to fit */
+			if (f->head == 0 && f->tail == FRAME_SIZE) {
+				if (!f->discard) {
+					f->overflow++;
+					met_inc(MET_FRAME_OVERFLOWS);
+				}
+				f->discard = 1;
+				f->head = f->scan = f->tail = 0;
+			}
+
+			return 0;
+		}
+
+		*eol = '\0';
+		start = f->head;
+		f->head = f->scan = eol - f->buf + 1;
+
+		if (f->discard) { /* the end of a line we already gave up on */
+			f->discard = 0;
+			continue;
+		}
+
+		if (f->buf + start == eol) /* the \n of a \r\n pair */
+			continue;
+
+		line->ptr = f->buf + start;
+		line->len = eol - line->ptr;
+
+		return 1;
+	}
+}
+
+/* frm_findeol : finds the first CR or LF in [p, end), NULL if none */
+char *frm_findeol(char *p, char *end)
+{
+#ifdef __SSE2__
+	__m128i cr, lf, v;
+	int mask;
+
+	cr = _mm_set1_epi8('\r');
+	lf = _mm_set1_epi8('\n');
+
+	/* sixteen bytes a compare, the scalar loop below picks up the tail */
+	for (; end - p >= 16; p += 16) {
+		v = _mm_loadu_si128((__m128i *)p);
+		mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr),
+					_mm_cmpeq_epi8(v, lf)));
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+#else
+	uint64_t w, x, y;
+
+	/* eight bytes at a time, with the "has a zero byte" bit trick */
+	for (; end - p >= 8; p += 8) {
+		memcpy(&w, p, sizeof(w));
+		x = w ^ 0x0d0d0d0d0d0d0d0dULL;
+		y = w ^ 0x0a0a0a0a0a0a0a0aULL;
+		x = (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+		y = (y - 0x0101010101010101ULL) & ~y & 0x8080808080808080ULL;
+		if (x | y)
+			break;
+	}
+#endif
+
+	for (; p < end; p++) {
+		if (*p == '\r' || *p == '\n')
+			return p;
+	}
+
+	return NULL;
+}
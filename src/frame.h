@@ -0,0 +1,33 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 21:30
+ *
+ * Line Framing for the receive path
+ */
+
+#include "common.h"
+
+/* an IRCv3 line can carry 8191 bytes of tags on top of the 512 RFC bytes */
+#define FRAME_SIZE 16384
+
+struct frame_t {
+	int head; /* first byte we haven't handed out */
+	int scan; /* everything before this has been checked for CR/LF */
+	int tail; /* one past the last byte received */
+	int discard; /* throwing away the rest of a line that was too long */
+	unsigned long overflow; /* lines dropped for being too long */
+	char buf[FRAME_SIZE];
+};
+
+typedef struct frame_t frame_t;
+
+void frm_init(frame_t *f);
+char *frm_space(frame_t *f, int *len);
+void frm_commit(frame_t *f, int n);
+int frm_next(frame_t *f, slice_t *line);
+char *frm_findeol(char *p, char *end);
+
+#endif
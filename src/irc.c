@@ -6,562 +6,1451 @@
  *
  * TODO (Brian)
  *
- * * put the actual IRC command handling somewhere else
+ * * untangle this from the logging module
  *   this file is supposed to be a library for easy IRC handling; however, it's
- *   somewhat intermingled with the logging module, as well as it has an assload
- *   of specific to my application commands
+ *   somewhat intermingled with the logging module. The application specific
+ *   commands have moved out to botcmd.c.
  */
 
+#define FIO_SUBSYS FIO_SS_IRC
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <time.h>
 #include <ctype.h>
 
 #include <unistd.h>
 #include <errno.h>
+#include <sys/eventfd.h>
 
 #include "socket.h"
 #include "irc.h"
+#include "ircmsg.h"
+#include "botcmd.h"
 #include "fio.h"
 #include "common.h"
 #include "stringext.h"
+#include "phash.h"
+#include "metrics.h"
+#include "chatlog.h"
 
-static int url_encode(char *buf, int buflen, char *src, char *prefix);
-static int url_encode_byte(unsigned char in);
+/*
+ * A PRIVMSG on its way to a command worker. The line gets copied into the
+ * job's arena, and the message parsed on the I/O thread is pointed at the
+ * copy, so the worker doesn't parse it again. Whatever the command builds
+ * goes in the same arena, and it all goes at once when the job's put back.
+ */
+struct irc_job_t {
+	pool_job_t job; /* job.next is the free list, while it's on it */
+	irc_t *irc;
+	uint64_t recvd; /* now_us when the line came in */
+	ircmsg_t msg;
+	arena_t arena;
+	char mem[IRC_JOBARENA];
+};
 
-/* function declarations */
-static int irc_botcmd_help(irc_t *irc, char *irc_nick, char *arg);
-static int irc_botcmd_ping(irc_t *irc, char *irc_nick, char *arg);
-static int irc_botcmd_smack(irc_t *irc, char *irc_nick, char *arg);
-static int irc_botcmd_google(irc_t *irc, char *irc_nick, char *arg);
-static int irc_botcmd_wiki(irc_t *irc, char *irc_nick, char *arg);
-static int irc_botcmd_8ball(irc_t *irc, char *irc_nick, char *arg);
+/* an answer waiting in the wheel, on the connection's list till it's sent */
+struct irc_later_t {
+	tw_timer_t timer;
+	irc_t *irc;
+	struct irc_later_t *next;
+	struct irc_later_t *prev;
+	char target[IRC_CHANLEN];
+	char text[IRC_LATERLEN];
+};
 
-static int irc_bot_banter(irc_t *irc, char *irc_nick, char *arg);
+static void irc_event(ev_t *ev, int fd, int events, void *arg);
+static void irc_wake(ev_t *ev, int fd, int events, void *arg);
+static void irc_raceevent(ev_t *ev, int fd, int events, void *arg);
+static void irc_reconnect(irc_t *irc, uint64_t now);
+static int irc_resolve(irc_t *irc);
+static void irc_resolvejob(pool_job_t *job);
+static void irc_resolved(irc_t *irc, uint64_t now);
+static void irc_racestep(irc_t *irc, uint64_t now);
+static int irc_established(irc_t *irc, uint64_t now);
+static void irc_welcome(irc_t *irc, uint64_t now);
+static int irc_nextnick(irc_t *irc);
+static void irc_setnick(irc_t *irc, const char *nick, int len);
+static int irc_mynick(irc_t *irc, char *buf, int len);
+static void irc_shutdown(irc_t *irc);
+static int irc_track(irc_t *irc, const char *channel, int add);
+static int irc_dispatch(irc_t *irc, ircmsg_t *msg, char *line, int len);
+static int irc_membership(irc_t *irc, ircmsg_t *msg);
+static void irc_runjob(pool_job_t *job);
+static void irc_rejectwarn(irc_t *irc, uint64_t now);
+static struct irc_job_t *irc_getjob(irc_t *irc);
+static void irc_putjob(irc_t *irc, struct irc_job_t *job);
+static void irc_keepalive(tw_t *tw, tw_timer_t *t, void *arg);
+static void irc_expire(tw_t *tw, tw_timer_t *t, void *arg);
+static void irc_later(tw_t *tw, tw_timer_t *t, void *arg);
+static void irc_lag(irc_t *irc, ircmsg_t *msg);
+static int irc_lagcmp(const void *a, const void *b);
+
+/* irc_init : sets up an unconnected irc_t, call once before anything else */
+void irc_init(irc_t *irc)
+{
+	memset(irc, 0, sizeof(*irc));
+
+	irc->s = -1;
+	irc->wakefd = -1;
+	irc->connect_ms = SCK_DEADLINE_MS;
+	irc->lag_ms = IRC_LAG_MS;
+	irc->backoff = IRC_BACKOFF_MIN;
+	sq_init(&irc->sq, now_ms());
+	frm_init(&irc->rbuf);
+	pthread_mutex_init(&irc->sqlock, NULL);
+	pthread_mutex_init(&irc->joblock, NULL);
+	pthread_mutex_init(&irc->laterlock, NULL);
+	pthread_mutex_init(&irc->laglock, NULL);
+	arena_init(&irc->arena, irc->arenamem, sizeof(irc->arenamem));
+	ch_init(&irc->members);
+	rl_init(&irc->limits);
 
-struct ircfunc_t {
-	char *command;
-	char *usage;
-	int (*func)(irc_t *, char *, char *);
-};
+	/* seed the RNG machine */
+	srand(time(NULL));
+}
 
-static struct ircfunc_t ircfuncs[] = {
-	{"help",   "USAGE: !help <command>",   irc_botcmd_help},
-	{"ping",   "USAGE: !ping",             irc_botcmd_ping},
-	{"smack",  "USAGE: !smack <person>",   irc_botcmd_smack},
-	{"google", "USAGE: !google <search>",  irc_botcmd_google},
-	{"8ball",  "USAGE: !8ball <question>", irc_botcmd_8ball},
-	{"wiki",   "USAGE: !wiki <search>",    irc_botcmd_wiki}
-};
+/* irc_connect : starts connecting to an irc server, and keeps reconnecting */
+int irc_connect(irc_t *irc, const char* server, const char* port)
+{
+	snprintf(irc->server, sizeof(irc->server), "%s", server);
+	snprintf(irc->port, sizeof(irc->port), "%s", port);
 
-struct strdict_t {
-	char *key;
-	char *val;
-};
+	irc->iothread = pthread_self();
+	irc->backoff = IRC_BACKOFF_MIN;
 
-#define WEBPREFIX_GOOGLE "https://www.google.com/search?q="
-#define WEBPREFIX_GITHUB "https://github.com/search?q="
+	/* the attempt itself runs from the event loop, like a reconnect */
+	irc_reconnect(irc, now_ms());
 
+	return irc->state == IRC_DOWN ? -1 : 0;
+}
 
-/* irc_connect : connect to an irc server */
-int irc_connect(irc_t *irc, const char* server, const char* port)
+/* irc_attach : hands the connection to an event loop, and commands to pool */
+int irc_attach(irc_t *irc, ev_t *ev, pool_t *pool)
 {
-	if ((irc->s = get_socket(server, port)) < 0) {
+	if (irc->s >= 0 && ev_add(ev, irc->s, EV_READ | (irc->sq.depth ? EV_WRITE : 0),
+				irc_event, irc) < 0) {
 		return -1;
 	}
 
-	/* seed the RNG machine */
-	srand(time(NULL));
+	irc->ev = ev;
+	irc->iothread = pthread_self();
+
+	tw_add(&ev->timers, &irc->expire, now_ms() + RL_EXPIRE_MS, irc_expire, irc);
+
+	/* without a pool, commands just run inline like they used to */
+	if (!pool)
+		return 0;
+
+	if ((irc->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+		return -1;
+
+	if (ev_add(ev, irc->wakefd, EV_READ, irc_wake, irc) < 0)
+		return -1;
+
+	irc->pool = pool;
+
+	return 0;
+}
+
+/* irc_event : event loop callback, this is where the connection gets driven */
+static void irc_event(ev_t *ev, int fd, int events, void *arg)
+{
+	irc_t *irc;
+
+	irc = arg;
+
+	if (events & EV_WRITE) {
+		if (irc_flush(irc) < 0)
+			goto fail;
+	}
+
+	if (events & (EV_READ | EV_ERROR)) {
+		if (irc_handle_data(irc) < 0)
+			goto fail;
+	}
+
+	return;
+
+fail:
+	irc_drop(irc, now_ms());
+}
+
+/* irc_wake : a command worker queued some output, or a lookup finished */
+static void irc_wake(ev_t *ev, int fd, int events, void *arg)
+{
+	uint64_t n;
+	irc_t *irc;
+
+	irc = arg;
+
+	while (read(fd, &n, sizeof(n)) < 0 && errno == EINTR)
+		;
+
+	if (irc->resolving == IRC_DNSDONE)
+		irc_resolved(irc, now_ms());
+
+	if (irc->s >= 0 && irc_flush(irc) < 0)
+		irc_drop(irc, now_ms());
+}
+
+/* irc_raceevent : one of our connect attempts finished, see who won */
+static void irc_raceevent(ev_t *ev, int fd, int events, void *arg)
+{
+	irc_racestep(arg, now_ms());
+}
+
+/*
+ * irc_reconnect : starts the race with the cached addresses. When they're
+ * old, the pool looks them up again, and a stale answer does until it's
+ * back; with none at all, we wait for it in IRC_RESOLVING.
+ */
+static void irc_reconnect(irc_t *irc, uint64_t now)
+{
+	struct addrinfo *res;
+
+	if (!*irc->server) {
+		irc->state = IRC_DOWN;
+		return;
+	}
+
+	/* getaddrinfo doesn't tell us the TTL, so we pick our own */
+	if (!irc->dns || now >= irc->dnsexpires) {
+		if (irc->pool) {
+			if (irc_resolve(irc) == 0 && !irc->dns) {
+				irc->state = IRC_RESOLVING;
+				return;
+			}
+
+			if (!irc->dns) {
+				FIO_PRINTF(FIO_WRN, "Couldn't Resolve %s", irc->server);
+				irc_drop(irc, now);
+				return;
+			}
+		} else if (sck_resolve(irc->server, irc->port, &res) == 0) {
+			if (irc->dns)
+				freeaddrinfo(irc->dns);
+			irc->dns = res;
+			irc->dnsexpires = now + IRC_DNSTTL;
+		} else if (!irc->dns) {
+			FIO_PRINTF(FIO_WRN, "Couldn't Resolve %s", irc->server);
+			irc_drop(irc, now);
+			return;
+		} /* else a stale answer beats no answer */
+	}
+
+	FIO_PRINTF(FIO_MSG, "Connecting to %s:%s", irc->server, irc->port);
+
+	sck_racestart(&irc->race, irc->dns, now, irc->connect_ms);
+	irc->state = IRC_CONNECTING;
+
+	irc_racestep(irc, now);
+}
+
+/* irc_resolve : puts a lookup of the server on the pool, unless one's out */
+static int irc_resolve(irc_t *irc)
+{
+	if (irc->resolving != IRC_DNSIDLE)
+		return 0;
+
+	irc->resolver.func = irc_resolvejob;
+	irc->resolving = IRC_DNSOUT;
+
+	if (pool_submit(irc->pool, phash(irc->server, strlen(irc->server), (uintptr_t)irc),
+				&irc->resolver) < 0) {
+		irc->resolving = IRC_DNSIDLE;
+		return -1;
+	}
 
 	return 0;
 }
 
+/* irc_resolvejob : the pool's end of irc_resolve, wakes the loop with the answer */
+static void irc_resolvejob(pool_job_t *job)
+{
+	struct addrinfo *res;
+	uint64_t one;
+	irc_t *irc;
+
+	irc = (irc_t *)((char *)job - offsetof(irc_t, resolver));
+
+	irc->dnsnext = sck_resolve(irc->server, irc->port, &res) == 0 ? res : NULL;
+	irc->resolving = IRC_DNSDONE;
+
+	pthread_mutex_lock(&irc->sqlock);
+	if (irc->wakefd >= 0) {
+		one = 1;
+		if (write(irc->wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+			FIO_PRINTF(FIO_WRN, "Couldn't Wake I/O Thread %s", strerror(errno));
+	}
+	pthread_mutex_unlock(&irc->sqlock);
+}
+
+/*
+ * irc_resolved : takes the pool's answer, and carries on with the reconnect
+ * if it was waiting on it. A race still has the old addresses, so that waits
+ * for the next tick after it.
+ */
+static void irc_resolved(irc_t *irc, uint64_t now)
+{
+	if (irc->state == IRC_CONNECTING)
+		return;
+
+	if (irc->dnsnext) {
+		if (irc->dns)
+			freeaddrinfo(irc->dns);
+		irc->dns = irc->dnsnext;
+		irc->dnsnext = NULL;
+		irc->dnsexpires = now + IRC_DNSTTL;
+	}
+
+	irc->resolving = IRC_DNSIDLE;
+
+	if (irc->state != IRC_RESOLVING)
+		return;
+
+	if (irc->dns) {
+		irc_reconnect(irc, now);
+	} else {
+		FIO_PRINTF(FIO_WRN, "Couldn't Resolve %s", irc->server);
+		irc_drop(irc, now);
+	}
+}
+
+/* irc_racestep : moves the connect along, keeping the event loop watching it */
+static void irc_racestep(irc_t *irc, uint64_t now)
+{
+	int rc, i;
+
+	if (irc->state != IRC_CONNECTING)
+		return;
+
+	/* the race closes the losers, so stop watching before it gets the chance */
+	for (i = 0; irc->ev && i < irc->race.naddrs; i++) {
+		if (irc->race.fds[i] >= 0)
+			ev_del(irc->ev, irc->race.fds[i]);
+	}
+
+	rc = sck_racestep(&irc->race, now);
+
+	if (rc > 0) {
+		FIO_PRINTF(FIO_MSG, "Connected to %s:%s in %d ms",
+				irc->server, irc->port, (int)(now - irc->race.start));
+
+		if (irc_established(irc, now) < 0)
+			irc_drop(irc, now);
+		return;
+	}
+
+	if (rc < 0) {
+		FIO_PRINTF(FIO_WRN, "Couldn't Connect to %s:%s %s",
+				irc->server, irc->port, strerror(irc->race.err));
+
+		/* the addresses might be what's wrong, ask again next time */
+		irc->dnsexpires = 0;
+		irc_drop(irc, now);
+		return;
+	}
+
+	for (i = 0; irc->ev && i < irc->race.naddrs; i++) {
+		if (irc->race.fds[i] >= 0)
+			ev_add(irc->ev, irc->race.fds[i], EV_WRITE, irc_raceevent, irc);
+	}
+}
+
+/* irc_established : we've got a socket, start over with it and register */
+static int irc_established(irc_t *irc, uint64_t now)
+{
+	pthread_mutex_lock(&irc->sqlock);
+
+	/* anything queued was meant for the last server session */
+	sq_clear(&irc->sq);
+	sq_setpace(&irc->sq, irc->sq.burst_ms, irc->sq.line_ms);
+	irc->sq.refilled = now;
+	irc->s = irc->race.fd;
+
+	pthread_mutex_unlock(&irc->sqlock);
+
+	frm_init(&irc->rbuf);
+	irc->batching = 0;
+	irc->lastrecv = now;
+
+	irc->pingsent = 0;
+
+	if (irc->ev)
+		tw_add(&irc->ev->timers, &irc->keepalive, now + IRC_PING_MS,
+				irc_keepalive, irc);
+
+	/* the NAMES replies after we rejoin fill this back in */
+	ch_clear(&irc->members);
+	irc->state = IRC_REGISTERING;
+
+	if (irc->ev && ev_add(irc->ev, irc->s, EV_READ, irc_event, irc) < 0)
+		return -1;
+
+	/* the underscores from last time were for the last session's ghost */
+	irc_setnick(irc, irc->wantnick, strlen(irc->wantnick));
+	irc->nicktries = 0;
+
+	if (*irc->nick)
+		return irc_reg(irc, irc->nick, "brimonk", "brimonk test bot");
+
+	return 0;
+}
+
+/* irc_welcome : registration's done, rejoin everything in one go */
+static void irc_welcome(irc_t *irc, uint64_t now)
+{
+	char buf[512];
+	int len, i, n;
+
+	if (irc->state != IRC_UP)
+		met_gauge_add(MET_G_CONNECTED, 1);
+
+	irc->state = IRC_UP;
+	irc->backoff = IRC_BACKOFF_MIN;
+
+	/* JOIN #a,#b,#c, as many as fit on a line */
+	for (i = 0; i < irc->nchans; ) {
+		len = snprintf(buf, sizeof(buf), "JOIN ");
+
+		for (n = 0; i < irc->nchans; i++, n++) {
+			if (len + strlen(irc->chans[i]) + 3 >= sizeof(buf))
+				break;
+			len += sprintf(buf + len, "%s%s", n ? "," : "", irc->chans[i]);
+		}
+
+		irc_sendf(irc, SQ_CTRL, "%s\r\n", buf);
+	}
+}
+
+/*
+ * irc_nextnick : asks for the nick we want with one more underscore than
+ * the last try, always built from the one we were given, so a reconnect
+ * starts over from that
+ */
+static int irc_nextnick(irc_t *irc)
+{
+	char nick[IRC_CHANLEN];
+	int len, n;
+
+	len = strlen(irc->wantnick);
+	n = ++irc->nicktries;
+
+	/* out of names, the server drops us and we try again after the backoff */
+	if (len + n >= sizeof(nick))
+		return 0;
+
+	memcpy(nick, irc->wantnick, len);
+	memset(nick + len, '_', n);
+	irc_setnick(irc, nick, len + n);
+
+	return irc_nick(irc, irc->nick);
+}
+
+/*
+ * irc_setnick : changes what we think our nick is. Only the I/O thread does,
+ * so it can read irc->nick as it likes, but the workers logging our replies
+ * copy it with irc_mynick, under the same lock.
+ */
+static void irc_setnick(irc_t *irc, const char *nick, int len)
+{
+	pthread_mutex_lock(&irc->sqlock);
+	snprintf(irc->nick, sizeof(irc->nick), "%.*s", len, nick);
+	pthread_mutex_unlock(&irc->sqlock);
+}
+
+/* irc_mynick : a copy of our nick, from any thread, returns its length */
+static int irc_mynick(irc_t *irc, char *buf, int len)
+{
+	int n;
+
+	pthread_mutex_lock(&irc->sqlock);
+	n = snprintf(buf, len, "%s", irc->nick);
+	pthread_mutex_unlock(&irc->sqlock);
+
+	return n < len ? n : len - 1;
+}
+
+/* irc_login : registers as nick now, or as soon as we're connected */
 int irc_login(irc_t *irc, const char* nick)
 {
-	return irc_reg(irc->s, nick, "brimonk", "brimonk test bot");
+	snprintf(irc->wantnick, sizeof(irc->wantnick), "%s", nick);
+	irc_setnick(irc, nick, strlen(nick));
+	irc->nicktries = 0;
+
+	if (irc->state != IRC_REGISTERING)
+		return 0;
+
+	return irc_reg(irc, nick, "brimonk", "brimonk test bot");
 }
 
 int irc_join_channel(irc_t *irc, const char* channel)
 {
 	strncpy(irc->channel, channel, 254);
 	irc->channel[254] = '\0';
-	return irc_join(irc->s, channel);
+	return irc_join(irc, channel);
 }
 
 int irc_leave_channel(irc_t *irc)
 {
-	return irc_part(irc->s, irc->channel);
+	return irc_part(irc, irc->channel);
 }
 
+/* irc_handle_data : reads what the server has for us, non-blocking */
 int irc_handle_data(irc_t *irc)
 {
-	char tempbuffer[512];
-	int rc, i, bufidx;
+	slice_t line;
+	char *space;
+	int rc, len, n, lines;
 
-	/* wait for and receive data from the server */
-	if ((rc = sck_recv(irc->s, tempbuffer, sizeof(tempbuffer) - 2)) <= 0) {
-		FIO_PRINTF(FIO_ERR, "Got -1 From Socket %s", strerror(errno));
-		return -1;
-	}
+	/* replies pile up in the send queue, and go out in one write at the end */
+	irc->batching = 1;
 
-	tempbuffer[rc] = '\0';
-	bufidx = 0;
+	for (n = 0; n < IRC_READS; n++) {
+		space = frm_space(&irc->rbuf, &len);
 
-	for (i = 0; i < rc; i++) {
-		switch (tempbuffer[i]) {
-		case '\r':
-		case '\n':
-			irc->servbuf[bufidx] = '\0';
+		if ((rc = sck_recv(irc->s, space, len)) < 0) {
+			FIO_PRINTF(FIO_ERR, "Got -1 From Socket %s", strerror(errno));
+			goto err;
+		}
 
-			if (strlen(irc->servbuf) == 0) {
-				return 0;
-			}
+		if (rc == 0) /* drained, wait for the next wakeup */
+			break;
+
+		irc->lastrecv = now_ms();
+		frm_commit(&irc->rbuf, rc);
 
+		/* a partial line stays in the framer until the rest shows up */
+		for (lines = 0; frm_next(&irc->rbuf, &line); lines++) {
 #if 0
-			FIO_PRINTF(FIO_LOG, "%s", irc->servbuf);
+			FIO_PRINTF(FIO_LOG, "%s", line.ptr);
 #endif
 
-			if (irc_parse_action(irc) < 0)
-				return -1;
-
-			break;
+			rc = irc_parse_action(irc, line.ptr, line.len);
+			arena_reset(&irc->arena);
 
-		default:
-			irc->servbuf[bufidx] = tempbuffer[i];
-			if (bufidx >= (sizeof(irc->servbuf) -1))
-				; // Overflow!
-			else
-				bufidx++;
+			if (rc < 0)
+				goto err;
 		}
+
+		met_add(MET_RX_LINES, lines);
+	}
+
+	irc->batching = 0;
+
+	return irc_flush(irc);
+
+err:
+	irc->batching = 0;
+	return -1;
+}
+
+/* irc_flush : writes what the send queue lets us, as the socket takes it */
+int irc_flush(irc_t *irc)
+{
+	uint64_t now;
+	int rc;
+
+	if (irc->s < 0)
+		return -1;
+
+	now = now_ms();
+
+	pthread_mutex_lock(&irc->sqlock);
+
+	if ((rc = sq_flush(&irc->sq, irc->s, now)) < 0) {
+		pthread_mutex_unlock(&irc->sqlock);
+		FIO_PRINTF(FIO_ERR, "Couldn't Send %s", strerror(errno));
+		return -1;
+	}
+
+	if (rc > 0) {
+		met_add(MET_TX_BYTES, rc);
+		met_inc(MET_TX_WRITES);
 	}
 
+	/* only ask for EV_WRITE when the pacer would let something out */
+	if (irc->ev)
+		ev_mod(irc->ev, irc->s, EV_READ |
+				(sq_wantwrite(&irc->sq, now) ? EV_WRITE : 0));
+
+	pthread_mutex_unlock(&irc->sqlock);
+
 	return 0;
 }
 
-/* irc_parse_action : parses the incoming action the server's sending us */
-int irc_parse_action(irc_t *irc)
+/* irc_tick : periodic upkeep, reconnects and drains paced output */
+int irc_tick(irc_t *irc, uint64_t now)
 {
-	char *ptr;
-	int privmsg;
-	char irc_nick[128];
-	char irc_msg[512];
+	int due;
 
-	privmsg = 0;
+	if (irc->resolving == IRC_DNSDONE)
+		irc_resolved(irc, now);
 
-	if (strncmp(irc->servbuf, "PING :", 6) == 0) { /* see if it's a ping */
-		return irc_pong(irc->s, &irc->servbuf[6]);
+	/* the ones dropped since the last warning, once the flood's over too */
+	irc_rejectwarn(irc, now);
 
-	} else if (strncmp(irc->servbuf, "NOTICE AUTH :", 13) == 0) {
-		/* we really don't care about NOTICE AUTH junk */
+	switch (irc->state) {
+	case IRC_DOWN:
+		return -1;
+
+	case IRC_RESOLVING:
 		return 0;
 
-	} else if (strncmp(irc->servbuf, "ERROR :", 7) == 0) {
-		/* log the fact that the server sent us an error and move on */
+	case IRC_BACKOFF:
+		if (now >= irc->retryat)
+			irc_reconnect(irc, now);
 		return 0;
 
-	} else {
-		/* parse the message to get nick, channel, message */
+	case IRC_CONNECTING:
+		/* staggered attempts and the deadline only happen on a clock */
+		irc_racestep(irc, now);
+		return 0;
+	}
 
-		*irc_nick = '\0';
-		*irc_msg = '\0';
+	pthread_mutex_lock(&irc->sqlock);
+	due = sq_nextdue(&irc->sq, now);
+	pthread_mutex_unlock(&irc->sqlock);
 
-		/* see if we have a non-message string */
-		if (strchr(irc->servbuf, 1) != NULL)
-			return 0;
+	/* the pacer may have refilled enough for the next line */
+	if (due == 0 && irc_flush(irc) < 0)
+		irc_drop(irc, now);
 
-		if (irc->servbuf[0] == ':') {
-			ptr = strtok(irc->servbuf, "!");
+	return 0;
+}
 
-			if (ptr == NULL) {
-				printf("ptr == NULL\n");
-				return 0;
-			} else {
-				strncpy(irc_nick, &ptr[1], 127);
-				irc_nick[127] = '\0';
-			}
+/*
+ * irc_keepalive : the connection's timer. Every IRC_PING_MS we send a PING
+ * with a token of our own and time the PONG, and one that's out past the
+ * lag limit drops the connection; a link that slow may as well be dead, and
+ * reconnecting beats waiting minutes for TCP to agree. Silence past
+ * IRC_TIMEOUT drops it too, for while we're registering, or when there's no
+ * lag limit.
+ */
+static void irc_keepalive(tw_t *tw, tw_timer_t *t, void *arg)
+{
+	irc_t *irc;
+	uint64_t now, next, limit;
+
+	irc = arg;
+	now = now_ms();
+	limit = irc->lag_ms ? irc->lag_ms : IRC_TIMEOUT;
+
+	if (now - irc->lastrecv >= IRC_TIMEOUT) {
+		FIO_PRINTF(FIO_WRN, "No Data For %d ms, Dropping Connection",
+				IRC_TIMEOUT);
+		met_inc(MET_KEEPALIVE_TIMEOUTS);
+		irc_drop(irc, now);
+		return;
+	}
 
-			while ((ptr = strtok(NULL, " ")) != NULL) {
-				if (strcmp(ptr, "PRIVMSG") == 0) {
-					privmsg = 1;
-					break;
-				}
-			}
+	if (irc->pingsent) {
+		if (now - irc->pingsent / 1000 >= limit) {
+			FIO_PRINTF(FIO_WRN, "No PONG For %llu ms, Reconnecting",
+					(unsigned long long)limit);
+			met_inc(MET_LAG_DROPS);
+			irc_drop(irc, now);
+			return;
+		}
+		next = irc->pingsent / 1000 + limit;
+
+	} else if (irc->state == IRC_UP) {
+		irc->pingsent = now_us();
+		met_inc(MET_LAG_PINGS);
+		if (irc_sendf(irc, SQ_CTRL, "PING :birc-%u\r\n", ++irc->pingseq) < 0) {
+			irc_drop(irc, now);
+			return;
+		}
+		next = now + limit;
 
-			if (privmsg) {
-				if ((ptr = strtok(NULL, ":")) != NULL &&
-						(ptr = strtok(NULL, "")) != NULL) {
-					strncpy(irc_msg, ptr, 511);
-					irc_msg[511] = '\0';
-				}
-			}
+	} else {
+		next = now + IRC_PING_MS;
+	}
 
-			if (privmsg && strlen(irc_nick) > 0 && strlen(irc_msg) > 0) {
-				irc_log_message(irc, irc_nick, irc_msg);
-				if (irc_reply_message(irc, irc_nick, irc_msg) < 0)
-					return -1;
-			}
-		}
+	if (next > irc->lastrecv + IRC_TIMEOUT)
+		next = irc->lastrecv + IRC_TIMEOUT;
+
+	tw_add(tw, t, next, irc_keepalive, irc);
+}
+
+/*
+ * irc_lag : a PONG, the round trip if it's for the PING we've got out. One
+ * without our token still counts, not every server sends it back.
+ */
+static void irc_lag(irc_t *irc, ircmsg_t *msg)
+{
+	slice_t *token;
+	uint64_t rtt;
+
+	if (!irc->pingsent)
+		return;
+
+	if (msg->nparams > 0) {
+		token = &msg->params[msg->nparams - 1];
+		if (token->len > 5 && strncmp(token->ptr, "birc-", 5) == 0 &&
+				strtoul(token->ptr + 5, NULL, 10) != irc->pingseq)
+			return; /* an old one, this one's still out */
 	}
 
-	return 0;
+	rtt = now_us() - irc->pingsent;
+	irc->pingsent = 0;
+	met_observe(MET_H_LAG, rtt);
+
+	pthread_mutex_lock(&irc->laglock);
+	irc->lags[irc->nlags++ % IRC_LAGSAMPLES] = rtt > UINT32_MAX ? UINT32_MAX : rtt;
+	pthread_mutex_unlock(&irc->laglock);
+
+	FIO_PRINTF(FIO_VER, "Lag %llu us", (unsigned long long)rtt);
+
+	if (irc->ev)
+		tw_add(&irc->ev->timers, &irc->keepalive, now_ms() + IRC_PING_MS,
+				irc_keepalive, irc);
 }
 
-/* irc_reply_message : checks if someone calls on the bot */
-int irc_reply_message(irc_t *irc, char *irc_nick, char *msg)
+/* irc_expire : forgets the rate limits that have run out, every so often */
+static void irc_expire(tw_t *tw, tw_timer_t *t, void *arg)
 {
-	char *command;
-	char *arg;
-	int i;
+	irc_t *irc;
+	uint64_t now;
 
-	if (*msg == '!') { /* if we have a thing formatted like a command... */
-		/* get the actual command */
-		command = strtok(&msg[1], " ");
-		arg = strtok(NULL, "");
+	irc = arg;
+	now = now_ms();
+
+	rl_expire(&irc->limits, now);
+	tw_add(tw, t, now + RL_EXPIRE_MS, irc_expire, irc);
+}
+
+/* irc_parse_action : parses the incoming action the server's sending us */
+int irc_parse_action(irc_t *irc, char *line, int len)
+{
+	ircmsg_t msg;
 
-		if (arg != NULL) {
-			while (*arg == ' ')
-				arg++;
+	if (ircmsg_parse(&msg, line, len) < 0) {
+		FIO_PRINTF(FIO_WRN, "Couldn't Parse \"%s\"", line);
+		met_inc(MET_PARSE_ERRORS);
+		return 0;
+	}
+
+	if (ircmsg_is(&msg, "PING")) { /* see if it's a ping */
+		return irc_pong(irc, msg.nparams ? msg.params[0].ptr : "");
+
+	} else if (ircmsg_is(&msg, "PONG")) { /* or the answer to one of ours */
+		irc_lag(irc, &msg);
+		return 0;
+
+	} else if (msg.numeric == RPL_WELCOME) {
+		irc_welcome(irc, now_ms());
+		return 0;
+
+	} else if (msg.numeric == ERR_NICKNAMEINUSE && irc->state == IRC_REGISTERING) {
+		/* probably our own ghost from before the drop, take the next one */
+		return irc_nextnick(irc);
+
+	} else if (ircmsg_is(&msg, "JOIN")) {
+		/* the server echoing our first JOIN back is the end of a reconnect */
+		if (irc->downat && slice_eq(&msg.nick, irc->nick)) {
+			FIO_PRINTF(FIO_MSG, "Rejoined %d Channels, %llu ms After the Drop",
+					irc->nchans, (unsigned long long)(now_ms() - irc->downat));
+			irc->downat = 0;
 		}
+		return irc_membership(irc, &msg);
 
-		if (command != NULL) {
-			/* spin through the table of commands */
-			for (i = 0; i < ARRSIZE(ircfuncs); i++) {
-				if (strcmp(command, ircfuncs[i].command) == 0) {
-					return ircfuncs[i].func(irc, irc_nick, arg);
-				}
-			}
+	} else if (ircmsg_is(&msg, "PART") || ircmsg_is(&msg, "KICK") ||
+			ircmsg_is(&msg, "QUIT") || ircmsg_is(&msg, "NICK") ||
+			msg.numeric == RPL_NAMREPLY || msg.numeric == RPL_ENDOFNAMES) {
+		return irc_membership(irc, &msg);
+
+	} else if (ircmsg_is(&msg, "NOTICE")) {
+		/* we really don't care about NOTICE AUTH junk */
+		return 0;
+
+	} else if (ircmsg_is(&msg, "ERROR")) {
+		/* log the fact that the server sent us an error and move on */
+		return 0;
+
+	} else if (ircmsg_is(&msg, "PRIVMSG")) {
+		/* PRIVMSG <target> :<text>, the text is the end of the line */
+		if (msg.nparams < 2 || msg.nick.len == 0)
+			return 0;
+
+		/* see if we have a non-message string */
+		if (memchr(msg.params[1].ptr, 1, msg.params[1].len) != NULL)
+			return 0;
+
+		if (msg.params[1].len > 0) {
+			irc_log_message(irc, &msg);
+
+			/* commands can be slow, keep them off the thread that PONGs */
+			if (irc->pool)
+				return irc_dispatch(irc, &msg, line, len);
+
+			if (irc_reply_message(irc, &msg, &irc->arena) < 0)
+				return -1;
 		}
-	} else { /* non command stuff */
-		return irc_bot_banter(irc, irc_nick, msg);
 	}
 
 	return 0;
 }
 
-/* irc_bot_banter : define a static table to wittily respond to quips in chat */
-static int irc_bot_banter(irc_t *irc, char *irc_nick, char *arg)
+/* irc_membership : keeps irc->members up to date, from one message */
+static int irc_membership(irc_t *irc, ircmsg_t *msg)
 {
-	static struct strdict_t dict[] = {
-		{"Hi", "Hello There!"},
-		{"Hello", "You may approach the bench"},
-		{"thank", "No, THANK YOU!"},
-		{"lol", "heh"},
-		{"heh", "lol"},
-		{"rofl", "OMFGWTFLMAO"},
-		{"lmao", "I'll bet you're laughing your ass off."}
-	};
-	int i;
-	char buf[512];
+	slice_t *chan, *nick;
+	int self, rc;
 
-	/* check if the message is in all upper case first */
-	if (strisupper(arg)) {
-		snprintf(buf, sizeof(buf), "%s QUIT SHOUTING!!", irc_nick);
-		irc_msg(irc->s, irc->channel, buf);
+	if (msg->nick.len == 0 && msg->numeric == 0)
 		return 0;
-	}
 
-	/* iterate through the table to see if we have a match */
-	for (i = 0; i < ARRSIZE(dict); i++) {
-		if (re_match(dict[i].key, arg)) {
-			snprintf(buf, sizeof(buf), "%s", dict[i].val);// probably don't need
-			irc_msg(irc->s, irc->channel, buf);
-		}
+	self = ch_caseeq(msg->nick.ptr, msg->nick.len, irc->nick, strlen(irc->nick));
+	rc = 0;
+
+	if (ircmsg_is(msg, "JOIN") && msg->nparams >= 1) {
+		chan = &msg->params[0];
+		rc = ch_join(&irc->members, chan->ptr, chan->len,
+				msg->nick.ptr, msg->nick.len);
+
+	} else if (ircmsg_is(msg, "PART") && msg->nparams >= 1) {
+		chan = &msg->params[0];
+		if (self)
+			ch_drop(&irc->members, chan->ptr, chan->len);
+		else
+			ch_part(&irc->members, chan->ptr, chan->len,
+					msg->nick.ptr, msg->nick.len);
+
+	} else if (ircmsg_is(msg, "KICK") && msg->nparams >= 2) {
+		chan = &msg->params[0];
+		nick = &msg->params[1];
+		if (ch_caseeq(nick->ptr, nick->len, irc->nick, strlen(irc->nick)))
+			ch_drop(&irc->members, chan->ptr, chan->len);
+		else
+			ch_part(&irc->members, chan->ptr, chan->len, nick->ptr, nick->len);
+
+	} else if (ircmsg_is(msg, "QUIT")) {
+		ch_quit(&irc->members, msg->nick.ptr, msg->nick.len);
+
+	} else if (ircmsg_is(msg, "NICK") && msg->nparams >= 1) {
+		nick = &msg->params[0];
+		if (self && nick->len < sizeof(irc->nick))
+			irc_setnick(irc, nick->ptr, nick->len);
+		rc = ch_nick(&irc->members, msg->nick.ptr, msg->nick.len,
+				nick->ptr, nick->len);
+
+	} else if (msg->numeric == RPL_NAMREPLY && msg->nparams >= 3) {
+		/* 353 me = #chan :@op +voice nick, the '=' is optional */
+		chan = &msg->params[msg->nparams - 2];
+		nick = &msg->params[msg->nparams - 1];
+		rc = ch_names(&irc->members, chan->ptr, chan->len, nick->ptr, nick->len);
+
+	} else if (msg->numeric == RPL_ENDOFNAMES && msg->nparams >= 2) {
+		chan = &msg->params[1];
+		ch_namesend(&irc->members, chan->ptr, chan->len);
 	}
 
+	if (rc < 0)
+		FIO_PRINTF(FIO_WRN, "Couldn't Track %.*s", msg->command.len, msg->command.ptr);
+
 	return 0;
 }
 
-/* irc_botcmd_help : handles help command and prints command usage info */
-static int irc_botcmd_help(irc_t *irc, char *irc_nick, char *arg)
+/* irc_dispatch : hands a PRIVMSG to the pool, in order with its channel */
+static int irc_dispatch(irc_t *irc, ircmsg_t *msg, char *line, int len)
 {
-	int i, len;
-	char buf[256];
+	struct irc_job_t *job;
+	slice_t *target;
+	uint32_t key;
+	char *copy;
 
-	/*
-	 * if no arguments are present, we print all of the available commands
-	 * if arguments were passed, check if it's a command, if so, print the usage
-	 */
+	if ((job = irc_getjob(irc)) == NULL)
+		return 0;
 
-	if (arg) { /* we got an arg, find the one we need, and print the help */
-		for (i = 0; i < ARRSIZE(ircfuncs); i++) {
-			if (strcmp(arg, ircfuncs[i].command) == 0)
-				break;
-		}
+	job->recvd = now_us();
 
-		if (i == ARRSIZE(ircfuncs)) {
-			snprintf(buf, sizeof(buf),
-					"%s: \"%s\" isn't a command", irc_nick, arg);
-		} else {
-			snprintf(buf, sizeof(buf), "%s: %s", irc_nick, ircfuncs[i].usage);
-		}
+	if ((copy = arena_strndup(&job->arena, line, len)) == NULL) {
+		irc_putjob(irc, job);
+		return 0;
+	}
 
+	job->msg = *msg;
+	ircmsg_rebase(&job->msg, line, copy);
 
-	} else { /* no arg, print out all of the commands that we can fit in here */
-		snprintf(buf, sizeof(buf), "%s: commands: ", irc_nick);
-		for (i = 0, len = strlen(buf); i < ARRSIZE(ircfuncs) || len >= 200;
-				i++, len = strlen(buf)) {
-			snprintf(buf + len, sizeof(buf) - len, "!%s ", ircfuncs[i].command);
-		}
+	/* same connection and reply target, same strand */
+	target = irc_target(msg);
+	key = phash(target->ptr, target->len, (uintptr_t)irc);
+
+	if (pool_submit(irc->pool, key, &job->job) < 0) {
+		met_inc(MET_COMMANDS_REJECTED);
+		irc->rejected++;
+		irc_rejectwarn(irc, now_ms());
+		irc_putjob(irc, job);
+		return 0;
 	}
 
-	irc_msg(irc->s, irc->channel, buf);
+	met_inc(MET_COMMANDS);
 
 	return 0;
 }
 
-/* irc_botcmd_wiki : adds a sloo of wiki functionality */
-static int irc_botcmd_wiki(irc_t *irc, char *irc_nick, char *arg)
-{
-	/*
-	 * Similar to the google command, this command generates a github query to
-	 * search the RetropieWiki.
-	 *
-	 * Github has special search rules, which can be found here:
-	 *     https://help.github.com/en/articles/searching-wikis
-	 * The jist is that we're setting
-	 *     user:retropie
-	 *     repo:retropie-setup
-	 *     in:title
-	 *     in:body
-	 *
-	 * Then plop the query string after it, and encode the URL
-	 * https://github.com/search?q=user%3Aretropie+
-	 *                repo%3ARetroPie-Setup+in%3Atitle+Nintendo+64&type=Wikis
-	 */
+/*
+ * irc_rejectwarn : one warning for every line the pool turned away since the
+ * last, at most every IRC_DROPWARN_MS. A flood is what fills the pool, it
+ * shouldn't get a log line (or its text in the log) for every line too.
+ */
+static void irc_rejectwarn(irc_t *irc, uint64_t now)
+{
+	if (!irc->rejected || now < irc->rejectwarn)
+		return;
+
+	FIO_PRINTF(FIO_WRN, "Command Pool Full, Dropped %lu Lines", irc->rejected);
 
-	int rc;
-	char mesg[512], tmpbuf[512];
-	memset(mesg, 0, sizeof(mesg));
-	memset(tmpbuf, 0, sizeof(tmpbuf));
+	irc->rejected = 0;
+	irc->rejectwarn = now + IRC_DROPWARN_MS;
+}
 
-	snprintf(tmpbuf, sizeof(mesg),
-			"user:retropie+" "repo:RetroPie-Setup+"
-			"in:title+%s&type=Wikis", arg);
+/* irc_runjob : a command worker's end of irc_dispatch */
+static void irc_runjob(pool_job_t *job)
+{
+	struct irc_job_t *ij;
 
-	rc = url_encode(mesg, sizeof(mesg), tmpbuf, WEBPREFIX_GITHUB);
+	ij = (struct irc_job_t *)job;
 
-	if (rc < 0) {
-		FIO_PRINTF(FIO_ERR, "Error Converting %s to proper URL", tmpbuf);
-		snprintf(mesg, sizeof(mesg), "Error Converting input to proper URL...");
-	}
+	irc_reply_message(ij->irc, &ij->msg, &ij->arena);
 
-	return irc_msg(irc->s, irc->channel, mesg);
+	met_observe(MET_H_REPLY, now_us() - ij->recvd);
+
+	irc_putjob(ij->irc, ij);
 }
 
-/* irc_botcmd_8ball : responds to magic 8 ball requests */
-static int irc_botcmd_8ball(irc_t *irc, char *irc_nick, char *arg)
+/* irc_getjob : a finished job to reuse, or a new one if there aren't any */
+static struct irc_job_t *irc_getjob(irc_t *irc)
 {
-	/*
-	 * You'd think there were only 8 answers inside of a magic 8 ball, but it
-	 * turns out there's like, 20! Who knew!
-	 */
+	struct irc_job_t *job;
 
-	char *table[] = {
-		"It is certain.", "It is decidedly so.", "Without a doubt",
-		"Yes - definitely.", "You may rely on it.", "As I see it, yes.",
-		"Most likely.", "Outlook good.", "Yes.",
-		"Signs point to yes.", "Reply hazy, try again.", "Ask again later",
-		"Better not tell you now", "Cannot predict now",
-		"Concentrate and ask again", "Don't count on it.", "My reply is no.",
-		"My sources say no.", "Outlook not so good.", "Very doubtful."
-	};
+	pthread_mutex_lock(&irc->joblock);
+	if ((job = irc->jobs))
+		irc->jobs = (struct irc_job_t *)job->job.next;
+	pthread_mutex_unlock(&irc->joblock);
 
-	int i;
+	if (job)
+		return job;
 
-	i = rand() % ARRSIZE(table);
+	if ((job = malloc(sizeof(*job))) == NULL)
+		return NULL;
 
-	if (irc_msg(irc->s, irc->channel, table[i]) < 0)
-		return -1;
+	job->job.func = irc_runjob;
+	job->irc = irc;
+	arena_init(&job->arena, job->mem, sizeof(job->mem));
 
-	return 0;
+	return job;
 }
 
-/* irc_botcmd_ping : responds to a user with "pong" */
-static int irc_botcmd_ping(irc_t *irc, char *irc_nick, char *arg)
+/* irc_putjob : empties job's arena, and keeps it for the next PRIVMSG */
+static void irc_putjob(irc_t *irc, struct irc_job_t *job)
 {
-	if (irc_msg(irc->s, irc->channel, "pong") < 0)
-		return -1;
+	arena_reset(&job->arena);
+	job->job.func = irc_runjob;
 
-	return 0;
+	pthread_mutex_lock(&irc->joblock);
+	job->job.next = (pool_job_t *)irc->jobs;
+	irc->jobs = job;
+	pthread_mutex_unlock(&irc->joblock);
 }
 
-/* irc_botcmd_smack : smacks someone over TCP/IP */
-static int irc_botcmd_smack(irc_t *irc, char *irc_nick, char *arg)
+/* irc_reply_message : checks if someone calls on the bot, ar is its scratch */
+int irc_reply_message(irc_t *irc, ircmsg_t *msg, arena_t *ar)
 {
-	int damage;
-	char mesg[512];
+	struct ircfunc_t *func;
+	char *text, *arg, *p;
+	int len, nargs;
 
-	damage = rand() % 21 + 1;
+	text = msg->params[1].ptr;
 
-	if (!arg) { /* if we have an argument, we'll smack the arg */
-		arg = irc_nick;
-	}
+	if (*text == '!') { /* if we have a thing formatted like a command... */
+		/* get the actual command */
+		text++;
+		for (len = 0; text[len] && text[len] != ' '; len++)
+			;
 
-	snprintf(mesg, 511, "smacks %s for %d damage%s.",
-			arg, damage, damage == 20 ? " (SUPER EFFECTIVE)" : "");
+		arg = text + len;
+		while (*arg == ' ')
+			arg++;
 
-	mesg[511] = '\0'; /* ensure we have a NULL terminated string */
+		if (*arg == '\0')
+			arg = NULL;
 
-	if (irc_action(irc->s, irc->channel, mesg) < 0)
-		return -1;
+		if (len > 0 && (func = ircfunc_lookup(text, len)) != NULL) {
+			/* even the usage costs a line, so it's limited the same */
+			if (!irc_bot_allow(irc, msg, func->rate))
+				return 0;
+
+			/* count the words, so the handler doesn't have to */
+			for (nargs = 0, p = arg; p && *p; nargs++) {
+				while (*p && *p != ' ')
+					p++;
+				while (*p == ' ')
+					p++;
+			}
+
+			if (nargs < func->minargs ||
+					(func->maxargs >= 0 && nargs > func->maxargs)) {
+				return irc_answer(irc, msg, func->usage);
+			}
+
+			return func->func(irc, msg, arg, ar);
+		}
+	} else { /* non command stuff */
+		return irc_bot_banter(irc, msg, text, ar);
+	}
 
 	return 0;
 }
 
-/* irc_botcmd_google : IRC command for generating Google Links */
-static int irc_botcmd_google(irc_t *irc, char *irc_nick, char *arg)
+/* irc_target : where a reply to msg goes, the channel or the sender */
+slice_t *irc_target(ircmsg_t *msg)
 {
-	int rc;
-	char mesg[512];
+	/* a PRIVMSG to a nick is one to us, answer whoever sent it */
+	if (msg->nparams > 0 && ch_ischan(msg->params[0].ptr, msg->params[0].len))
+		return &msg->params[0];
+
+	return &msg->nick;
+}
+
+/*
+ * irc_lagstats : the last round trip to the server, and percentiles of the
+ * ones before it, in us, returns how many there are to go on
+ */
+int irc_lagstats(irc_t *irc, uint64_t *last, uint64_t *p50, uint64_t *p90,
+		uint64_t *p99)
+{
+	uint32_t lags[IRC_LAGSAMPLES];
+	int n;
 
-	memset(mesg, 0, sizeof(mesg)); /* clean the buffer */
+	pthread_mutex_lock(&irc->laglock);
+	n = irc->nlags < IRC_LAGSAMPLES ? irc->nlags : IRC_LAGSAMPLES;
+	memcpy(lags, irc->lags, n * sizeof(*lags));
+	*last = n ? irc->lags[(irc->nlags - 1) % IRC_LAGSAMPLES] : 0;
+	pthread_mutex_unlock(&irc->laglock);
 
-	if (!arg) {
+	if (n == 0)
 		return 0;
+
+	qsort(lags, n, sizeof(*lags), irc_lagcmp);
+	*p50 = lags[(n - 1) * 50 / 100];
+	*p90 = lags[(n - 1) * 90 / 100];
+	*p99 = lags[(n - 1) * 99 / 100];
+
+	return n;
+}
+
+/* irc_lagcmp : qsort comparison for round trips */
+static int irc_lagcmp(const void *a, const void *b)
+{
+	uint32_t x, y;
+
+	x = *(const uint32_t *)a;
+	y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* irc_log_message : puts msg in the chat log, under whoever it was to */
+int irc_log_message(irc_t *irc, ircmsg_t *msg)
+{
+	slice_t *t;
+
+	t = irc_target(msg);
+
+	return cl_log(irc->server, t->ptr, t->len, msg->nick.ptr, msg->nick.len,
+			msg->params[1].ptr, msg->params[1].len, 0);
+}
+
+/* irc_drop : closes the connection, and schedules a reconnect */
+void irc_drop(irc_t *irc, uint64_t now)
+{
+	int delay;
+
+	if (irc->state == IRC_DOWN || irc->state == IRC_BACKOFF)
+		return;
+
+	irc_shutdown(irc);
+
+	if (!irc->downat)
+		irc->downat = now;
+
+	/* jittered exponential backoff, somewhere in [backoff / 2, backoff] */
+	delay = irc->backoff / 2 + rand() % (irc->backoff / 2 + 1);
+	irc->backoff = irc->backoff * 2 < IRC_BACKOFF_MAX ? irc->backoff * 2 : IRC_BACKOFF_MAX;
+
+	irc->retryat = now + delay;
+	irc->state = IRC_BACKOFF;
+	irc->reconnects++;
+	met_inc(MET_RECONNECTS);
+
+	FIO_PRINTF(FIO_WRN, "Connection to %s Dropped, Retrying in %d ms",
+			irc->server, delay);
+}
+
+/* irc_close : closes the connection for good */
+void irc_close(irc_t *irc)
+{
+	struct irc_job_t *job;
+	struct irc_later_t *later;
+
+	irc_shutdown(irc);
+
+	/* whatever's still waiting to be said won't be */
+	pthread_mutex_lock(&irc->laterlock);
+	while ((later = irc->later)) {
+		irc->later = later->next;
+		if (irc->ev)
+			tw_del(&irc->ev->timers, &later->timer);
+		free(later);
+	}
+	irc->nlater = 0;
+	pthread_mutex_unlock(&irc->laterlock);
+
+	if (irc->ev)
+		tw_del(&irc->ev->timers, &irc->expire);
+
+	if (irc->ev && irc->wakefd >= 0)
+		ev_del(irc->ev, irc->wakefd);
+
+	pthread_mutex_lock(&irc->sqlock);
+	if (irc->wakefd >= 0)
+		close(irc->wakefd);
+	irc->wakefd = -1;
+	pthread_mutex_unlock(&irc->sqlock);
+
+	if (irc->dns)
+		freeaddrinfo(irc->dns);
+	irc->dns = NULL;
+
+	/* the pool's finished before we're closed, so a lookup's either in or never ran */
+	if (irc->resolving == IRC_DNSDONE && irc->dnsnext)
+		freeaddrinfo(irc->dnsnext);
+	irc->dnsnext = NULL;
+	irc->resolving = IRC_DNSIDLE;
+
+	ch_free(&irc->members);
+	rl_free(&irc->limits);
+
+	/* the pool's done with them by now */
+	pthread_mutex_lock(&irc->joblock);
+	while ((job = irc->jobs)) {
+		irc->jobs = (struct irc_job_t *)job->job.next;
+		free(job);
 	}
+	pthread_mutex_unlock(&irc->joblock);
 
-	rc = url_encode(mesg, sizeof(mesg), arg, WEBPREFIX_GOOGLE);
+	irc->state = IRC_DOWN;
+	irc->ev = NULL;
+}
 
-	if (rc < 0) {
-		snprintf(mesg, sizeof(mesg), "Search too long. Google it youself!");
+/* irc_shutdown : closes the socket (or the attempts), keeps everything else */
+static void irc_shutdown(irc_t *irc)
+{
+	int i;
+
+	if (irc->state == IRC_CONNECTING) {
+		for (i = 0; irc->ev && i < irc->race.naddrs; i++) {
+			if (irc->race.fds[i] >= 0)
+				ev_del(irc->ev, irc->race.fds[i]);
+		}
+
+		sck_raceabort(&irc->race);
 	}
 
-	if (irc_msg(irc->s, irc->channel, mesg) < 0)
-		return -1;
+	if (irc->s < 0)
+		return;
 
-	return 0;
+	if (irc->state == IRC_UP)
+		met_gauge_add(MET_G_CONNECTED, -1);
+
+	if (irc->ev) {
+		ev_del(irc->ev, irc->s);
+		tw_del(&irc->ev->timers, &irc->keepalive);
+	}
+
+	/* workers check s under the lock, so they'll see we're gone */
+	pthread_mutex_lock(&irc->sqlock);
+
+	FIO_PRINTF(FIO_MSG, "Send Queue: %lu Sent, %lu Dropped, %lu Writes, "
+			"Max Depth %d, Drain Latency Avg %llu ms Max %llu ms",
+			irc->sq.sent, irc->sq.dropped, irc->sq.writes, irc->sq.maxdepth,
+			(unsigned long long)(irc->sq.sent ? irc->sq.latsum / irc->sq.sent : 0),
+			(unsigned long long)irc->sq.latmax);
+
+	close(irc->s);
+	irc->s = -1;
+
+	pthread_mutex_unlock(&irc->sqlock);
 }
 
-int irc_log_message(irc_t *irc, const char* nick, const char* message)
+/* irc_track : remembers (or forgets) a channel, so a reconnect rejoins it */
+static int irc_track(irc_t *irc, const char *channel, int add)
 {
-	char timestring[128];
-	time_t curtime;
+	char name[IRC_CHANLEN];
+	int i, len;
+
+	/* JOIN #chan key, or PART #chan :reason, we only want the name */
+	len = strcspn(channel, " ");
+	if (len == 0 || len >= sizeof(name))
+		return -1;
 
-	time(&curtime);
-	strftime(timestring, 127, "%F - %H:%M:%S", localtime(&curtime));
-	timestring[127] = '\0';
+	snprintf(name, sizeof(name), "%.*s", len, channel);
 
-	FIO_PRINTF(FIO_LOG, "%s [%s] <%s> %s\n",
-			irc->channel, timestring, nick, message);
+	for (i = 0; i < irc->nchans && strcmp(irc->chans[i], name); i++)
+		;
+
+	if (add && i == irc->nchans) {
+		if (irc->nchans == IRC_MAXCHANS)
+			return -1;
+		strcpy(irc->chans[irc->nchans++], name);
+	} else if (!add && i < irc->nchans) {
+		memmove(irc->chans[i], irc->chans[i + 1],
+				(irc->nchans - i - 1) * sizeof(irc->chans[0]));
+		irc->nchans--;
+	}
 
 	return 0;
 }
 
-void irc_close(irc_t *irc)
+/* irc_sendf : queues a formatted line on lane, sent now unless batching */
+int irc_sendf(irc_t *irc, int lane, const char *fmt, ...)
 {
-	close(irc->s);
+	char send_buf[512];
+	uint64_t one;
+	int send_len, rc, io;
+	va_list args;
+
+	va_start(args, fmt);
+	send_len = vsnprintf(send_buf, sizeof(send_buf), fmt, args);
+	va_end(args);
+
+	/* clamp the data, and keep the line ending if we had to */
+	if (send_len > sizeof(send_buf) - 1) {
+		send_len = sizeof(send_buf) - 1;
+		send_buf[send_len - 2] = '\r';
+		send_buf[send_len - 1] = '\n';
+	}
+
+	io = pthread_equal(pthread_self(), irc->iothread);
+
+	pthread_mutex_lock(&irc->sqlock);
+
+	if (irc->s < 0) {
+		pthread_mutex_unlock(&irc->sqlock);
+		return -1;
+	}
+
+	rc = sq_push(&irc->sq, lane, send_buf, send_len, now_ms());
+
+	/* off the I/O thread, we just poke it and let it do the writing */
+	if (rc >= 0 && !io && irc->wakefd >= 0) {
+		one = 1;
+		if (write(irc->wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+			FIO_PRINTF(FIO_WRN, "Couldn't Wake I/O Thread %s", strerror(errno));
+	}
+
+	pthread_mutex_unlock(&irc->sqlock);
+
+	if (rc < 0) {
+		FIO_PRINTF(FIO_WRN, "Send Queue Full, Dropping Line");
+		met_inc(MET_TX_DROPPED);
+		return 0; /* the server's not reading, the timeout will catch it */
+	}
+
+	FIO_PRINTF(FIO_VER, "Queued %.*s", send_len, send_buf);
+
+	if (io && !irc->batching && irc_flush(irc) < 0)
+		return -1;
+
+	return send_len;
 }
 
 /* irc_pong : answers pong requests */
-int irc_pong(int s, const char *data)
+int irc_pong(irc_t *irc, const char *data)
 {
-	return sck_sendf(s, "PONG :%s\r\n", data);
+	return irc_sendf(irc, SQ_CTRL, "PONG :%s\r\n", data);
 }
 
 /* irc_reg : registers user upon login */
-int irc_reg(int s, const char *nick, const char *username, const char *fullname)
+int irc_reg(irc_t *irc, const char *nick, const char *username, const char *fullname)
 {
-	return sck_sendf(s, "NICK %s\r\nUSER %s localhost 0 :%s\r\n", nick, username, fullname);
+	if (irc_sendf(irc, SQ_CTRL, "NICK %s\r\n", nick) < 0)
+		return -1;
+	return irc_sendf(irc, SQ_CTRL, "USER %s localhost 0 :%s\r\n", username, fullname);
 }
 
-/* irc_join : joins channels */
-int irc_join(int s, const char *data)
+/* irc_join : joins channels, now if we're registered, otherwise on welcome */
+int irc_join(irc_t *irc, const char *data)
 {
-	return sck_sendf(s, "JOIN %s\r\n", data);
+	irc_track(irc, data, 1);
+
+	if (irc->state != IRC_UP)
+		return 0;
+
+	return irc_sendf(irc, SQ_CTRL, "JOIN %s\r\n", data);
 }
 
 /* irc_part : sends the PART command to the server */
-int irc_part(int s, const char *data)
+int irc_part(irc_t *irc, const char *data)
 {
-	return sck_sendf(s, "PART %s\r\n", data);
+	irc_track(irc, data, 0);
+
+	if (irc->state != IRC_UP)
+		return 0;
+
+	return irc_sendf(irc, SQ_CTRL, "PART %s\r\n", data);
 }
 
 /* irc_nick : changes irc nickname */
-int irc_nick(int s, const char *data)
+int irc_nick(irc_t *irc, const char *data)
 {
-	return sck_sendf(s, "NICK %s\r\n", data);
+	return irc_sendf(irc, SQ_CTRL, "NICK %s\r\n", data);
 }
 
 /* irc_quit : quits irc */
-int irc_quit(int s, const char *data)
+int irc_quit(irc_t *irc, const char *data)
 {
-	return sck_sendf(s, "QUIT :%s\r\n", data);
+	return irc_sendf(irc, SQ_CTRL, "QUIT :%s\r\n", data);
 }
 
 /* irc_topic : sets/removes the topic of a channel */
-int irc_topic(int s, const char *channel, const char *data)
+int irc_topic(irc_t *irc, const char *channel, const char *data)
 {
-	return sck_sendf(s, "TOPIC %s :%s\r\n", channel, data);
+	return irc_sendf(irc, SQ_NORMAL, "TOPIC %s :%s\r\n", channel, data);
 }
 
 /* irc_action : executes an action (.e.g /me is hungry) */
-int irc_action(int s, const char *channel, const char *data)
+int irc_action(irc_t *irc, const char *channel, const char *data)
 {
 	int rc;
-	rc = sck_sendf(s, "PRIVMSG %s :\001ACTION %s\001\r\n", channel, data);
+	rc = irc_sendf(irc, SQ_NORMAL, "PRIVMSG %s :\001ACTION %s\001\r\n", channel, data);
 	FIO_PRINTF(FIO_LOG, "PRIVMSG %s :\001ACTION %s\001\r\n", channel, data);
 	return rc;
 }
 
 /* irc_msg : sends a channel message or a query */
-int irc_msg(int s, const char *channel, const char *data)
+int irc_msg(irc_t *irc, const char *channel, const char *data)
 {
 	int rc;
-	rc = sck_sendf(s, "PRIVMSG %s :%s\r\n", channel, data);
+	rc = irc_sendf(irc, SQ_NORMAL, "PRIVMSG %s :%s\r\n", channel, data);
 	FIO_PRINTF(FIO_LOG, "PRIVMSG %s :%s\r\n", channel, data);
 	return rc;
 }
 
-/* misc */
-
-/* url_encode : encodes a URL query string to a web friendly format */
-static int url_encode(char *buf, int buflen, char *src, char *prefix)
+/* irc_answer : replies to msg, wherever it came from */
+int irc_answer(irc_t *irc, ircmsg_t *msg, const char *data)
 {
-	int len;
+	char me[IRC_CHANLEN];
+	slice_t *t;
+	int rc, n;
 
-	snprintf(buf, buflen, "%s", prefix); /* plop the query prefix first */
+	if ((t = irc_target(msg))->len == 0)
+		return 0;
 
-	/* then encode the rest of the URL */
-	for (len = strlen(buf); len < buflen && *src; src++, len = strlen(buf)) {
-		if (url_encode_byte(*src)) { /* encoding */
-			snprintf(buf + len, buflen-len, "%%%02x", *src);
-		} else { /* no encoding */
-			snprintf(buf + len, buflen-len, "%c", *src);
-		}
-	}
+	rc = irc_sendf(irc, SQ_NORMAL, "PRIVMSG %.*s :%s\r\n", t->len, t->ptr, data);
+	n = irc_mynick(irc, me, sizeof(me));
+	cl_log(irc->server, t->ptr, t->len, me, n, data, strlen(data), CL_SELF);
+	return rc;
+}
 
-	if (*src != '\0') {
-		return -1; /* couldn't encode the url, not enough space */
-	}
+/* irc_answer_action : irc_answer, as a /me */
+int irc_answer_action(irc_t *irc, ircmsg_t *msg, const char *data)
+{
+	slice_t *t;
+	char buf[512]; /* the longest line the server would take anyway */
+	char me[IRC_CHANLEN];
+	int rc, n, mlen;
 
-	return 0;
+	if ((t = irc_target(msg))->len == 0)
+		return 0;
+
+	rc = irc_sendf(irc, SQ_NORMAL, "PRIVMSG %.*s :\001ACTION %s\001\r\n",
+			t->len, t->ptr, data);
+	n = snprintf(buf, sizeof(buf), "\001ACTION %s\001", data);
+	mlen = irc_mynick(irc, me, sizeof(me));
+	cl_log(irc->server, t->ptr, t->len, me, mlen,
+			buf, n < sizeof(buf) ? n : sizeof(buf) - 1, CL_SELF);
+	return rc;
 }
 
-/* url_encode_byte : determine if this byte needs to be encoded specially */
-static int url_encode_byte(unsigned char in)
+/*
+ * irc_answer_later : irc_answer, delay ms from now, from the event loop's
+ * timing wheel. It's gone if the connection's closed first.
+ */
+int irc_answer_later(irc_t *irc, ircmsg_t *msg, uint64_t delay, const char *data)
 {
-	int rc;
+	struct irc_later_t *later;
+	slice_t *t;
 
-	rc = 1; /* assume we're going to encode it */
+	if ((t = irc_target(msg))->len == 0 || t->len >= IRC_CHANLEN || !irc->ev)
+		return -1;
 
-	if (isdigit(in) || isalpha(in)) {
-		rc = 0;
-	}
+	if (!(later = calloc(1, sizeof(*later))))
+		return -1;
 
-	/* until we assume we don't want to */
+	later->irc = irc;
+	snprintf(later->target, sizeof(later->target), "%.*s", t->len, t->ptr);
+	snprintf(later->text, sizeof(later->text), "%s", data);
 
-	switch (in) {
-	case '+':
-	case '/':
-	case '&':
-	case '=':
-		rc = 0;
-		break;
-	default:
-		break;
+	pthread_mutex_lock(&irc->laterlock);
 
+	if (irc->nlater >= IRC_MAXLATER) {
+		pthread_mutex_unlock(&irc->laterlock);
+		free(later);
+		return -1;
 	}
 
-	return rc;
+	later->next = irc->later;
+	if (later->next)
+		later->next->prev = later;
+	irc->later = later;
+	irc->nlater++;
+
+	/* under the lock, so irc_close can't free it before it's in the wheel */
+	tw_add(&irc->ev->timers, &later->timer, now_ms() + delay, irc_later, later);
+
+	pthread_mutex_unlock(&irc->laterlock);
+
+	return 0;
 }
 
+/* irc_later : an irc_answer_later that's come due, on the event loop */
+static void irc_later(tw_t *tw, tw_timer_t *t, void *arg)
+{
+	struct irc_later_t *later;
+	char me[IRC_CHANLEN];
+	irc_t *irc;
+	int n;
+
+	later = arg;
+	irc = later->irc;
+
+	/* nowhere to say it, try again once we're (hopefully) back */
+	if (irc->state != IRC_UP) {
+		tw_add(tw, t, now_ms() + IRC_LATERRETRY, irc_later, later);
+		return;
+	}
+
+	irc_sendf(irc, SQ_NORMAL, "PRIVMSG %s :%s\r\n", later->target, later->text);
+	n = irc_mynick(irc, me, sizeof(me));
+	cl_log(irc->server, later->target, strlen(later->target),
+			me, n, later->text, strlen(later->text), CL_SELF);
+
+	pthread_mutex_lock(&irc->laterlock);
+	if (later->prev)
+		later->prev->next = later->next;
+	else
+		irc->later = later->next;
+	if (later->next)
+		later->next->prev = later->prev;
+	irc->nlater--;
+	pthread_mutex_unlock(&irc->laterlock);
+
+	free(later);
+}
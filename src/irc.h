@@ -2,35 +2,163 @@
 #define IRC_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+
+#include "event.h"
+#include "frame.h"
+#include "ircmsg.h"
+#include "sendq.h"
+#include "pool.h"
+#include "socket.h"
+#include "chans.h"
+#include "arena.h"
+#include "ratelimit.h"
+
+#define IRC_READS     4      /* recv calls per wakeup, so no one hogs the loop */
+#define IRC_TIMEOUT   120000 /* ms of silence before we give up on a server */
+#define IRC_TICK      100    /* ms between irc_tick sweeps */
+
+#define IRC_BACKOFF_MIN 500    /* ms before the first reconnect, jittered */
+#define IRC_BACKOFF_MAX 120000 /* where the doubling stops */
+#define IRC_DNSTTL      300000 /* ms we trust a resolver answer for */
+#define IRC_MAXCHANS    32     /* channels we remember, to rejoin */
+#define IRC_CHANLEN     64
+#define IRC_ARENA       4096   /* scratch for the line being handled */
+#define IRC_JOBARENA    2048   /* and for each command on the pool */
+#define IRC_MAXLATER    1024   /* answers waiting on a timer, per connection */
+#define IRC_LATERLEN    400
+#define IRC_LATERRETRY  10000  /* ms until one that came due while we were down tries again */
+#define IRC_PING_MS     15000  /* between our PINGs, timing the server */
+#define IRC_LAG_MS      30000  /* a PING unanswered this long, we reconnect */
+#define IRC_LAGSAMPLES  64     /* round trips kept for !lag's percentiles */
+#define IRC_DROPWARN_MS 10000  /* at most one warning about a full pool this often */
+
+/* where the connection is, irc_tick moves it along */
+enum {
+	IRC_DOWN,        /* closed for good, or never opened */
+	IRC_BACKOFF,     /* dropped, waiting to reconnect */
+	IRC_RESOLVING,   /* waiting on the pool for the server's addresses */
+	IRC_CONNECTING,  /* racing the server's addresses */
+	IRC_REGISTERING, /* connected, waiting for RPL_WELCOME */
+	IRC_UP           /* registered, channels joined */
+};
+
+/* where the pool's lookup of the server is */
+enum {
+	IRC_DNSIDLE,
+	IRC_DNSOUT,  /* running on the pool */
+	IRC_DNSDONE  /* dnsnext is its answer, NULL if there wasn't one */
+};
 
 struct irc_t {
 	int s;
+	int state;
 	char channel[256];
-	char *nick;
-	char servbuf[512];
+	char nick[IRC_CHANLEN]; /* what the server knows us as, changed under sqlock */
+
+	/* what we ask the server for every time we (re)connect */
+	char wantnick[IRC_CHANLEN];
+	int nicktries; /* underscores on it, this registration */
+	char server[256];
+	char port[16];
+	char chans[IRC_MAXCHANS][IRC_CHANLEN];
+	int nchans;
+
+	/* who's in the channels we're in, kept from JOINs, PARTs and NAMES */
+	chans_t members;
+
+	/* everyone's budget for getting answers out of us, see botcmd.def */
+	rl_t limits;
+
+	/* reconnect bookkeeping */
+	struct addrinfo *dns;
+	uint64_t dnsexpires;
+	pool_job_t resolver; /* getaddrinfo blocks, so it runs on the pool */
+	_Atomic int resolving;
+	struct addrinfo *dnsnext;
+	sck_race_t race;
+	int backoff;
+	uint64_t retryat;
+	uint64_t downat; /* when we dropped, for the time to rejoin */
+	unsigned long reconnects;
+
+	/* inbound bytes, kept across reads until they make a whole line */
+	frame_t rbuf;
+
+	/* scratch for the line the I/O thread is on, reset after every one */
+	arena_t arena;
+	char arenamem[IRC_ARENA];
+
+	/* outbound lines, batched into one write and paced for the server */
+	sendq_t sq;
+	pthread_mutex_t sqlock; /* command workers queue replies too */
+	int batching; /* inside irc_handle_data, hold the writes until the end */
+
+	/* commands run on the pool, their replies wake us through wakefd */
+	pool_t *pool;
+	pthread_t iothread;
+	int wakefd;
+	struct irc_job_t *jobs; /* finished ones, to reuse, so a PRIVMSG isn't a malloc */
+	pthread_mutex_t joblock;
+	unsigned long rejected; /* lines the full pool turned away, not warned about yet */
+	uint64_t rejectwarn;    /* when we can warn about them */
+
+	/* on the event loop's timing wheel */
+	tw_timer_t keepalive; /* PINGs the server, drops a dead or lagging one */
+	tw_timer_t expire;    /* forgets the rate limiter's full buckets */
+	struct irc_later_t *later; /* answers for later, !remind's */
+	int nlater;
+	pthread_mutex_t laterlock;
+
+	/* lag, timed with our own PINGs */
+	uint32_t pingseq;
+	uint64_t pingsent; /* now_us the one in flight went out, 0 if none has */
+	int lag_ms;        /* how long it can be out, 0 only counts silence */
+	uint32_t lags[IRC_LAGSAMPLES]; /* us, a ring of the last round trips */
+	int nlags;
+	pthread_mutex_t laglock;
+
+	uint64_t lastrecv;
+	int connect_ms; /* deadline for irc_connect, every address included */
+	ev_t *ev;
 };
 
 typedef struct irc_t irc_t;
 
+void irc_init(irc_t *irc);
 int irc_connect(irc_t *irc, const char* server, const char* port);
+int irc_attach(irc_t *irc, ev_t *ev, pool_t *pool);
 int irc_login(irc_t *irc, const char* nick);
 int irc_join_channel(irc_t *irc, const char* channel);
 int irc_leave_channel(irc_t *irc);
 int irc_handle_data(irc_t *irc);
-int irc_parse_action(irc_t *irc);
-int irc_log_message(irc_t *irc, const char *nick, const char* msg);
-int irc_reply_message(irc_t *irc, char *nick, char* msg);
+int irc_flush(irc_t *irc);
+int irc_tick(irc_t *irc, uint64_t now);
+int irc_parse_action(irc_t *irc, char *line, int len);
+int irc_log_message(irc_t *irc, ircmsg_t *msg);
+int irc_reply_message(irc_t *irc, ircmsg_t *msg, arena_t *ar);
+slice_t *irc_target(ircmsg_t *msg);
+int irc_lagstats(irc_t *irc, uint64_t *last, uint64_t *p50, uint64_t *p90,
+		uint64_t *p99);
+void irc_drop(irc_t *irc, uint64_t now);
 void irc_close(irc_t *irc);
 
 // IRC Protocol
-int irc_pong(int s, const char *pong);
-int irc_reg(int s, const char *nick, const char *username, const char *fullname);
-int irc_join(int s, const char *channel);
-int irc_part(int s, const char *data);
-int irc_nick(int s, const char *nick);
-int irc_quit(int s, const char *quit_msg);
-int irc_topic(int s, const char *channel, const char *data);
-int irc_action(int s, const char *channel, const char *data);
-int irc_msg(int s, const char *channel, const char *data);
+int irc_sendf(irc_t *irc, int lane, const char *fmt, ...);
+int irc_pong(irc_t *irc, const char *pong);
+int irc_reg(irc_t *irc, const char *nick, const char *username, const char *fullname);
+int irc_join(irc_t *irc, const char *channel);
+int irc_part(irc_t *irc, const char *data);
+int irc_nick(irc_t *irc, const char *nick);
+int irc_quit(irc_t *irc, const char *quit_msg);
+int irc_topic(irc_t *irc, const char *channel, const char *data);
+int irc_action(irc_t *irc, const char *channel, const char *data);
+int irc_msg(irc_t *irc, const char *channel, const char *data);
+int irc_answer(irc_t *irc, ircmsg_t *msg, const char *data);
+int irc_answer_action(irc_t *irc, ircmsg_t *msg, const char *data);
+int irc_answer_later(irc_t *irc, ircmsg_t *msg, uint64_t delay, const char *data);
 
 #endif
@@ -0,0 +1,213 @@
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 22:10
+ *
+ * IRC Message Parsing
+ *
+ * ircmsg_parse breaks one line into slices of the line itself:
+ *
+ *     [@tags] [:nick!user@host] COMMAND [param ...] [:trailing param]
+ *
+ * Nothing gets copied, and the line isn't written to, so the slices are only
+ * good as long as the line is. There's no state outside of the ircmsg_t, so
+ * any number of threads can parse at once.
+ */
+
+#include <string.h>
+
+#include "ircmsg.h"
+
+/* ircmsg_parse : parses line into msg, returns -1 if it isn't a message */
+int ircmsg_parse(ircmsg_t *msg, char *line, int len)
+{
+	char *p, *end, *tok, *bang, *at;
+
+	memset(msg, 0, sizeof(*msg));
+
+	p = line;
+	end = line + len;
+
+	/* IRCv3 tags, everything up to the first space */
+	if (p < end && *p == '@') {
+		tok = ++p;
+		if (!(p = memchr(p, ' ', end - p)))
+			return -1;
+		msg->tags.ptr = tok;
+		msg->tags.len = p - tok;
+		while (p < end && *p == ' ')
+			p++;
+	}
+
+	/* prefix, which is either a server name or nick!user@host */
+	if (p < end && *p == ':') {
+		tok = ++p;
+		if (!(p = memchr(p, ' ', end - p)))
+			return -1;
+
+		msg->prefix.ptr = tok;
+		msg->prefix.len = p - tok;
+
+		bang = memchr(tok, '!', p - tok);
+		at = memchr(tok, '@', p - tok);
+
+		msg->nick.ptr = tok;
+		msg->nick.len = (bang ? bang : at ? at : p) - tok;
+
+		if (bang) {
+			msg->user.ptr = bang + 1;
+			msg->user.len = (at && at > bang ? at : p) - msg->user.ptr;
+		}
+
+		if (at) {
+			msg->host.ptr = at + 1;
+			msg->host.len = p - msg->host.ptr;
+		}
+
+		while (p < end && *p == ' ')
+			p++;
+	}
+
+	/* the command or the numeric */
+	tok = p;
+	while (p < end && *p != ' ')
+		p++;
+
+	if (p == tok)
+		return -1;
+
+	msg->command.ptr = tok;
+	msg->command.len = p - tok;
+
+	if (msg->command.len == 3 &&
+			(unsigned)(tok[0] - '0') < 10 &&
+			(unsigned)(tok[1] - '0') < 10 &&
+			(unsigned)(tok[2] - '0') < 10) {
+		msg->numeric = (tok[0] - '0') * 100 + (tok[1] - '0') * 10 + tok[2] - '0';
+	}
+
+	/* and finally, the parameters */
+	for (;;) {
+		while (p < end && *p == ' ')
+			p++;
+
+		if (p == end)
+			break;
+
+		tok = p;
+
+		if (*p == ':' || msg->nparams == IRCMSG_MAXPARAMS - 1) {
+			/* the last param gets the rest of the line, spaces and all */
+			if (*p == ':') {
+				tok++;
+				msg->trailing.ptr = tok;
+				msg->trailing.len = end - tok;
+			}
+
+			msg->params[msg->nparams].ptr = tok;
+			msg->params[msg->nparams].len = end - tok;
+			msg->nparams++;
+			break;
+		}
+
+		while (p < end && *p != ' ')
+			p++;
+
+		msg->params[msg->nparams].ptr = tok;
+		msg->params[msg->nparams].len = p - tok;
+		msg->nparams++;
+	}
+
+	return 0;
+}
+
+/* ircmsg_rebase : points msg's slices at a copy of the line, from to to */
+void ircmsg_rebase(ircmsg_t *msg, const char *from, char *to)
+{
+	slice_t *s[] = {
+		&msg->tags, &msg->prefix, &msg->nick, &msg->user, &msg->host,
+		&msg->command, &msg->trailing
+	};
+	int i;
+
+	for (i = 0; i < ARRSIZE(s); i++) {
+		if (s[i]->ptr)
+			s[i]->ptr = to + (s[i]->ptr - from);
+	}
+
+	for (i = 0; i < msg->nparams; i++)
+		msg->params[i].ptr = to + (msg->params[i].ptr - from);
+}
+
+/* ircmsg_is : returns true if the message's command is command */
+int ircmsg_is(ircmsg_t *msg, const char *command)
+{
+	return slice_eq(&msg->command, command);
+}
+
+/* ircmsg_tag : finds tag key, val gets its (still escaped) value */
+int ircmsg_tag(ircmsg_t *msg, const char *key, slice_t *val)
+{
+	char *p, *end, *semi, *eq;
+	int keylen;
+
+	p = msg->tags.ptr;
+	end = p + msg->tags.len;
+	keylen = strlen(key);
+
+	for (; p && p < end; p = semi + 1) {
+		if (!(semi = memchr(p, ';', end - p)))
+			semi = end;
+
+		eq = memchr(p, '=', semi - p);
+
+		if ((eq ? eq : semi) - p == keylen && memcmp(p, key, keylen) == 0) {
+			if (val) {
+				val->ptr = eq ? eq + 1 : semi;
+				val->len = eq ? semi - (eq + 1) : 0;
+			}
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* ircmsg_unescape : copies a tag value into buf, undoing IRCv3 escaping */
+int ircmsg_unescape(char *buf, int buflen, slice_t *val)
+{
+	int i, len;
+	char c;
+
+	for (i = 0, len = 0; i < val->len && len < buflen - 1; i++) {
+		c = val->ptr[i];
+
+		if (c == '\\') {
+			if (++i == val->len)
+				break; /* a trailing backslash just goes away */
+
+			switch (val->ptr[i]) {
+			case ':': c = ';'; break;
+			case 's': c = ' '; break;
+			case 'r': c = '\r'; break;
+			case 'n': c = '\n'; break;
+			default: c = val->ptr[i]; break;
+			}
+		}
+
+		buf[len++] = c;
+	}
+
+	buf[len] = '\0';
+
+	return len;
+}
+
+/* slice_eq : returns true if s holds exactly str */
+int slice_eq(slice_t *s, const char *str)
+{
+	int len;
+
+	len = strlen(str);
+
+	return s->len == len && memcmp(s->ptr, str, len) == 0;
+}
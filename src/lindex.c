@@ -0,0 +1,136 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 03:35
+ *
+ * Line Index for Text Files
+ *
+ * The file is mmap'd, and we keep an array with the offset every line
+ * starts at, so counting lines and fetching line n are both O(1). Files we
+ * index are usually being appended to (the log), so lidx_refresh only maps
+ * and scans the bytes that showed up since last time. A line isn't counted
+ * until its newline is there, same as fio_lines always did.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "lindex.h"
+
+static int lidx_grow(lidx_t *idx);
+
+/* lidx_init : sets up an index over the file fd, then builds it */
+int lidx_init(lidx_t *idx, int fd)
+{
+	memset(idx, 0, sizeof(*idx));
+
+	idx->fd = fd;
+
+	if (lidx_grow(idx) < 0)
+		return -1;
+	idx->offs[0] = 0;
+
+	return lidx_refresh(idx);
+}
+
+/* lidx_refresh : picks up anything appended since the last call */
+int lidx_refresh(lidx_t *idx)
+{
+	struct stat st;
+	char *p, *end;
+	size_t len;
+
+	if (fstat(idx->fd, &st) < 0)
+		return -1;
+
+	len = st.st_size;
+
+	if (len == idx->maplen)
+		return 0;
+
+	/* someone truncated it on us, start over */
+	if (len < idx->indexed) {
+		idx->indexed = 0;
+		idx->nlines = 0;
+	}
+
+	if (idx->map)
+		munmap(idx->map, idx->maplen);
+	idx->map = NULL;
+	idx->maplen = 0;
+
+	if (len == 0)
+		return 0;
+
+	idx->map = mmap(NULL, len, PROT_READ, MAP_SHARED, idx->fd, 0);
+	if (idx->map == MAP_FAILED) {
+		idx->map = NULL;
+		return -1;
+	}
+
+	idx->maplen = len;
+
+	/* only the new bytes need a look */
+	p = idx->map + idx->indexed;
+	end = idx->map + len;
+
+	while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+		p++;
+
+		if (idx->nlines + 1 >= idx->cap && lidx_grow(idx) < 0)
+			return -1;
+
+		idx->offs[++idx->nlines] = p - idx->map;
+		idx->indexed = p - idx->map;
+	}
+
+	return 0;
+}
+
+/* lidx_lines : returns the number of complete lines */
+int lidx_lines(lidx_t *idx)
+{
+	return idx->nlines;
+}
+
+/* lidx_getline : points line at line n, newline included, -1 if there's none */
+int lidx_getline(lidx_t *idx, int n, slice_t *line)
+{
+	if (n < 0 || n >= idx->nlines)
+		return -1;
+
+	line->ptr = idx->map + idx->offs[n];
+	line->len = idx->offs[n + 1] - idx->offs[n];
+
+	return 0;
+}
+
+/* lidx_free : unmaps the file, the descriptor still belongs to the caller */
+void lidx_free(lidx_t *idx)
+{
+	if (idx->map)
+		munmap(idx->map, idx->maplen);
+	free(idx->offs);
+	memset(idx, 0, sizeof(*idx));
+	idx->fd = -1;
+}
+
+/* lidx_grow : doubles the offset array */
+static int lidx_grow(lidx_t *idx)
+{
+	size_t *offs;
+	int cap;
+
+	cap = idx->cap ? idx->cap * 2 : 1024;
+
+	if ((offs = realloc(idx->offs, cap * sizeof(*offs))) == NULL)
+		return -1;
+
+	idx->offs = offs;
+	idx->cap = cap;
+
+	return 0;
+}
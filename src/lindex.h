@@ -0,0 +1,33 @@
+#ifndef LINDEX_H
+#define LINDEX_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 03:35
+ *
+ * Line Index for Text Files
+ */
+
+#include <stddef.h>
+
+#include "common.h"
+
+struct lidx_t {
+	int fd;
+	char *map;
+	size_t maplen;
+	size_t indexed; /* bytes scanned, always just past a newline */
+	size_t *offs;   /* offs[n] is where line n starts, offs[nlines] the end */
+	int nlines;
+	int cap;
+};
+
+typedef struct lidx_t lidx_t;
+
+int lidx_init(lidx_t *idx, int fd);
+int lidx_refresh(lidx_t *idx);
+int lidx_lines(lidx_t *idx);
+int lidx_getline(lidx_t *idx, int n, slice_t *line);
+void lidx_free(lidx_t *idx);
+
+#endif
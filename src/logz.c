@@ -0,0 +1,510 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 14:10
+ *
+ * Compressed Chat Logs
+ *
+ * Once a day's chat log is done with, it gets gzip'd in the background, as
+ * a string of gzip members of about LZ_FRAME bytes each, cut on line ends.
+ * A file of members is still just a .gz to zcat, but each member inflates
+ * on its own, so with the frame index next to it (the .log.idx, where each
+ * frame starts in both files, and the first and last time in it) a reader
+ * can go straight to the part of the day it wants and inflate only that.
+ *
+ * Files get here two ways: chatlog queues a day's file as soon as it's
+ * rotated away from, and every LZ_SWEEP_MS (and once at startup) the whole
+ * log directory is swept for older days nobody's queued, say because the
+ * bot was down over midnight. The compressor is its own thread, niced, and
+ * it stops between frames when we're shutting down, leaving whatever's
+ * left for the next sweep.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
+#include <ftw.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <zlib.h>
+
+#include "logz.h"
+#include "metrics.h"
+#include "fio.h"
+
+struct lz_job_t {
+	struct lz_job_t *next;
+	char path[];
+};
+
+static char lzdir[PATH_MAX];
+static pthread_mutex_t lzlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t lzwake = PTHREAD_COND_INITIALIZER;
+static struct lz_job_t *jobs, **jobtail = &jobs;
+static int running;
+static _Atomic int stopping;
+static pthread_t compressor;
+static char today[32]; /* the sweep's idea of today's file name */
+
+static void *lz_thread(void *arg);
+static void lz_sweep(void);
+static int lz_sweepone(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw);
+static int lz_stamp(const char *p, const char *end);
+static int lz_writeall(int fd, const void *buf, size_t len);
+
+/* lz_start : starts compressing old chat logs under dir, in the background */
+int lz_start(const char *dir)
+{
+	sigset_t all, old;
+	int rc;
+
+	if (running)
+		return 0;
+
+	snprintf(lzdir, sizeof(lzdir), "%s", dir);
+	stopping = 0;
+
+	/* signals belong to the main thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	rc = pthread_create(&compressor, NULL, lz_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (rc != 0)
+		return -1;
+
+	running = 1;
+
+	return 0;
+}
+
+/* lz_queue : compresses the .log at path, soon, it mustn't be written to again */
+void lz_queue(const char *path)
+{
+	struct lz_job_t *job;
+
+	if (!running || !(job = malloc(sizeof(*job) + strlen(path) + 1)))
+		return;
+
+	strcpy(job->path, path);
+	job->next = NULL;
+
+	pthread_mutex_lock(&lzlock);
+	*jobtail = job;
+	jobtail = &job->next;
+	pthread_cond_signal(&lzwake);
+	pthread_mutex_unlock(&lzlock);
+}
+
+/* lz_stop : stops the compressor, what's not done yet waits for next time */
+void lz_stop(void)
+{
+	struct lz_job_t *job;
+
+	if (!running)
+		return;
+
+	pthread_mutex_lock(&lzlock);
+	stopping = 1;
+	pthread_cond_signal(&lzwake);
+	pthread_mutex_unlock(&lzlock);
+
+	pthread_join(compressor, NULL);
+	running = 0;
+
+	while ((job = jobs)) {
+		jobs = job->next;
+		free(job);
+	}
+	jobtail = &jobs;
+}
+
+/* lz_thread : the compressor, queued files first, and a sweep now and then */
+static void *lz_thread(void *arg)
+{
+	struct lz_job_t *job;
+	struct timespec ts;
+	int rc;
+
+	/* a nice of 10, for just this thread, it's never in a hurry */
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+
+	lz_sweep();
+
+	pthread_mutex_lock(&lzlock);
+
+	while (!stopping) {
+		if ((job = jobs)) {
+			if (!(jobs = job->next))
+				jobtail = &jobs;
+			pthread_mutex_unlock(&lzlock);
+
+			lz_compress(job->path);
+			free(job);
+
+			pthread_mutex_lock(&lzlock);
+			continue;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += LZ_SWEEP_MS / 1000;
+
+		rc = pthread_cond_timedwait(&lzwake, &lzlock, &ts);
+
+		if (rc == ETIMEDOUT && !stopping) {
+			pthread_mutex_unlock(&lzlock);
+			lz_sweep();
+			pthread_mutex_lock(&lzlock);
+		}
+	}
+
+	pthread_mutex_unlock(&lzlock);
+
+	return NULL;
+}
+
+/* lz_sweep : compresses every day's .log under lzdir that's before today */
+static void lz_sweep(void)
+{
+	struct tm tm;
+	time_t now;
+
+	now = time(NULL);
+	localtime_r(&now, &tm);
+	strftime(today, sizeof(today), "%Y-%m-%d.log", &tm);
+
+	nftw(lzdir, lz_sweepone, 16, FTW_PHYS);
+}
+
+/* lz_sweepone : nftw's callback, compresses path if it's an old day's log */
+static int lz_sweepone(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	const char *name;
+
+	if (stopping)
+		return 1;
+
+	name = path + ftw->base;
+
+	/* YYYY-MM-DD.log, it sorts like a date */
+	if (flag != FTW_F || strlen(name) != 14 || strcmp(name + 10, ".log") != 0)
+		return 0;
+
+	/* anything written to lately could still be open in chatlog */
+	if (strcmp(name, today) < 0 && st->st_mtime < time(NULL) - LZ_QUIET)
+		lz_compress(path);
+
+	return 0;
+}
+
+/*
+ * lz_compress : turns path into path.gz and its frame index, path.idx, and
+ * removes it. Both are written under temporary names and renamed, so a
+ * crash or a stop halfway leaves the .log as it was.
+ */
+int lz_compress(const char *path)
+{
+	char gzpath[PATH_MAX], idxpath[PATH_MAX], tmpgz[PATH_MAX], tmpidx[PATH_MAX];
+	char hdr[16];
+	lz_frame_t *frames, *f;
+	z_stream zs;
+	struct stat st;
+	unsigned char *zbuf;
+	char *raw, *p, *end, *cut, *nl;
+	uint64_t off, zoff;
+	int in, gz, idx, nframes, cap, rc, last, t;
+
+	if (snprintf(tmpidx, sizeof(tmpidx), "%s.idx.tmp", path) >= sizeof(tmpidx))
+		return -1;
+	snprintf(gzpath, sizeof(gzpath), "%s.gz", path);
+	snprintf(idxpath, sizeof(idxpath), "%s.idx", path);
+	snprintf(tmpgz, sizeof(tmpgz), "%s.gz.tmp", path);
+
+	if ((in = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		/* someone (the last sweep) got to it first */
+		if (errno != ENOENT)
+			FIO_PRINTF(FIO_WRN, "Couldn't Open %s : %s", path, strerror(errno));
+		return -1;
+	}
+
+	if (fstat(in, &st) < 0) {
+		close(in);
+		return -1;
+	}
+
+	if (st.st_size == 0) {
+		close(in);
+		unlink(path);
+		return 0;
+	}
+
+	raw = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, in, 0);
+	close(in);
+
+	if (raw == MAP_FAILED)
+		return -1;
+
+	madvise(raw, st.st_size, MADV_SEQUENTIAL);
+
+	rc = -1;
+	gz = idx = -1;
+	frames = NULL;
+	zbuf = NULL;
+	memset(&zs, 0, sizeof(zs));
+
+	/* 15 + 16 is a gzip wrapper, instead of zlib's */
+	if (deflateInit2(&zs, LZ_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		goto out;
+
+	cap = st.st_size / LZ_FRAME + 2;
+	frames = malloc(cap * sizeof(*frames));
+	zbuf = malloc(deflateBound(&zs, LZ_FRAME + 1));
+	gz = open(tmpgz, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	idx = open(tmpidx, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (!frames || !zbuf || gz < 0 || idx < 0)
+		goto out;
+
+	end = raw + st.st_size;
+	last = -1;
+
+	for (off = 0, zoff = 0, nframes = 0; off < st.st_size; nframes++) {
+		if (stopping)
+			goto out;
+
+		/* only a day of very long lines gets more frames than we guessed */
+		if (nframes == cap) {
+			if (!(f = realloc(frames, cap * 2 * sizeof(*frames))))
+				goto out;
+			frames = f;
+			cap *= 2;
+		}
+
+		/* cut after the last whole line that fits, or mid line if none do */
+		p = raw + off;
+		cut = end - p > LZ_FRAME ? p + LZ_FRAME : end;
+		if (cut < end) {
+			while (cut > p && cut[-1] != '\n')
+				cut--;
+			if (cut == p)
+				cut = p + LZ_FRAME;
+		}
+
+		f = &frames[nframes];
+		f->rawoff = off;
+		f->rawlen = cut - p;
+		f->zoff = zoff;
+
+		/* lines without a stamp (a cut one) get the time before them */
+		if ((f->first = lz_stamp(p, cut)) < 0)
+			f->first = last;
+		for (last = f->first; p < cut; p = nl ? nl + 1 : cut) {
+			if ((t = lz_stamp(p, cut)) >= 0)
+				last = t;
+			nl = memchr(p, '\n', cut - p);
+		}
+		f->last = last;
+
+		zs.next_in = (unsigned char *)raw + off;
+		zs.avail_in = f->rawlen;
+		zs.next_out = zbuf;
+		zs.avail_out = deflateBound(&zs, LZ_FRAME + 1);
+
+		if (deflate(&zs, Z_FINISH) != Z_STREAM_END || deflateReset(&zs) != Z_OK)
+			goto out;
+
+		f->zlen = zs.next_out - zbuf;
+
+		if (lz_writeall(gz, zbuf, f->zlen) < 0)
+			goto out;
+
+		off += f->rawlen;
+		zoff += f->zlen;
+	}
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, LZ_MAGIC, sizeof(LZ_MAGIC));
+	memcpy(hdr + 8, &nframes, sizeof(nframes));
+
+	if (lz_writeall(idx, hdr, sizeof(hdr)) < 0 ||
+			lz_writeall(idx, frames, nframes * sizeof(*frames)) < 0)
+		goto out;
+
+	/* on disk before the .log goes, the index before what it indexes */
+	if (fdatasync(gz) < 0 || fdatasync(idx) < 0 ||
+			rename(tmpidx, idxpath) < 0 || rename(tmpgz, gzpath) < 0)
+		goto out;
+
+	unlink(path);
+
+	met_inc(MET_LOGZ_FILES);
+	met_add(MET_LOGZ_RAW_BYTES, st.st_size);
+	met_add(MET_LOGZ_BYTES, zoff);
+
+	FIO_PRINTF(FIO_VER, "Compressed %s, %lld to %llu Bytes in %d Frames", path,
+			(long long)st.st_size, (unsigned long long)zoff, nframes);
+
+	rc = 0;
+
+out:
+	if (rc < 0 && !stopping)
+		FIO_PRINTF(FIO_WRN, "Couldn't Compress %s", path);
+	if (rc < 0) {
+		unlink(tmpgz);
+		unlink(tmpidx);
+	}
+	if (gz >= 0)
+		close(gz);
+	if (idx >= 0)
+		close(idx);
+	deflateEnd(&zs);
+	free(frames);
+	free(zbuf);
+	munmap(raw, st.st_size);
+
+	return rc;
+}
+
+/* lz_loadindex : reads the frame index of path (the .log's name), or -1 */
+int lz_loadindex(const char *path, lz_index_t *ix)
+{
+	char idxpath[PATH_MAX];
+	char hdr[16];
+	struct stat st;
+	int fd, n;
+
+	memset(ix, 0, sizeof(*ix));
+
+	snprintf(idxpath, sizeof(idxpath), "%s.idx", path);
+
+	if ((fd = open(idxpath, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || read(fd, hdr, sizeof(hdr)) != sizeof(hdr) ||
+			memcmp(hdr, LZ_MAGIC, sizeof(LZ_MAGIC)) != 0)
+		goto err;
+
+	memcpy(&n, hdr + 8, sizeof(n));
+	if (n < 0 || st.st_size != sizeof(hdr) + (off_t)n * sizeof(lz_frame_t))
+		goto err;
+
+	if (n > 0 && !(ix->frames = malloc(n * sizeof(lz_frame_t))))
+		goto err;
+
+	if (read(fd, ix->frames, n * sizeof(lz_frame_t)) != n * sizeof(lz_frame_t))
+		goto err;
+
+	ix->nframes = n;
+	close(fd);
+
+	return 0;
+
+err:
+	free(ix->frames);
+	ix->frames = NULL;
+	close(fd);
+	return -1;
+}
+
+/* lz_freeindex : frees the frame list */
+void lz_freeindex(lz_index_t *ix)
+{
+	free(ix->frames);
+	ix->frames = NULL;
+	ix->nframes = 0;
+}
+
+/* lz_find : the first frame with anything at or after sec, nframes if none */
+int lz_find(lz_index_t *ix, int sec)
+{
+	int lo, hi, mid;
+
+	for (lo = 0, hi = ix->nframes; lo < hi;) {
+		mid = lo + (hi - lo) / 2;
+		if (ix->frames[mid].last < sec)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* lz_readframe : inflates frame f of the .log.gz open on fd, into rawlen bytes of out */
+int lz_readframe(int fd, lz_frame_t *f, char *out)
+{
+	z_stream zs;
+	unsigned char *zbuf;
+	int rc;
+
+	if (!(zbuf = malloc(f->zlen)))
+		return -1;
+
+	if (pread(fd, zbuf, f->zlen, f->zoff) != f->zlen) {
+		free(zbuf);
+		return -1;
+	}
+
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit2(&zs, 15 + 16) != Z_OK) {
+		free(zbuf);
+		return -1;
+	}
+
+	zs.next_in = zbuf;
+	zs.avail_in = f->zlen;
+	zs.next_out = (unsigned char *)out;
+	zs.avail_out = f->rawlen;
+
+	rc = inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.avail_out == 0 ?
+		(int)f->rawlen : -1;
+
+	inflateEnd(&zs);
+	free(zbuf);
+
+	return rc;
+}
+
+/* lz_stamp : seconds into the day, from a line's "[HH:MM:SS]", or -1 */
+static int lz_stamp(const char *p, const char *end)
+{
+	if (end - p < 10 || p[0] != '[' || p[3] != ':' || p[6] != ':' || p[9] != ']')
+		return -1;
+
+	return ((p[1] - '0') * 10 + p[2] - '0') * 3600 +
+		((p[4] - '0') * 10 + p[5] - '0') * 60 +
+		(p[7] - '0') * 10 + p[8] - '0';
+}
+
+/* lz_writeall : write(), all of it, or -1 */
+static int lz_writeall(int fd, const void *buf, size_t len)
+{
+	const char *p;
+	ssize_t n;
+
+	for (p = buf; len > 0; p += n, len -= n) {
+		if ((n = write(fd, p, len)) < 0) {
+			if (errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef LOGZ_H
+#define LOGZ_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 14:10
+ *
+ * Compressed Chat Logs
+ */
+
+#include <stdint.h>
+
+#define LZ_FRAME    (64 << 10) /* uncompressed bytes per frame, about */
+#define LZ_LEVEL    6
+#define LZ_MAGIC    "BIRCLZ1"
+#define LZ_QUIET    60         /* seconds a file's untouched before a sweep takes it */
+#define LZ_SWEEP_MS 3600000    /* how often the log directory gets swept */
+
+/* one independently inflatable gzip member of a .log.gz */
+struct lz_frame_t {
+	uint64_t rawoff; /* where it starts in the original .log */
+	uint64_t zoff;   /* and in the .log.gz */
+	uint32_t rawlen;
+	uint32_t zlen;
+	int32_t first;   /* seconds into the day of its first line, and its last */
+	int32_t last;
+};
+
+/* a .log.idx, the frame list in order */
+struct lz_index_t {
+	int nframes;
+	struct lz_frame_t *frames;
+};
+
+typedef struct lz_frame_t lz_frame_t;
+typedef struct lz_index_t lz_index_t;
+
+int lz_start(const char *dir);
+void lz_queue(const char *path);
+void lz_stop(void);
+
+int lz_compress(const char *path);
+int lz_loadindex(const char *path, lz_index_t *ix);
+void lz_freeindex(lz_index_t *ix);
+int lz_find(lz_index_t *ix, int sec);
+int lz_readframe(int fd, lz_frame_t *f, char *out);
+
+#endif
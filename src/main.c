@@ -6,6 +6,30 @@
  *
  * TODO (Brian)
  * Static C Source Inclusion, for programmable modules
+ *
+ * USAGE: birc [-P] [-v levels] [-a admin] [-m file] [-l dir] [-s ms]
+ *             [-L ms] [nick@host:port/#channel ...]
+ *
+ * Every argument is one bot identity, all of them get driven by the same
+ * event loop. With no arguments we just do the testbot on freenode.
+ *
+ * -P turns off the flood pacer, only for servers that won't mind (the
+ * benchmark's fake ircd).
+ *
+ * -v picks what gets logged, as a comma separated list of a level for every
+ * subsystem and subsystem=level pairs, "wrn,irc=ver" say. A level turns on
+ * itself and everything more severe: ver, log, msg, wrn, err.
+ *
+ * -a adds an admin, as nick!user@host or a bare nick, and can be given more
+ * than once. -m is where the metrics get written for node_exporter's
+ * textfile collector, metrics.prom by default.
+ *
+ * -l is where the chat logs go, a file per network, channel and day under
+ * it, ./logs by default. -s fdatasync()s them every that many ms, by default
+ * they're left to the kernel.
+ *
+ * -L is how long a PING to the server can go unanswered before we reconnect,
+ * 30000 ms by default, 0 to only give up after minutes of silence.
  */
 
 #include <stdio.h>
@@ -19,13 +43,31 @@
 #include <errno.h>
 
 #include "irc.h"
+#include "botcmd.h"
 #include "fio.h"
+#include "event.h"
+#include "pool.h"
+#include "metrics.h"
+#include "chatlog.h"
+#include "common.h"
 
 #define MAXMODS 16
 #define DEFAULTMODDIR "./mod"
 
+#define DEFAULTCONN "brimonk_testbot@irc.freenode.org:6667/#testingbot"
+
+struct botconn_t {
+	char nick[128];
+	char host[256];
+	char port[16];
+	char channel[256];
+	irc_t irc;
+};
+
 int run;
 
+static int parse_conn(struct botconn_t *conn, char *spec);
+
 void sighandler(int signal)
 {
 	run = 0;
@@ -34,40 +76,187 @@ void sighandler(int signal)
 int main(int argc, char **argv)
 {
 	FILE *fp;
-	irc_t irc;
+	ev_t ev;
+	pool_t pool;
+	struct botconn_t *conns;
+	uint64_t now, nextcheck, nextdump;
+	char *metfile, *logdir;
+	int nconns, alive, nopace, syncms, lagms, i;
 
 	fp = fopen("log.txt", "a");
 
 	fio_setfp(fp);
 	run = 1;
 
-	if (irc_connect(&irc, "irc.freenode.org", "6667") < 0) {
-		fprintf(stderr, "Connection failed.\n");
-		goto exit_err;
+	if (irc_bot_banter_init(BANTER_FILE) < 0) {
+		fprintf(stderr, "Couldn't load the banter rules.\n");
+		return 1;
+	}
+
+	signal(SIGINT, sighandler);
+	signal(SIGTERM, sighandler);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* options come before the identities */
+	metfile = MET_FILE;
+	logdir = CL_DIR;
+	syncms = 0;
+	lagms = IRC_LAG_MS;
+	for (nopace = 0; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+		if (strcmp(argv[1], "-P") == 0) {
+			nopace = 1;
+		} else if (strcmp(argv[1], "-v") == 0 && argc > 2 &&
+				fio_setlevels(argv[2]) == 0) {
+			argc--, argv++;
+		} else if (strcmp(argv[1], "-a") == 0 && argc > 2 &&
+				irc_bot_admin_add(argv[2]) == 0) {
+			argc--, argv++;
+		} else if (strcmp(argv[1], "-m") == 0 && argc > 2) {
+			metfile = argv[2];
+			argc--, argv++;
+		} else if (strcmp(argv[1], "-l") == 0 && argc > 2) {
+			logdir = argv[2];
+			argc--, argv++;
+		} else if (strcmp(argv[1], "-s") == 0 && argc > 2 &&
+				(syncms = atoi(argv[2])) >= 0) {
+			argc--, argv++;
+		} else if (strcmp(argv[1], "-L") == 0 && argc > 2 &&
+				(lagms = atoi(argv[2])) >= 0) {
+			argc--, argv++;
+		} else {
+			fprintf(stderr, "USAGE: birc [-P] [-v levels] [-a admin] [-m file] "
+					"[-l dir] [-s ms] [-L ms] "
+					"[nick@host:port/#channel ...]\n");
+			return 1;
+		}
 	}
 
-	if (irc_login(&irc, "brimonk_testbot") < 0) {
-		fprintf(stderr, "Couldn't log in.\n");
+	nconns = argc > 1 ? argc - 1 : 1;
+	conns = calloc(nconns, sizeof(*conns));
+
+	if (!conns || ev_init(&ev) < 0) {
+		fprintf(stderr, "Couldn't setup the event loop.\n");
+		return 1;
+	}
+
+	if (cl_open(logdir, syncms) < 0) {
+		fprintf(stderr, "Couldn't start the chat log writer.\n");
 		goto exit_err;
 	}
 
-	if (irc_join_channel(&irc, "#testingbot") < 0) {
-		fprintf(stderr, "Couldn't join channel.\n");
+	for (i = 0; i < nconns; i++) {
+		if (parse_conn(&conns[i], argc > 1 ? argv[i + 1] : DEFAULTCONN) < 0) {
+			fprintf(stderr, "Bad connection \"%s\", want %s\n",
+					argv[i + 1], "nick@host:port/#channel");
+			goto exit_err;
+		}
+
+		if (nopace)
+			sq_setpace(&conns[i].irc.sq, 0, 0);
+		conns[i].irc.lag_ms = lagms;
+	}
+
+	/* bot commands run here, so a slow one doesn't hold up a PONG */
+	if (pool_init(&pool, POOL_WORKERS) < 0) {
+		fprintf(stderr, "Couldn't start the command workers.\n");
 		goto exit_err;
 	}
 
-	while (irc_handle_data(&irc) >= 0 && run);
+	/*
+	 * bring every identity up, the nick and channel get remembered, and sent
+	 * once the connection's there (and again after every reconnect)
+	 */
+	for (i = 0, alive = 0; i < nconns; i++) {
+		if (irc_attach(&conns[i].irc, &ev, &pool) < 0) {
+			fprintf(stderr, "Couldn't watch %s.\n", conns[i].host);
+			irc_close(&conns[i].irc);
+			continue;
+		}
+
+		irc_login(&conns[i].irc, conns[i].nick);
+		irc_join_channel(&conns[i].irc, conns[i].channel);
+
+		if (irc_connect(&conns[i].irc, conns[i].host, conns[i].port) < 0) {
+			fprintf(stderr, "Connection to %s failed.\n", conns[i].host);
+			irc_close(&conns[i].irc);
+			continue;
+		}
+
+		alive++;
+	}
+
+	nextcheck = now_ms() + IRC_TICK;
+	nextdump = now_ms() + MET_DUMP_MS;
+
+	while (run && alive > 0) {
+		if (ev_wait(&ev, IRC_TICK) < 0)
+			break;
+
+		/* paced output and timeouts only need a sweep every tick */
+		now = now_ms();
+		if (now < nextcheck)
+			continue;
+
+		for (i = 0, alive = 0; i < nconns; i++) {
+			if (irc_tick(&conns[i].irc, now) == 0)
+				alive++;
+		}
+
+		nextcheck = now + IRC_TICK;
+
+		if (now >= nextdump) {
+			if (met_dump(metfile) < 0)
+				FIO_PRINTF(FIO_WRN, "Couldn't Write Metrics to %s", metfile);
+			nextdump = now + MET_DUMP_MS;
+		}
+	}
 
 	/* print quitting message */
 
-	irc_close(&irc);
+	/* let the commands in flight finish before their connections go away */
+	pool_free(&pool);
+
+	for (i = 0; i < nconns; i++)
+		irc_close(&conns[i].irc);
+	ev_free(&ev);
+	free(conns);
+	cl_close();
 	fio_closefp();
+	met_dump(metfile);
 
 	return 0;
 
 exit_err:
-	irc_close(&irc);
+	ev_free(&ev);
+	free(conns);
+	cl_close();
 	fio_closefp();
 	return 1;
 }
 
+/* parse_conn : fills out conn from a "nick@host:port/#channel" string */
+static int parse_conn(struct botconn_t *conn, char *spec)
+{
+	char *at, *colon, *slash;
+
+	at = strchr(spec, '@');
+	slash = at ? strchr(at, '/') : NULL;
+	colon = at ? strchr(at, ':') : NULL;
+
+	if (!at || !slash || !colon || colon > slash)
+		return -1;
+
+	snprintf(conn->nick, sizeof(conn->nick), "%.*s", (int)(at - spec), spec);
+	snprintf(conn->host, sizeof(conn->host), "%.*s",
+			(int)(colon - at - 1), at + 1);
+	snprintf(conn->port, sizeof(conn->port), "%.*s",
+			(int)(slash - colon - 1), colon + 1);
+	snprintf(conn->channel, sizeof(conn->channel), "%s", slash + 1);
+
+	irc_init(&conn->irc);
+
+	if (!*conn->nick || !*conn->host || !*conn->port || !*conn->channel)
+		return -1;
+
+	return 0;
+}
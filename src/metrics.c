@@ -0,0 +1,286 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 07:40
+ *
+ * Metrics
+ *
+ * A fixed set of counters, gauges and latency histograms, cheap enough to
+ * bump on every line. Counters and histograms are sharded by thread, an
+ * update is one relaxed add to a line nobody else is writing, and reading
+ * one sums every shard. The totals are only as consistent as a relaxed
+ * read can make them, which is plenty for a dashboard.
+ *
+ * met_dump writes the lot out in the Prometheus text format, to a temp file
+ * that gets renamed over the real one, so node_exporter's textfile
+ * collector never reads half of it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "metrics.h"
+#include "common.h"
+
+struct met_desc_t {
+	char *name;
+	char *help;
+};
+
+struct met_shard_t met_shards[MET_SHARDS];
+_Atomic int64_t met_gauges[MET_GAUGES];
+
+static _Atomic int nextshard;
+static __thread struct met_shard_t *myshard;
+
+static struct met_desc_t counters[MET_COUNTERS] = {
+	[MET_RX_BYTES] = {"birc_rx_bytes_total", "Bytes read from servers."},
+	[MET_RX_LINES] = {"birc_rx_lines_total", "Lines read from servers."},
+	[MET_PARSE_ERRORS] = {"birc_parse_errors_total", "Lines that didn't parse."},
+	[MET_FRAME_OVERFLOWS] = {"birc_frame_overflows_total",
+		"Lines thrown out for being too long."},
+	[MET_TX_BYTES] = {"birc_tx_bytes_total", "Bytes written to servers."},
+	[MET_TX_WRITES] = {"birc_tx_writes_total", "Writes to servers."},
+	[MET_TX_DROPPED] = {"birc_tx_dropped_total",
+		"Lines dropped on a full send queue."},
+	[MET_COMMANDS] = {"birc_commands_total", "Messages handed to the command pool."},
+	[MET_COMMANDS_REJECTED] = {"birc_commands_rejected_total",
+		"Messages dropped on a full command pool."},
+	[MET_RATE_LIMITED] = {"birc_rate_limited_total",
+		"Answers not sent, for going over a rate limit."},
+	[MET_DNS_LOOKUPS] = {"birc_dns_lookups_total", "Name lookups."},
+	[MET_DNS_FAILURES] = {"birc_dns_failures_total", "Name lookups that failed."},
+	[MET_CONNECT_ATTEMPTS] = {"birc_connect_attempts_total",
+		"Connects started, one per address tried."},
+	[MET_CONNECT_FAILURES] = {"birc_connect_failures_total",
+		"Connect races that every address lost."},
+	[MET_RECONNECTS] = {"birc_reconnects_total", "Connections dropped and retried."},
+	[MET_LOG_RECORDS] = {"birc_log_records_total", "Log records queued."},
+	[MET_LOG_DROPPED] = {"birc_log_dropped_total",
+		"Log records dropped on a full ring."},
+	[MET_LOG_BYTES] = {"birc_log_bytes_total", "Bytes the log writer wrote."},
+	[MET_ARENA_SPILLS] = {"birc_arena_spills_total",
+		"Allocations too big for their arena, that went to the heap."},
+	[MET_CHATLOG_RECORDS] = {"birc_chatlog_records_total", "Chat lines queued."},
+	[MET_CHATLOG_DROPPED] = {"birc_chatlog_dropped_total",
+		"Chat lines dropped, the writer was too far behind."},
+	[MET_CHATLOG_BYTES] = {"birc_chatlog_bytes_total", "Bytes of chat logs written."},
+	[MET_CHATLOG_SYNCS] = {"birc_chatlog_syncs_total", "Chat log fdatasync()s."},
+	[MET_LOGZ_FILES] = {"birc_logz_files_total", "Days of chat logs compressed."},
+	[MET_LOGZ_RAW_BYTES] = {"birc_logz_raw_bytes_total",
+		"Bytes of chat logs that went into the compressor."},
+	[MET_LOGZ_BYTES] = {"birc_logz_bytes_total",
+		"Bytes of compressed chat logs that came out."},
+	[MET_SEARCH_LINES] = {"birc_search_lines_total", "Chat lines indexed."},
+	[MET_SEARCH_DROPPED] = {"birc_search_dropped_total",
+		"Chat lines left out of the index, it was too far behind."},
+	[MET_SEARCH_FLUSHES] = {"birc_search_flushes_total", "Index segments written."},
+	[MET_SEARCH_MERGES] = {"birc_search_merges_total", "Index segments merged."},
+	[MET_SEARCH_FORCED] = {"birc_search_forced_merges_total",
+		"Index merges of mixed size segments, to keep their number down."},
+	[MET_LAG_PINGS] = {"birc_lag_pings_total", "PINGs sent to time the server."},
+	[MET_LAG_DROPS] = {"birc_lag_drops_total",
+		"Connections dropped, a PING went unanswered past the lag limit."},
+	[MET_KEEPALIVE_TIMEOUTS] = {"birc_keepalive_timeouts_total",
+		"Connections dropped, the server went silent."},
+	[MET_REMINDERS] = {"birc_reminders_total", "Reminders set with !remind."},
+};
+
+static struct met_desc_t gauges[MET_GAUGES] = {
+	[MET_G_CONNECTED] = {"birc_connected", "Connections that are registered."},
+};
+
+static struct met_desc_t hists[MET_HISTS] = {
+	[MET_H_REPLY] = {"birc_reply_seconds",
+		"Time from a message arriving to its command finishing."},
+	[MET_H_CONNECT] = {"birc_connect_seconds", "Time to win a connect race."},
+	[MET_H_DNS] = {"birc_dns_seconds", "Time spent in name lookups."},
+	[MET_H_LAG] = {"birc_lag_seconds", "Round trips of our PINGs to the server."},
+};
+
+/* bucket upper bounds in microseconds, the last bucket is everything else */
+static const uint64_t bounds[MET_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+	100000, 250000, 500000, 1000000, 2500000, 5000000
+};
+
+/* met_shard : this thread's shard, picked the first time it asks */
+struct met_shard_t *met_shard(void)
+{
+	if (!myshard) {
+		myshard = &met_shards[atomic_fetch_add(&nextshard, 1) % MET_SHARDS];
+	}
+
+	return myshard;
+}
+
+/* met_observe : counts a latency of us microseconds in hist */
+void met_observe(int hist, uint64_t us)
+{
+	struct met_shard_t *s;
+	int i;
+
+	for (i = 0; i < MET_BUCKETS - 1 && us > bounds[i]; i++)
+		;
+
+	s = met_shard();
+	atomic_fetch_add_explicit(&s->buckets[hist][i], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&s->sums[hist], us, memory_order_relaxed);
+}
+
+/* met_get : the counter's total over every thread */
+uint64_t met_get(int counter)
+{
+	uint64_t n;
+	int i;
+
+	for (i = 0, n = 0; i < MET_SHARDS; i++)
+		n += atomic_load_explicit(&met_shards[i].counters[counter],
+				memory_order_relaxed);
+
+	return n;
+}
+
+/* met_gauge : the gauge's current value */
+int64_t met_gauge(int gauge)
+{
+	return atomic_load_explicit(&met_gauges[gauge], memory_order_relaxed);
+}
+
+/* met_bucket : a histogram bucket's count over every thread */
+static uint64_t met_bucket(int hist, int bucket)
+{
+	uint64_t n;
+	int i;
+
+	for (i = 0, n = 0; i < MET_SHARDS; i++)
+		n += atomic_load_explicit(&met_shards[i].buckets[hist][bucket],
+				memory_order_relaxed);
+
+	return n;
+}
+
+/* met_count : observations in hist */
+uint64_t met_count(int hist)
+{
+	uint64_t n;
+	int i;
+
+	for (i = 0, n = 0; i < MET_BUCKETS; i++)
+		n += met_bucket(hist, i);
+
+	return n;
+}
+
+/* met_quantile : upper bound of the bucket holding quantile q, 0 if empty */
+uint64_t met_quantile(int hist, double q)
+{
+	uint64_t counts[MET_BUCKETS];
+	uint64_t total, seen;
+	int i;
+
+	for (i = 0, total = 0; i < MET_BUCKETS; i++)
+		total += counts[i] = met_bucket(hist, i);
+
+	if (total == 0)
+		return 0;
+
+	for (i = 0, seen = 0; i < MET_BUCKETS - 1; i++) {
+		if ((seen += counts[i]) >= q * total)
+			return bounds[i];
+	}
+
+	return UINT64_MAX;
+}
+
+/* met_write : writes every metric to fd in the Prometheus text format */
+int met_write(int fd)
+{
+	char buf[16384];
+	uint64_t n, sum;
+	int len, i, j, k;
+
+	len = 0;
+
+#define MET_PRINTF(...) \
+	len += snprintf(buf + len, len < sizeof(buf) ? sizeof(buf) - len : 0, \
+			__VA_ARGS__)
+
+	for (i = 0; i < MET_COUNTERS; i++) {
+		MET_PRINTF("# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+				counters[i].name, counters[i].help, counters[i].name,
+				counters[i].name, (unsigned long long)met_get(i));
+	}
+
+	for (i = 0; i < MET_GAUGES; i++) {
+		MET_PRINTF("# HELP %s %s\n# TYPE %s gauge\n%s %lld\n",
+				gauges[i].name, gauges[i].help, gauges[i].name,
+				gauges[i].name, (long long)met_gauge(i));
+	}
+
+	for (i = 0; i < MET_HISTS; i++) {
+		MET_PRINTF("# HELP %s %s\n# TYPE %s histogram\n",
+				hists[i].name, hists[i].help, hists[i].name);
+
+		for (j = 0, n = 0; j < MET_BUCKETS; j++) {
+			n += met_bucket(i, j);
+
+			if (j < MET_BUCKETS - 1)
+				MET_PRINTF("%s_bucket{le=\"%g\"} %llu\n", hists[i].name,
+						bounds[j] / 1e6, (unsigned long long)n);
+			else
+				MET_PRINTF("%s_bucket{le=\"+Inf\"} %llu\n", hists[i].name,
+						(unsigned long long)n);
+		}
+
+		for (k = 0, sum = 0; k < MET_SHARDS; k++)
+			sum += atomic_load_explicit(&met_shards[k].sums[i],
+					memory_order_relaxed);
+
+		MET_PRINTF("%s_sum %g\n%s_count %llu\n", hists[i].name, sum / 1e6,
+				hists[i].name, (unsigned long long)n);
+	}
+
+#undef MET_PRINTF
+
+	if (len >= sizeof(buf)) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	for (i = 0; i < len; i += k) {
+		if ((k = write(fd, buf + i, len - i)) < 0) {
+			if (errno == EINTR) {
+				k = 0;
+				continue;
+			}
+			return -1;
+		}
+	}
+
+	return len;
+}
+
+/* met_dump : writes every metric to path, replacing it all at once */
+int met_dump(char *path)
+{
+	char tmp[4096];
+	int fd, rc;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+		return -1;
+
+	rc = met_write(fd);
+
+	if (close(fd) < 0 || rc < 0 || rename(tmp, path) < 0) {
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
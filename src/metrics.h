@@ -0,0 +1,115 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 07:40
+ *
+ * Metrics
+ */
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* counters, only ever go up */
+enum {
+	MET_RX_BYTES,
+	MET_RX_LINES,
+	MET_PARSE_ERRORS,
+	MET_FRAME_OVERFLOWS,
+	MET_TX_BYTES,
+	MET_TX_WRITES,
+	MET_TX_DROPPED,
+	MET_COMMANDS,
+	MET_COMMANDS_REJECTED,
+	MET_RATE_LIMITED,
+	MET_DNS_LOOKUPS,
+	MET_DNS_FAILURES,
+	MET_CONNECT_ATTEMPTS,
+	MET_CONNECT_FAILURES,
+	MET_RECONNECTS,
+	MET_LOG_RECORDS,
+	MET_LOG_DROPPED,
+	MET_LOG_BYTES,
+	MET_ARENA_SPILLS,
+	MET_CHATLOG_RECORDS,
+	MET_CHATLOG_DROPPED,
+	MET_CHATLOG_BYTES,
+	MET_CHATLOG_SYNCS,
+	MET_LOGZ_FILES,
+	MET_LOGZ_RAW_BYTES,
+	MET_LOGZ_BYTES,
+	MET_SEARCH_LINES,
+	MET_SEARCH_DROPPED,
+	MET_SEARCH_FLUSHES,
+	MET_SEARCH_MERGES,
+	MET_SEARCH_FORCED,
+	MET_LAG_PINGS,
+	MET_LAG_DROPS,
+	MET_KEEPALIVE_TIMEOUTS,
+	MET_REMINDERS,
+	MET_COUNTERS
+};
+
+/* gauges, go wherever */
+enum {
+	MET_G_CONNECTED,
+	MET_GAUGES
+};
+
+/* histograms, of microseconds */
+enum {
+	MET_H_REPLY,   /* a PRIVMSG coming in, to its command being done */
+	MET_H_CONNECT, /* starting the connect race, to winning it */
+	MET_H_DNS,
+	MET_H_LAG,     /* our PING to the server, to its PONG */
+	MET_HISTS
+};
+
+#define MET_SHARDS  16 /* threads past this many share their counters */
+#define MET_BUCKETS 16 /* the last one is +Inf */
+#define MET_DUMP_MS 15000
+#define MET_FILE    "metrics.prom"
+
+/*
+ * Every thread adds into its own shard, so the hot paths never fight over
+ * a cache line, and readers sum the shards up.
+ */
+struct met_shard_t {
+	_Atomic uint64_t counters[MET_COUNTERS];
+	_Atomic uint64_t buckets[MET_HISTS][MET_BUCKETS];
+	_Atomic uint64_t sums[MET_HISTS];
+} __attribute__((aligned(64)));
+
+extern struct met_shard_t met_shards[MET_SHARDS];
+extern _Atomic int64_t met_gauges[MET_GAUGES];
+
+struct met_shard_t *met_shard(void);
+void met_observe(int hist, uint64_t us);
+uint64_t met_get(int counter);
+int64_t met_gauge(int gauge);
+uint64_t met_quantile(int hist, double q);
+uint64_t met_count(int hist);
+int met_write(int fd);
+int met_dump(char *path);
+
+/* met_add : adds n to a counter, for this thread */
+static inline void met_add(int counter, uint64_t n)
+{
+	atomic_fetch_add_explicit(&met_shard()->counters[counter], n,
+			memory_order_relaxed);
+}
+
+/* met_inc : adds one to a counter */
+static inline void met_inc(int counter)
+{
+	met_add(counter, 1);
+}
+
+/* met_gauge_add : moves a gauge by delta */
+static inline void met_gauge_add(int gauge, int64_t delta)
+{
+	atomic_fetch_add_explicit(&met_gauges[gauge], delta, memory_order_relaxed);
+}
+
+#endif
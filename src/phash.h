@@ -0,0 +1,37 @@
+#ifndef PHASH_H
+#define PHASH_H
+
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 22:50
+ *
+ * Seeded string hash, shared by tools/cmdgen and the tables it generates.
+ * Both sides have to agree on this bit for bit, so don't touch it without
+ * regenerating.
+ */
+
+#include <stdint.h>
+
+/* phash : FNV-1a over s, seeded, with a murmur finalizer to spread it out */
+static inline uint32_t phash(const char *s, int len, uint32_t seed)
+{
+	uint32_t h;
+	int i;
+
+	h = 2166136261u ^ (seed * 0x9e3779b9u);
+
+	for (i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+#endif
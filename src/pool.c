@@ -0,0 +1,257 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 04:10
+ *
+ * Work Stealing Thread Pool
+ *
+ * Jobs get hashed by key onto a strand, a FIFO that only one worker drains
+ * at a time, so two jobs with the same key never run at once or out of
+ * order. Ready strands sit in a per worker deque: the owner takes them off
+ * the front, and a worker with nothing to do steals off the back of someone
+ * else's. A strand runs one job per turn, then goes back in line, so a
+ * busy key can't starve the others.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "pool.h"
+
+static void *pool_worker(void *arg);
+static void pool_push(struct pool_worker_t *w, struct pool_strand_t *s);
+static struct pool_strand_t *pool_pop(struct pool_worker_t *w, int steal);
+static void pool_run(struct pool_worker_t *w, struct pool_strand_t *s);
+
+/* pool_init : starts nworkers threads */
+int pool_init(pool_t *pool, int nworkers)
+{
+	sigset_t all, old;
+	int i;
+
+	memset(pool, 0, sizeof(*pool));
+
+	if (nworkers <= 0)
+		nworkers = POOL_WORKERS;
+
+	if ((pool->workers = calloc(nworkers, sizeof(*pool->workers))) == NULL)
+		return -1;
+
+	for (i = 0; i < POOL_STRANDS; i++)
+		pthread_mutex_init(&pool->strands[i].lock, NULL);
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+	atomic_store(&pool->running, 1);
+
+	/* workers steal from each other, so they all have to exist up front */
+	pool->nworkers = nworkers;
+	for (i = 0; i < nworkers; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].id = i;
+		pthread_mutex_init(&pool->workers[i].lock, NULL);
+	}
+
+	/* signals belong to the main thread, the workers never see them */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+
+	for (i = 0; i < nworkers; i++) {
+		if (pthread_create(&pool->workers[i].thread, NULL,
+					pool_worker, &pool->workers[i]) != 0)
+			break;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	/* nothing's been submitted, so stopping the ones we got is quick */
+	if (i < nworkers) {
+		pool->nworkers = i;
+		pool_free(pool);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* pool_submit : queues job behind everything else with the same key */
+int pool_submit(pool_t *pool, uint32_t key, pool_job_t *job)
+{
+	struct pool_strand_t *s;
+	int wake;
+
+	if (atomic_fetch_add(&pool->pending, 1) >= POOL_MAXJOBS) {
+		atomic_fetch_sub(&pool->pending, 1);
+		atomic_fetch_add(&pool->rejected, 1);
+		return -1;
+	}
+
+	s = &pool->strands[key % POOL_STRANDS];
+	job->next = NULL;
+
+	pthread_mutex_lock(&s->lock);
+
+	if (s->tail)
+		s->tail->next = job;
+	else
+		s->head = job;
+	s->tail = job;
+
+	wake = !s->scheduled;
+	s->scheduled = 1;
+
+	pthread_mutex_unlock(&s->lock);
+
+	/* a strand that's already in line will get to this on its own */
+	if (wake)
+		pool_push(&pool->workers[key % pool->nworkers], s);
+
+	return 0;
+}
+
+/* pool_free : runs everything still queued, then stops the workers */
+void pool_free(pool_t *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	atomic_store(&pool->running, 0);
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->nworkers; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	for (i = 0; i < pool->nworkers; i++)
+		pthread_mutex_destroy(&pool->workers[i].lock);
+	for (i = 0; i < POOL_STRANDS; i++)
+		pthread_mutex_destroy(&pool->strands[i].lock);
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+
+	free(pool->workers);
+	pool->workers = NULL;
+	pool->nworkers = 0;
+}
+
+/* pool_worker : a worker thread, runs strands until the pool shuts down */
+static void *pool_worker(void *arg)
+{
+	struct pool_worker_t *w, *victim;
+	struct pool_strand_t *s;
+	pool_t *pool;
+	int i;
+
+	w = arg;
+	pool = w->pool;
+
+	for (;;) {
+		s = pool_pop(w, 0);
+
+		/* nothing of our own, go looking in everyone else's */
+		for (i = 1; !s && i < pool->nworkers; i++) {
+			victim = &pool->workers[(w->id + i) % pool->nworkers];
+			if ((s = pool_pop(victim, 1)) != NULL)
+				atomic_fetch_add(&pool->stolen, 1);
+		}
+
+		if (s) {
+			pool_run(w, s);
+			continue;
+		}
+
+		/*
+		 * The submitter bumps ready then looks for sleepers, we bump
+		 * sleepers then look at ready, so one of us always sees the other.
+		 */
+		pthread_mutex_lock(&pool->lock);
+		atomic_fetch_add(&pool->sleepers, 1);
+
+		while (atomic_load(&pool->ready) == 0 && atomic_load(&pool->running))
+			pthread_cond_wait(&pool->cond, &pool->lock);
+
+		atomic_fetch_sub(&pool->sleepers, 1);
+		pthread_mutex_unlock(&pool->lock);
+
+		if (atomic_load(&pool->ready) == 0 && !atomic_load(&pool->running))
+			break;
+	}
+
+	return NULL;
+}
+
+/* pool_push : puts a ready strand on the back of w's deque */
+static void pool_push(struct pool_worker_t *w, struct pool_strand_t *s)
+{
+	pool_t *pool;
+
+	pool = w->pool;
+
+	pthread_mutex_lock(&w->lock);
+	w->deque[(w->head + w->count++) % POOL_STRANDS] = s;
+	pthread_mutex_unlock(&w->lock);
+
+	atomic_fetch_add(&pool->ready, 1);
+
+	if (atomic_load(&pool->sleepers) > 0) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_signal(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+/* pool_pop : takes a strand off the front, or the back if we're stealing */
+static struct pool_strand_t *pool_pop(struct pool_worker_t *w, int steal)
+{
+	struct pool_strand_t *s;
+
+	pthread_mutex_lock(&w->lock);
+
+	if (w->count == 0) {
+		pthread_mutex_unlock(&w->lock);
+		return NULL;
+	}
+
+	if (steal) {
+		s = w->deque[(w->head + w->count - 1) % POOL_STRANDS];
+	} else {
+		s = w->deque[w->head];
+		w->head = (w->head + 1) % POOL_STRANDS;
+	}
+	w->count--;
+
+	pthread_mutex_unlock(&w->lock);
+
+	atomic_fetch_sub(&w->pool->ready, 1);
+
+	return s;
+}
+
+/* pool_run : runs the first job on s, and puts s back in line if there's more */
+static void pool_run(struct pool_worker_t *w, struct pool_strand_t *s)
+{
+	pool_job_t *job;
+	int more;
+
+	pthread_mutex_lock(&s->lock);
+	job = s->head;
+	s->head = job->next;
+	if (!s->head)
+		s->tail = NULL;
+	pthread_mutex_unlock(&s->lock);
+
+	job->func(job);
+
+	atomic_fetch_sub(&w->pool->pending, 1);
+	atomic_fetch_add(&w->pool->ran, 1);
+
+	pthread_mutex_lock(&s->lock);
+	more = s->head != NULL;
+	if (!more)
+		s->scheduled = 0;
+	pthread_mutex_unlock(&s->lock);
+
+	if (more)
+		pool_push(w, s);
+}
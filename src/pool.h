@@ -0,0 +1,69 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 04:10
+ *
+ * Work Stealing Thread Pool
+ */
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+
+#define POOL_WORKERS 4    /* default thread count */
+#define POOL_STRANDS 256  /* ordering lanes, keys that collide share one */
+#define POOL_MAXJOBS 4096 /* queued jobs before pool_submit says no */
+
+/* embed one of these in whatever you submit, func owns it once it runs */
+struct pool_job_t {
+	void (*func)(struct pool_job_t *job);
+	struct pool_job_t *next;
+};
+
+/* jobs with the same key run one at a time, in the order they came in */
+struct pool_strand_t {
+	pthread_mutex_t lock;
+	struct pool_job_t *head;
+	struct pool_job_t *tail;
+	int scheduled; /* sitting in some worker's deque, or running */
+};
+
+struct pool_worker_t {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct pool_strand_t *deque[POOL_STRANDS]; /* a strand is only ever in one */
+	int head;
+	int count;
+	struct pool_t *pool;
+	int id;
+};
+
+struct pool_t {
+	int nworkers;
+	struct pool_worker_t *workers;
+	struct pool_strand_t strands[POOL_STRANDS];
+
+	_Atomic int ready;   /* strands sitting in deques */
+	_Atomic int pending; /* jobs submitted, not finished */
+	_Atomic int sleepers;
+	_Atomic int running;
+	pthread_mutex_t lock; /* only for sleeping */
+	pthread_cond_t cond;
+
+	/* counters */
+	_Atomic unsigned long ran;
+	_Atomic unsigned long stolen;
+	_Atomic unsigned long rejected;
+};
+
+typedef struct pool_job_t pool_job_t;
+typedef struct pool_t pool_t;
+
+int pool_init(pool_t *pool, int nworkers);
+int pool_submit(pool_t *pool, uint32_t key, pool_job_t *job);
+void pool_free(pool_t *pool);
+
+#endif
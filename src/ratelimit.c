@@ -0,0 +1,266 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 11:20
+ *
+ * Rate Limiting
+ *
+ * Token buckets, kept the GCRA way: a bucket is just the time it'll be full
+ * again (its "theoretical arrival time"), so refilling is arithmetic on the
+ * next request, and there's nothing to wake up for. A request fits if the
+ * bucket isn't more than burst - 1 requests behind, and pushes it back
+ * per_ms more.
+ *
+ * Buckets live in one fixed open addressing table, keyed on a SipHash of
+ * whatever's being limited, under a key each table picks at random. The
+ * names come from whoever's talking to us (hosts, channels), and a hash
+ * anyone can work out offline would let them pick one that shares a
+ * victim's bucket and spend it for them. A bucket that's full again is the same as
+ * no bucket at all, so when the table fills up those get swept out, and a
+ * raid of fresh nicks can only hold as many slots as it has recent
+ * requests. If the table's still full after that, the request gets let
+ * through untracked; the other buckets it's charged to still count. The
+ * owner rl_expire()s the table now and then too, so it doesn't sit full of
+ * dead buckets (or sit there at all) between raids.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <sys/random.h>
+
+#include "ratelimit.h"
+#include "chans.h"
+
+#define RL_ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+static int rl_home(uint64_t key);
+static int rl_find(rl_t *rl, uint64_t key);
+static void rl_del(rl_t *rl, int slot);
+static void rl_sweep(rl_t *rl, uint64_t now);
+static void rl_sipround(uint64_t *v);
+
+/* rl_init : an empty table, the slots come with the first request */
+int rl_init(rl_t *rl)
+{
+	struct timespec ts;
+
+	memset(rl, 0, sizeof(*rl));
+
+	if (pthread_mutex_init(&rl->lock, NULL) != 0)
+		return -1;
+
+	/* without getrandom, something that at least changes every run */
+	if (getrandom(rl->seed, sizeof(rl->seed), 0) != sizeof(rl->seed)) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		rl->seed[0] = (uint64_t)ts.tv_sec * 1000000007ull ^ (uintptr_t)rl;
+		rl->seed[1] = (uint64_t)ts.tv_nsec << 20 ^ getpid();
+	}
+
+	return 0;
+}
+
+/* rl_free : frees the slots, rl is left empty */
+void rl_free(rl_t *rl)
+{
+	pthread_mutex_lock(&rl->lock);
+
+	free(rl->slots);
+	rl->slots = NULL;
+	rl->used = 0;
+
+	pthread_mutex_unlock(&rl->lock);
+}
+
+/*
+ * rl_allow : charges one request to each of the n buckets in keys, each with
+ * its own limit, true if they all had room. It's all or nothing, a bucket
+ * that's out doesn't cost the others anything.
+ */
+int rl_allow(rl_t *rl, const uint64_t *keys, const rl_limit_t *limits, int n,
+		uint64_t now)
+{
+	uint64_t tat[RL_KEYS];
+	int i, slot, ok;
+
+	if (n > RL_KEYS)
+		n = RL_KEYS;
+
+	pthread_mutex_lock(&rl->lock);
+
+	if (!rl->slots && !(rl->slots = calloc(RL_SLOTS, sizeof(*rl->slots)))) {
+		pthread_mutex_unlock(&rl->lock);
+		return 1;
+	}
+
+	/* make room before we look anything up, sweeping moves things */
+	if (rl->used + n > RL_SLOTS * 3 / 4)
+		rl_sweep(rl, now);
+
+	for (i = 0, ok = 1; i < n && ok; i++) {
+		slot = rl_find(rl, keys[i]);
+		tat[i] = rl->slots[slot].key && rl->slots[slot].tat > now ?
+			rl->slots[slot].tat : now;
+
+		if (tat[i] - now > (uint64_t)(limits[i].burst - 1) * limits[i].per_ms)
+			ok = 0;
+	}
+
+	if (!ok) {
+		rl->limited++;
+		pthread_mutex_unlock(&rl->lock);
+		return 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		slot = rl_find(rl, keys[i]);
+
+		if (!rl->slots[slot].key) {
+			if (rl->used >= RL_SLOTS * 3 / 4) {
+				rl->untracked++;
+				continue;
+			}
+			rl->slots[slot].key = keys[i];
+			rl->used++;
+		}
+
+		rl->slots[slot].tat = tat[i] + limits[i].per_ms;
+	}
+
+	rl->allowed++;
+
+	pthread_mutex_unlock(&rl->lock);
+
+	return 1;
+}
+
+/*
+ * rl_expire : drops the buckets that are full again, and the table too once
+ * there's nothing in it, so a raid's hosts don't stick around after it
+ */
+void rl_expire(rl_t *rl, uint64_t now)
+{
+	pthread_mutex_lock(&rl->lock);
+
+	if (rl->slots)
+		rl_sweep(rl, now);
+
+	if (rl->slots && !rl->used) {
+		free(rl->slots);
+		rl->slots = NULL;
+	}
+
+	pthread_mutex_unlock(&rl->lock);
+}
+
+/*
+ * rl_key : a bucket key for s, kind keeps users, channels, ... apart. It's
+ * SipHash-2-4 of kind and s (folded to lower case), under rl's seed.
+ */
+uint64_t rl_key(rl_t *rl, int kind, const char *s, int len)
+{
+	uint64_t v[4], m, c, h;
+	int i, n;
+
+	v[0] = rl->seed[0] ^ 0x736f6d6570736575ull;
+	v[1] = rl->seed[1] ^ 0x646f72616e646f6dull;
+	v[2] = rl->seed[0] ^ 0x6c7967656e657261ull;
+	v[3] = rl->seed[1] ^ 0x7465646279746573ull;
+
+	/* the message is kind as a little endian word, then s */
+	n = len + 8;
+
+	for (i = 0, m = 0; i < n; i++) {
+		c = i < 8 ? ((uint64_t)(uint32_t)kind >> (i * 8)) & 0xff :
+			ch_fold(s[i - 8]);
+		m |= c << (i % 8 * 8);
+
+		if (i % 8 == 7) {
+			v[3] ^= m;
+			rl_sipround(v);
+			rl_sipround(v);
+			v[0] ^= m;
+			m = 0;
+		}
+	}
+
+	/* what's left, with the length in the top byte */
+	m |= (uint64_t)(n & 0xff) << 56;
+	v[3] ^= m;
+	rl_sipround(v);
+	rl_sipround(v);
+	v[0] ^= m;
+
+	v[2] ^= 0xff;
+	for (i = 0; i < 4; i++)
+		rl_sipround(v);
+
+	h = v[0] ^ v[1] ^ v[2] ^ v[3];
+
+	/* 0's an empty slot */
+	return h ? h : 1;
+}
+
+/* rl_sipround : one SipRound over the state */
+static void rl_sipround(uint64_t *v)
+{
+	v[0] += v[1]; v[1] = RL_ROTL(v[1], 13); v[1] ^= v[0]; v[0] = RL_ROTL(v[0], 32);
+	v[2] += v[3]; v[3] = RL_ROTL(v[3], 16); v[3] ^= v[2];
+	v[0] += v[3]; v[3] = RL_ROTL(v[3], 21); v[3] ^= v[0];
+	v[2] += v[1]; v[1] = RL_ROTL(v[1], 17); v[1] ^= v[2]; v[2] = RL_ROTL(v[2], 32);
+}
+
+/* rl_home : the slot key would like to be in */
+static int rl_home(uint64_t key)
+{
+	return (int)((key * 0x9e3779b97f4a7c15ull) >> 32) & (RL_SLOTS - 1);
+}
+
+/* rl_find : key's slot, or the empty one it'd go in */
+static int rl_find(rl_t *rl, uint64_t key)
+{
+	int i;
+
+	for (i = rl_home(key); rl->slots[i].key; i = (i + 1) & (RL_SLOTS - 1)) {
+		if (rl->slots[i].key == key)
+			break;
+	}
+
+	return i;
+}
+
+/* rl_del : empties slot, and shifts the rest of its run back over it */
+static void rl_del(rl_t *rl, int slot)
+{
+	int i, j, home;
+
+	for (i = slot, j = (slot + 1) & (RL_SLOTS - 1); rl->slots[j].key;
+			j = (j + 1) & (RL_SLOTS - 1)) {
+		home = rl_home(rl->slots[j].key);
+
+		if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+			rl->slots[i] = rl->slots[j];
+			i = j;
+		}
+	}
+
+	rl->slots[i].key = 0;
+	rl->used--;
+}
+
+/* rl_sweep : drops every bucket that's full again */
+static void rl_sweep(rl_t *rl, uint64_t now)
+{
+	int i;
+
+	/* a delete can pull the next one back into i, so look at i again */
+	for (i = 0; i < RL_SLOTS; ) {
+		if (rl->slots[i].key && rl->slots[i].tat <= now) {
+			rl_del(rl, i);
+			rl->evicted++;
+		} else {
+			i++;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 11:20
+ *
+ * Rate Limiting
+ */
+
+#include <stdint.h>
+
+#include <pthread.h>
+
+#define RL_SLOTS 8192 /* buckets a table can hold, a power of two */
+#define RL_KEYS  4    /* most buckets one rl_allow can charge */
+#define RL_EXPIRE_MS 60000 /* how often the owner should rl_expire the table */
+
+/* burst requests back to back, then one more every per_ms */
+struct rl_limit_t {
+	int burst;
+	int per_ms;
+};
+
+/* a bucket, key 0 is an empty slot */
+struct rl_entry_t {
+	uint64_t key;
+	uint64_t tat; /* when the bucket's full again, nothing to keep after that */
+};
+
+struct rl_t {
+	pthread_mutex_t lock;
+	uint64_t seed[2]; /* rl_key's, random, so nobody can line up a collision */
+	struct rl_entry_t *slots; /* RL_SLOTS of them, allocated on first use */
+	int used;
+
+	/* counters */
+	unsigned long allowed;
+	unsigned long limited;
+	unsigned long evicted;
+	unsigned long untracked; /* let through because the table was full */
+};
+
+typedef struct rl_limit_t rl_limit_t;
+typedef struct rl_t rl_t;
+
+int rl_init(rl_t *rl);
+void rl_free(rl_t *rl);
+int rl_allow(rl_t *rl, const uint64_t *keys, const rl_limit_t *limits, int n,
+		uint64_t now);
+void rl_expire(rl_t *rl, uint64_t now);
+uint64_t rl_key(rl_t *rl, int kind, const char *s, int len);
+
+#endif
@@ -0,0 +1,806 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 01:20
+ *
+ * Linear Time Regular Expressions
+ *
+ * The pattern gets compiled to a Thompson NFA (Pike style instructions),
+ * and the NFA gets run as a DFA whose states are built the first time the
+ * text walks into them. The cache is bounded; when it fills up it's thrown
+ * out and rebuilt from wherever we are. Every byte of text costs either a
+ * cached table lookup or building one state, which is linear in the size of
+ * the program, so there's no input that makes this go exponential the way
+ * the old backtracking matcher could.
+ *
+ * See Russ Cox, "Regular Expression Matching Can Be Simple And Fast".
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "regex.h"
+
+enum {
+	RE_OP_CHAR,  /* consume a byte in class x */
+	RE_OP_SPLIT, /* go to both x and y */
+	RE_OP_JMP,   /* go to x */
+	RE_OP_BOL,   /* only at the start of the text */
+	RE_OP_EOL,   /* only at the end of the text */
+	RE_OP_MATCH
+};
+
+enum {
+	RE_N_EMPTY,
+	RE_N_CLASS,
+	RE_N_CAT,
+	RE_N_ALT,
+	RE_N_STAR,
+	RE_N_PLUS,
+	RE_N_QUEST,
+	RE_N_BOL,
+	RE_N_EOL
+};
+
+#define RE_DMATCH    0x01 /* a match ends somewhere in what we've read */
+#define RE_DEOLMATCH 0x02 /* and if the text ended right here, it'd match */
+
+#define RE_DHASH 1024
+
+struct re_node_t {
+	int type;
+	int l, r;
+	int cls;
+};
+
+struct re_parse_t {
+	const char *p;
+	re_t *re;
+	struct re_node_t *nodes;
+	int nnodes;
+	int capnodes;
+	int depth;
+};
+
+static int re_node(struct re_parse_t *ps, int type, int l, int r);
+static int re_newcls(struct re_parse_t *ps);
+static int re_parse_alt(struct re_parse_t *ps);
+static int re_parse_cat(struct re_parse_t *ps);
+static int re_parse_repeat(struct re_parse_t *ps);
+static int re_parse_atom(struct re_parse_t *ps);
+static int re_parse_class(struct re_parse_t *ps);
+static int re_escape(unsigned char *bits, int c);
+static void re_fold(re_t *re, unsigned char *bits);
+static int re_emit(re_t *re, int op, int x, int y);
+static int re_gen(struct re_parse_t *ps, int n);
+static void re_mkcols(re_t *re);
+
+static void re_flush(re_t *re);
+static void re_addthread(re_t *re, int pc, int bol, int eol);
+static int re_dstate(re_t *re);
+static int re_step(re_t *re, int s, int col);
+
+#define RE_BITSET(b, c) ((b)[(unsigned char)(c) >> 3] |= 1 << ((c) & 7))
+#define RE_BITTEST(b, c) ((b)[(unsigned char)(c) >> 3] & (1 << ((c) & 7)))
+
+/* re_compile : compiles pattern into re, returns -1 (and sets re->err) */
+int re_compile(re_t *re, const char *pattern, int flags)
+{
+	struct re_parse_t ps;
+	int root;
+
+	memset(re, 0, sizeof(*re));
+	re->flags = flags;
+	re->start = -1;
+
+	memset(&ps, 0, sizeof(ps));
+	ps.p = pattern;
+	ps.re = re;
+
+	if ((root = re_parse_alt(&ps)) < 0)
+		goto err;
+
+	if (*ps.p == ')') {
+		re->err = "unmatched )";
+		goto err;
+	}
+
+	if (re_gen(&ps, root) < 0 || re_emit(re, RE_OP_MATCH, 0, 0) < 0)
+		goto err;
+
+	free(ps.nodes);
+	ps.nodes = NULL;
+
+	re_mkcols(re);
+
+	/* the cache starts small and grows up to its limits as it's needed */
+	re->poolcap = 1024;
+	re->capdstates = 32;
+	re->pool = malloc(re->poolcap * sizeof(int));
+	re->dstates = malloc(re->capdstates * sizeof(*re->dstates));
+	re->buckets = malloc(RE_DHASH * sizeof(*re->buckets));
+	re->stack = malloc((re->ninst * 2 + 1) * sizeof(*re->stack));
+	re->sparse = calloc(re->ninst, sizeof(*re->sparse));
+	re->dense = malloc(re->ninst * sizeof(*re->dense));
+
+	if (!re->pool || !re->dstates || !re->buckets ||
+			!re->stack || !re->sparse || !re->dense) {
+		re->err = "out of memory";
+		goto err;
+	}
+
+	re_flush(re);
+
+	return 0;
+
+err:
+	free(ps.nodes);
+	pattern = re->err;
+	re_free(re);
+	re->err = pattern;
+	return -1;
+}
+
+/* re_exec : returns true if re matches anywhere in text */
+int re_exec(re_t *re, const char *text, int len)
+{
+	int i, s, t;
+
+	if (re->start < 0) {
+		re->ndense = 0;
+		re_addthread(re, 0, 1, 0);
+		if ((re->start = re_dstate(re)) < 0) {
+			re_flush(re);
+			re->start = re_dstate(re);
+		}
+	}
+
+	s = re->start;
+
+	for (i = 0; i < len; i++) {
+		if (re->dstates[s].flags & RE_DMATCH)
+			return 1;
+
+		t = re->pool[re->dstates[s].next + re->cols[(unsigned char)text[i]]];
+		if (t < 0)
+			t = re_step(re, s, re->cols[(unsigned char)text[i]]);
+
+		s = t;
+	}
+
+	return (re->dstates[s].flags & (RE_DMATCH | RE_DEOLMATCH)) != 0;
+}
+
+/* re_free : releases everything re_compile allocated */
+void re_free(re_t *re)
+{
+	free(re->inst);
+	free(re->cls);
+	free(re->pool);
+	free(re->dstates);
+	free(re->buckets);
+	free(re->stack);
+	free(re->sparse);
+	free(re->dense);
+
+	memset(re, 0, sizeof(*re));
+	re->start = -1;
+}
+
+/* re_node : adds an AST node, -1 if we're out of memory */
+static int re_node(struct re_parse_t *ps, int type, int l, int r)
+{
+	struct re_node_t *tmp;
+	int cap;
+
+	if (ps->nnodes == ps->capnodes) {
+		cap = ps->capnodes ? ps->capnodes * 2 : 32;
+		if (!(tmp = realloc(ps->nodes, cap * sizeof(*tmp)))) {
+			ps->re->err = "out of memory";
+			return -1;
+		}
+		ps->nodes = tmp;
+		ps->capnodes = cap;
+	}
+
+	ps->nodes[ps->nnodes].type = type;
+	ps->nodes[ps->nnodes].l = l;
+	ps->nodes[ps->nnodes].r = r;
+	ps->nodes[ps->nnodes].cls = -1;
+
+	return ps->nnodes++;
+}
+
+/* re_newcls : adds an empty byte class to the program */
+static int re_newcls(struct re_parse_t *ps)
+{
+	unsigned char (*tmp)[32];
+	re_t *re;
+
+	re = ps->re;
+
+	if (re->ncls >= RE_MAXINST) {
+		re->err = "pattern too big";
+		return -1;
+	}
+
+	if ((re->ncls & (re->ncls - 1)) == 0) { /* powers of two, grow */
+		tmp = realloc(re->cls, (re->ncls ? re->ncls * 2 : 1) * sizeof(*tmp));
+		if (!tmp) {
+			re->err = "out of memory";
+			return -1;
+		}
+		re->cls = tmp;
+	}
+
+	memset(re->cls[re->ncls], 0, sizeof(re->cls[0]));
+
+	return re->ncls++;
+}
+
+/* re_parse_alt : alt := cat ('|' cat)* */
+static int re_parse_alt(struct re_parse_t *ps)
+{
+	int l, r;
+
+	if ((l = re_parse_cat(ps)) < 0)
+		return -1;
+
+	while (*ps->p == '|') {
+		ps->p++;
+		if ((r = re_parse_cat(ps)) < 0)
+			return -1;
+		if ((l = re_node(ps, RE_N_ALT, l, r)) < 0)
+			return -1;
+	}
+
+	return l;
+}
+
+/* re_parse_cat : cat := repeat* */
+static int re_parse_cat(struct re_parse_t *ps)
+{
+	int l, r;
+
+	l = -1;
+
+	while (*ps->p && *ps->p != '|' && *ps->p != ')') {
+		if ((r = re_parse_repeat(ps)) < 0)
+			return -1;
+
+		if (l < 0) {
+			l = r;
+		} else if ((l = re_node(ps, RE_N_CAT, l, r)) < 0) {
+			return -1;
+		}
+	}
+
+	if (l < 0) /* nothing at all, "()" or "a|" */
+		l = re_node(ps, RE_N_EMPTY, -1, -1);
+
+	return l;
+}
+
+/* re_parse_repeat : repeat := atom ('*' | '+' | '?')* */
+static int re_parse_repeat(struct re_parse_t *ps)
+{
+	int n, type;
+
+	if ((n = re_parse_atom(ps)) < 0)
+		return -1;
+
+	for (;;) {
+		switch (*ps->p) {
+		case '*': type = RE_N_STAR; break;
+		case '+': type = RE_N_PLUS; break;
+		case '?': type = RE_N_QUEST; break;
+		default: return n;
+		}
+
+		ps->p++;
+
+		if ((n = re_node(ps, type, n, -1)) < 0)
+			return -1;
+	}
+}
+
+/* re_parse_atom : a literal, '.', a class, an anchor or a ( group ) */
+static int re_parse_atom(struct re_parse_t *ps)
+{
+	unsigned char *bits;
+	int n, c;
+
+	switch (*ps->p) {
+	case '(':
+		if (++ps->depth > RE_MAXDEPTH) {
+			ps->re->err = "too much nesting";
+			return -1;
+		}
+
+		ps->p++;
+		if ((n = re_parse_alt(ps)) < 0)
+			return -1;
+
+		if (*ps->p != ')') {
+			ps->re->err = "missing )";
+			return -1;
+		}
+
+		ps->p++;
+		ps->depth--;
+		return n;
+
+	case '[':
+		ps->p++;
+		return re_parse_class(ps);
+
+	case '^':
+		ps->p++;
+		return re_node(ps, RE_N_BOL, -1, -1);
+
+	case '$':
+		ps->p++;
+		return re_node(ps, RE_N_EOL, -1, -1);
+
+	case '*':
+	case '+':
+	case '?':
+		ps->re->err = "nothing to repeat";
+		return -1;
+	}
+
+	if ((n = re_node(ps, RE_N_CLASS, -1, -1)) < 0)
+		return -1;
+	if ((ps->nodes[n].cls = re_newcls(ps)) < 0)
+		return -1;
+
+	bits = ps->re->cls[ps->nodes[n].cls];
+
+	c = (unsigned char)*ps->p++;
+
+	if (c == '.') {
+		memset(bits, 0xff, 32);
+	} else if (c == '\\') {
+		if (*ps->p == '\0') {
+			ps->re->err = "trailing \\";
+			return -1;
+		}
+		re_escape(bits, (unsigned char)*ps->p++);
+	} else {
+		RE_BITSET(bits, c);
+	}
+
+	re_fold(ps->re, bits);
+
+	return n;
+}
+
+/* re_parse_class : everything after a '[' up to and including the ']' */
+static int re_parse_class(struct re_parse_t *ps)
+{
+	unsigned char *bits;
+	int n, i, neg, c, hi;
+
+	if ((n = re_node(ps, RE_N_CLASS, -1, -1)) < 0)
+		return -1;
+	if ((ps->nodes[n].cls = re_newcls(ps)) < 0)
+		return -1;
+
+	bits = ps->re->cls[ps->nodes[n].cls];
+
+	neg = 0;
+	if (*ps->p == '^') {
+		neg = 1;
+		ps->p++;
+	}
+
+	/* a ']' right at the start is just a ']' */
+	for (i = 0; *ps->p && (*ps->p != ']' || i == 0); i++) {
+		c = (unsigned char)*ps->p++;
+
+		if (c == '\\') {
+			if (*ps->p == '\0')
+				break;
+			c = (unsigned char)*ps->p++;
+			if (re_escape(bits, c)) /* \d and friends, not a range start */
+				continue;
+			switch (c) {
+			case 'n': c = '\n'; break;
+			case 't': c = '\t'; break;
+			case 'r': c = '\r'; break;
+			}
+		}
+
+		if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+			hi = (unsigned char)ps->p[1];
+			ps->p += 2;
+
+			if (hi == '\\' && *ps->p)
+				hi = (unsigned char)*ps->p++;
+
+			if (hi < c) {
+				ps->re->err = "backwards range";
+				return -1;
+			}
+
+			for (; c <= hi; c++)
+				RE_BITSET(bits, c);
+		} else {
+			RE_BITSET(bits, c);
+		}
+	}
+
+	if (*ps->p != ']') {
+		ps->re->err = "missing ]";
+		return -1;
+	}
+
+	ps->p++;
+
+	re_fold(ps->re, bits);
+
+	if (neg) {
+		for (i = 0; i < 32; i++)
+			bits[i] = ~bits[i];
+	}
+
+	return n;
+}
+
+/* re_escape : sets the bits for \c, returns true if c named a whole class */
+static int re_escape(unsigned char *bits, int c)
+{
+	unsigned char tmp[32];
+	int i, neg, rc;
+
+	memset(tmp, 0, sizeof(tmp));
+	neg = isupper(c) && strchr("DWS", c);
+	rc = 1;
+
+	for (i = 0; i < 256; i++) {
+		switch (tolower(c)) {
+		case 'd':
+			if (isdigit(i))
+				RE_BITSET(tmp, i);
+			break;
+		case 'w':
+			if (isalnum(i) || i == '_')
+				RE_BITSET(tmp, i);
+			break;
+		case 's':
+			if (isspace(i))
+				RE_BITSET(tmp, i);
+			break;
+		default:
+			rc = 0;
+			break;
+		}
+	}
+
+	if (!rc) { /* just a literal, like \. or \\ */
+		switch (c) {
+		case 'n': c = '\n'; break;
+		case 't': c = '\t'; break;
+		case 'r': c = '\r'; break;
+		}
+		RE_BITSET(bits, c);
+		return 0;
+	}
+
+	for (i = 0; i < 32; i++)
+		bits[i] |= neg ? ~tmp[i] : tmp[i];
+
+	return 1;
+}
+
+/* re_fold : with RE_ICASE, every letter in bits brings its other case too */
+static void re_fold(re_t *re, unsigned char *bits)
+{
+	int c;
+
+	if (!(re->flags & RE_ICASE))
+		return;
+
+	for (c = 'a'; c <= 'z'; c++) {
+		if (RE_BITTEST(bits, c) || RE_BITTEST(bits, toupper(c))) {
+			RE_BITSET(bits, c);
+			RE_BITSET(bits, toupper(c));
+		}
+	}
+}
+
+/* re_emit : appends an instruction, returns its pc or -1 */
+static int re_emit(re_t *re, int op, int x, int y)
+{
+	struct re_inst_t *tmp;
+
+	if (re->ninst >= RE_MAXINST) {
+		re->err = "pattern too big";
+		return -1;
+	}
+
+	if ((re->ninst & (re->ninst - 1)) == 0) {
+		tmp = realloc(re->inst, (re->ninst ? re->ninst * 2 : 1) * sizeof(*tmp));
+		if (!tmp) {
+			re->err = "out of memory";
+			return -1;
+		}
+		re->inst = tmp;
+	}
+
+	re->inst[re->ninst].op = op;
+	re->inst[re->ninst].x = x;
+	re->inst[re->ninst].y = y;
+
+	return re->ninst++;
+}
+
+/* re_gen : emits the instructions for node n */
+static int re_gen(struct re_parse_t *ps, int n)
+{
+	struct re_node_t *node;
+	re_t *re;
+	int s, j;
+
+	re = ps->re;
+	node = &ps->nodes[n];
+
+	switch (node->type) {
+	case RE_N_EMPTY:
+		return 0;
+
+	case RE_N_CLASS:
+		return re_emit(re, RE_OP_CHAR, node->cls, 0) < 0 ? -1 : 0;
+
+	case RE_N_BOL:
+		return re_emit(re, RE_OP_BOL, 0, 0) < 0 ? -1 : 0;
+
+	case RE_N_EOL:
+		return re_emit(re, RE_OP_EOL, 0, 0) < 0 ? -1 : 0;
+
+	case RE_N_CAT:
+		if (re_gen(ps, node->l) < 0)
+			return -1;
+		return re_gen(ps, ps->nodes[n].r);
+
+	case RE_N_ALT: /* split L1, L2; L1: l; jmp L3; L2: r; L3: */
+		if ((s = re_emit(re, RE_OP_SPLIT, re->ninst + 1, 0)) < 0)
+			return -1;
+		if (re_gen(ps, node->l) < 0)
+			return -1;
+		if ((j = re_emit(re, RE_OP_JMP, 0, 0)) < 0)
+			return -1;
+		re->inst[s].y = re->ninst;
+		if (re_gen(ps, ps->nodes[n].r) < 0)
+			return -1;
+		re->inst[j].x = re->ninst;
+		return 0;
+
+	case RE_N_QUEST: /* split L1, L2; L1: n; L2: */
+		if ((s = re_emit(re, RE_OP_SPLIT, re->ninst + 1, 0)) < 0)
+			return -1;
+		if (re_gen(ps, node->l) < 0)
+			return -1;
+		re->inst[s].y = re->ninst;
+		return 0;
+
+	case RE_N_STAR: /* L1: split L2, L3; L2: n; jmp L1; L3: */
+		if ((s = re_emit(re, RE_OP_SPLIT, re->ninst + 1, 0)) < 0)
+			return -1;
+		if (re_gen(ps, node->l) < 0)
+			return -1;
+		if (re_emit(re, RE_OP_JMP, s, 0) < 0)
+			return -1;
+		re->inst[s].y = re->ninst;
+		return 0;
+
+	case RE_N_PLUS: /* L1: n; split L1, L2; L2: */
+		s = re->ninst;
+		if (re_gen(ps, node->l) < 0)
+			return -1;
+		return re_emit(re, RE_OP_SPLIT, s, re->ninst + 1) < 0 ? -1 : 0;
+	}
+
+	return -1;
+}
+
+/* re_mkcols : splits the bytes into columns no class can tell apart */
+static void re_mkcols(re_t *re)
+{
+	short remap[512];
+	int i, k, n, key;
+
+	memset(re->cols, 0, sizeof(re->cols));
+	re->ncols = 1;
+
+	for (k = 0; k < re->ncls; k++) {
+		memset(remap, 0xff, sizeof(remap));
+
+		for (i = 0, n = 0; i < 256; i++) {
+			key = re->cols[i] * 2 + (RE_BITTEST(re->cls[k], i) ? 1 : 0);
+			if (remap[key] < 0)
+				remap[key] = n++;
+			re->cols[i] = remap[key];
+		}
+
+		re->ncols = n;
+	}
+
+	for (i = 255; i >= 0; i--)
+		re->colbyte[re->cols[i]] = i;
+}
+
+/* re_flush : throws out every cached DFA state */
+static void re_flush(re_t *re)
+{
+	re->ndstates = 0;
+	re->poolused = 0;
+	re->start = -1;
+	memset(re->buckets, 0xff, RE_DHASH * sizeof(*re->buckets));
+}
+
+/* re_addthread : adds pc, and everything it reaches without a byte, to the set */
+static void re_addthread(re_t *re, int pc, int bol, int eol)
+{
+	struct re_inst_t *inst;
+	int sp;
+
+	sp = 0;
+	re->stack[sp++] = pc;
+
+	while (sp > 0) {
+		pc = re->stack[--sp];
+
+		if (re->sparse[pc] < re->ndense && re->dense[re->sparse[pc]] == pc)
+			continue; /* already in the set */
+
+		re->sparse[pc] = re->ndense;
+		re->dense[re->ndense++] = pc;
+
+		inst = &re->inst[pc];
+
+		switch (inst->op) {
+		case RE_OP_JMP:
+			re->stack[sp++] = inst->x;
+			break;
+
+		case RE_OP_SPLIT:
+			re->stack[sp++] = inst->y;
+			re->stack[sp++] = inst->x;
+			break;
+
+		case RE_OP_BOL:
+			if (bol)
+				re->stack[sp++] = pc + 1;
+			break;
+
+		case RE_OP_EOL:
+			if (eol)
+				re->stack[sp++] = pc + 1;
+			break;
+		}
+	}
+}
+
+/* re_dstate : finds (or makes) the DFA state for the current set, -1 if full */
+static int re_dstate(re_t *re)
+{
+	struct re_dstate_t *d;
+	int *pcs;
+	void *tmp;
+	int i, j, n, s, op, pc;
+	uint32_t hash;
+
+	/* only the pcs that wait on something identify the state */
+	pcs = re->stack;
+	for (i = 0, n = 0; i < re->ndense; i++) {
+		op = re->inst[re->dense[i]].op;
+		if (op == RE_OP_CHAR || op == RE_OP_EOL || op == RE_OP_MATCH)
+			pcs[n++] = re->dense[i];
+	}
+
+	for (i = 1; i < n; i++) {
+		for (j = i; j > 0 && pcs[j - 1] > pcs[j]; j--) {
+			pc = pcs[j];
+			pcs[j] = pcs[j - 1];
+			pcs[j - 1] = pc;
+		}
+	}
+
+	for (i = 0, hash = 2166136261u; i < n; i++)
+		hash = (hash ^ pcs[i]) * 16777619u;
+
+	for (s = re->buckets[hash % RE_DHASH]; s >= 0; s = re->dstates[s].chain) {
+		d = &re->dstates[s];
+		if (d->hash == hash && d->npcs == n &&
+				memcmp(re->pool + d->pcs, pcs, n * sizeof(*pcs)) == 0)
+			return s;
+	}
+
+	if (re->ndstates == re->capdstates) {
+		if (re->capdstates == RE_MAXDSTATE)
+			return -1;
+		if (!(tmp = realloc(re->dstates, re->capdstates * 2 * sizeof(*d))))
+			return -1;
+		re->dstates = tmp;
+		re->capdstates *= 2;
+	}
+
+	while (re->poolused + n + re->ncols > re->poolcap) {
+		if (re->poolcap * 2 * sizeof(int) > RE_DFAMEM)
+			return -1;
+		if (!(tmp = realloc(re->pool, re->poolcap * 2 * sizeof(int))))
+			return -1;
+		re->pool = tmp;
+		re->poolcap *= 2;
+	}
+
+	s = re->ndstates++;
+	d = &re->dstates[s];
+
+	d->pcs = re->poolused;
+	d->npcs = n;
+	memcpy(re->pool + d->pcs, pcs, n * sizeof(*pcs));
+	re->poolused += n;
+
+	d->next = re->poolused;
+	memset(re->pool + d->next, 0xff, re->ncols * sizeof(int));
+	re->poolused += re->ncols;
+
+	d->hash = hash;
+	d->chain = re->buckets[hash % RE_DHASH];
+	re->buckets[hash % RE_DHASH] = s;
+
+	/* does it match now, or would it if the text stopped here? */
+	d->flags = 0;
+	re->ndense = 0;
+
+	for (i = 0; i < n; i++) {
+		op = re->inst[re->pool[d->pcs + i]].op;
+		if (op == RE_OP_MATCH)
+			d->flags |= RE_DMATCH;
+		else if (op == RE_OP_EOL)
+			re_addthread(re, re->pool[d->pcs + i], 0, 1);
+	}
+
+	for (i = 0; i < re->ndense; i++) {
+		if (re->inst[re->dense[i]].op == RE_OP_MATCH)
+			d->flags |= RE_DEOLMATCH;
+	}
+
+	return s;
+}
+
+/* re_step : builds the transition out of state s on column col */
+static int re_step(re_t *re, int s, int col)
+{
+	struct re_dstate_t *d;
+	int i, pc, t, c;
+
+	d = &re->dstates[s];
+	c = re->colbyte[col];
+	re->ndense = 0;
+
+	for (i = 0; i < d->npcs; i++) {
+		pc = re->pool[d->pcs + i];
+		if (re->inst[pc].op == RE_OP_CHAR &&
+				RE_BITTEST(re->cls[re->inst[pc].x], c))
+			re_addthread(re, pc + 1, 0, 0);
+	}
+
+	/* unanchored, a match could also start at the next byte */
+	re_addthread(re, 0, 0, 0);
+
+	if ((t = re_dstate(re)) < 0) {
+		/*
+		 * The cache is full. re_dstate only read the set, so flush and
+		 * try again. s went out with the flush, so don't link it.
+		 */
+		re_flush(re);
+		return re_dstate(re);
+	}
+
+	re->pool[re->dstates[s].next + col] = t;
+
+	return t;
+}
@@ -0,0 +1,79 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 01:20
+ *
+ * Linear Time Regular Expressions
+ *
+ * Syntax: literals, '.', [classes] and [^negated] ones with ranges, the
+ * escapes \d \w \s (and \D \W \S), ( ) grouping, '|', and the '*', '+' and
+ * '?' repeats. '^' and '$' anchor to the start and end of the text.
+ *
+ * A compiled re_t caches DFA states as it runs, so a single one isn't safe
+ * to share between threads without a lock around re_exec.
+ */
+
+#include <stdint.h>
+
+#define RE_ICASE 0x01
+
+#define RE_MAXINST   4096       /* compiled program size limit */
+#define RE_MAXDEPTH  128        /* nesting limit on ( ) */
+#define RE_DFAMEM    (1 << 20)  /* bytes of DFA cache before we flush it */
+#define RE_MAXDSTATE 4096       /* DFA states before we flush the cache */
+
+struct re_inst_t {
+	int op;
+	int x; /* jump target, or the class for RE_OP_CHAR */
+	int y; /* second target for RE_OP_SPLIT */
+};
+
+struct re_dstate_t {
+	int pcs; /* offset of the sorted NFA pc list in the pool */
+	int npcs;
+	int next; /* offset of the transitions, one per column, -1 unknown */
+	int flags;
+	uint32_t hash;
+	int chain; /* next state in the same hash bucket */
+};
+
+struct re_t {
+	int flags;
+	const char *err; /* why re_compile failed */
+
+	int ninst;
+	struct re_inst_t *inst;
+	int ncls;
+	unsigned char (*cls)[32]; /* byte bitmaps for RE_OP_CHAR */
+
+	/* bytes no instruction can tell apart share a DFA column */
+	int ncols;
+	unsigned char cols[256];
+	unsigned char colbyte[256]; /* one byte from each column */
+
+	/* the lazily built DFA */
+	int ndstates;
+	int capdstates;
+	struct re_dstate_t *dstates;
+	int *pool;
+	int poolused;
+	int poolcap;
+	int *buckets;
+	int start;
+
+	/* scratch space for building states */
+	int *stack;
+	int *sparse;
+	int *dense;
+	int ndense;
+};
+
+typedef struct re_t re_t;
+
+int re_compile(re_t *re, const char *pattern, int flags);
+int re_exec(re_t *re, const char *text, int len);
+void re_free(re_t *re);
+
+#endif
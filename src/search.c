@@ -0,0 +1,1279 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 15:40
+ *
+ * Chat Log Search
+ *
+ * An inverted index over the chat logs, built as they're written. Every
+ * line's words (and who said it) are terms, and each term has a posting
+ * list of where it was said: the time, and the line's offset in that day's
+ * file. Terms are 64 bit hashes of the word mixed with the channel, so a
+ * search in one channel never walks another's postings, can't turn them up
+ * either, and a posting doesn't need to say which channel it's in.
+ *
+ * New postings go in a hash table in memory. When that fills, or it's been
+ * SR_FLUSH_MS, it's frozen (a second one takes the new postings) and the
+ * indexer thread writes it out as a segment: the postings, grouped by term,
+ * then the terms sorted by hash. Segments are mmap'd and never change, a
+ * lookup is a binary search over the terms and the list is right there.
+ * Segments are kept in the order they were written, so the newest postings
+ * are always at the end, and whenever SR_FANIN segments next to each other
+ * are the same size class, the indexer merges them into one. Flushes cut
+ * short by a full table make small segments between big ones, so past
+ * SR_MERGESEGS the cheapest SR_FANIN in a row get merged whatever their
+ * sizes. Years of logs end up as a few dozen files, and searching them is a
+ * few binary searches each.
+ *
+ * Segment files are named for the range of flushes they cover, a merge is
+ * renamed into place before the ones it replaces are removed, and anything
+ * covered by another file on startup is left over from a crash in between.
+ * Postings still in memory at a crash are lost (not the log lines, just
+ * their place in the index).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <limits.h>
+#include <dirent.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "search.h"
+#include "logz.h"
+#include "metrics.h"
+#include "fio.h"
+#include "common.h"
+
+#define SR_MAGIC    "BIRCIX2"
+#define SR_LINETERMS 128 /* words indexed from one line */
+#define SR_MERGESEGS (SR_MAXSEGS / 2) /* past this, segments get merged anyway */
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME  0x100000001b3ull
+
+struct sr_hdr_t {
+	char magic[8];
+	uint64_t nterms;
+	uint64_t nposts;
+	uint64_t termoff;
+};
+
+/* a segment's term, its postings are posts[first] on */
+struct sr_term_t {
+	uint64_t hash;
+	uint64_t first;
+	uint64_t count;
+};
+
+struct sr_seg_t {
+	uint64_t lo; /* the flushes it covers */
+	uint64_t hi;
+	char *map;
+	size_t size;
+	struct sr_term_t *terms;
+	uint64_t nterms;
+	struct sr_post_t *posts;
+	uint64_t nposts;
+};
+
+/* the postings in memory, a table of terms, each a chain newest first */
+struct sr_slot_t {
+	uint64_t hash;
+	int32_t head;
+	uint32_t count; /* 0 is an empty slot */
+};
+
+struct sr_mpost_t {
+	struct sr_post_t p;
+	int32_t next;
+};
+
+struct sr_mem_t {
+	struct sr_slot_t *slots;
+	struct sr_mpost_t *posts;
+	int nterms;
+	int nposts;
+	uint64_t since;
+};
+
+/* one term's postings from one place, sorted oldest first */
+struct sr_list_t {
+	struct sr_post_t *posts;
+	uint64_t n;
+	int owned;
+};
+
+/* a segment on its way to disk */
+struct sr_build_t {
+	FILE *fp;
+	char tmp[PATH_MAX];
+	struct sr_term_t *terms;
+	uint64_t nterms;
+	uint64_t cap;
+	uint64_t nposts;
+};
+
+static char logdir[PATH_MAX / 2];
+static char srdir[PATH_MAX / 2];
+
+/* a query holds it shared, changing any of this takes it exclusively */
+static pthread_rwlock_t srlock = PTHREAD_RWLOCK_INITIALIZER;
+static struct sr_mem_t mems[2];
+static int cur;
+static _Atomic int frozen; /* mems[cur ^ 1] is being written */
+static struct sr_seg_t segs[SR_MAXSEGS];
+static int nsegs;
+static uint64_t nextgen;
+static char **chans;
+static int nchans;
+static int32_t *chanslots; /* id + 1, 0 is empty */
+static FILE *chanfp;
+
+static pthread_mutex_t wlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wwake = PTHREAD_COND_INITIALIZER;
+static int pending, stopping, running;
+static pthread_t indexer;
+
+static void *sr_thread(void *arg);
+static void sr_freeze(void);
+static void sr_flush(void);
+static int sr_merge(void);
+static int sr_pick(int *forced);
+static int sr_level(struct sr_seg_t *s);
+static int sr_buildopen(struct sr_build_t *b, const char *path);
+static int sr_buildterm(struct sr_build_t *b, uint64_t hash,
+		struct sr_post_t *posts, uint64_t n);
+static int sr_buildclose(struct sr_build_t *b, const char *path, int ok);
+static int sr_segload(struct sr_seg_t *s, uint64_t lo, uint64_t hi);
+static void sr_segpath(char *buf, int len, uint64_t lo, uint64_t hi);
+static int sr_loadsegs(void);
+static int sr_loadchans(void);
+static int sr_chanslot(const char *key);
+static int sr_findchan(const char *key);
+static int sr_memalloc(struct sr_mem_t *m);
+static int sr_memslot(struct sr_mem_t *m, uint64_t hash);
+static void sr_memlist(struct sr_mem_t *m, uint64_t hash, struct sr_list_t *l);
+static void sr_seglist(struct sr_seg_t *s, uint64_t hash, struct sr_list_t *l);
+static void sr_list(int src, uint64_t hash, struct sr_list_t *l);
+static int sr_intersect(struct sr_list_t *lists, int n, int chan,
+		sr_hit_t *hits, int max);
+static int sr_contains(struct sr_list_t *l, struct sr_post_t *p);
+static int sr_keycmp(const void *a, const void *b);
+static int sr_slotcmp(const void *a, const void *b);
+static int sr_words(const char *s, int len, uint64_t *hashes, int max);
+static uint64_t sr_nickterm(const char *nick, int len);
+static uint64_t sr_mix(uint64_t hash, int chan);
+
+/* sr_open : opens (or starts) the index of the chat logs under logdir */
+int sr_open(const char *dir)
+{
+	sigset_t all, old;
+	char path[PATH_MAX];
+	int rc;
+
+	if (running)
+		return 0;
+
+	snprintf(logdir, sizeof(logdir), "%s", dir);
+	snprintf(srdir, sizeof(srdir), "%s/%s", dir, SR_DIR);
+
+	if (mkdir(srdir, 0755) < 0 && errno != EEXIST) {
+		FIO_PRINTF(FIO_WRN, "Couldn't Make %s : %s", srdir, strerror(errno));
+		return -1;
+	}
+
+	chanslots = calloc(SR_CHANSLOTS, sizeof(*chanslots));
+	chans = calloc(SR_CHANSLOTS / 2, sizeof(*chans));
+	snprintf(path, sizeof(path), "%s/chans", srdir);
+
+	if (!chanslots || !chans || sr_loadchans() < 0 ||
+			!(chanfp = fopen(path, "a")) || sr_loadsegs() < 0)
+		goto err;
+
+	stopping = pending = 0;
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	rc = pthread_create(&indexer, NULL, sr_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (rc != 0)
+		goto err;
+
+	running = 1;
+
+	return 0;
+
+err:
+	FIO_PRINTF(FIO_WRN, "Couldn't Open the Chat Log Index in %s", srdir);
+	sr_close();
+	return -1;
+}
+
+/*
+ * sr_close : writes out what's still in memory and closes the index, the
+ * chat log writer has to be done by now
+ */
+void sr_close(void)
+{
+	int i;
+
+	if (running) {
+		pthread_mutex_lock(&wlock);
+		stopping = 1;
+		pthread_cond_signal(&wwake);
+		pthread_mutex_unlock(&wlock);
+
+		pthread_join(indexer, NULL);
+		running = 0;
+	}
+
+	for (i = 0; i < nsegs; i++)
+		munmap(segs[i].map, segs[i].size);
+	nsegs = 0;
+
+	for (i = 0; i < 2; i++) {
+		free(mems[i].slots);
+		free(mems[i].posts);
+		memset(&mems[i], 0, sizeof(mems[i]));
+	}
+
+	for (i = 0; i < nchans; i++)
+		free(chans[i]);
+	free(chans);
+	free(chanslots);
+	chans = NULL;
+	chanslots = NULL;
+	nchans = 0;
+
+	if (chanfp)
+		fclose(chanfp);
+	chanfp = NULL;
+}
+
+/* sr_chan : the id of a channel, by its chat log key (net/#chan), or -1 */
+int sr_chan(const char *key)
+{
+	int slot, id;
+
+	if (!running)
+		return -1;
+
+	pthread_rwlock_wrlock(&srlock);
+
+	slot = sr_chanslot(key);
+
+	if ((id = chanslots[slot] - 1) < 0 && nchans < SR_CHANSLOTS / 2 &&
+			(chans[nchans] = strdup(key))) {
+		id = nchans++;
+		chanslots[slot] = id + 1;
+		fprintf(chanfp, "%s\n", key);
+		fflush(chanfp);
+	}
+
+	pthread_rwlock_unlock(&srlock);
+
+	return id;
+}
+
+/*
+ * sr_add : indexes the line nick said in chan, that's at off in when's
+ * file. Commands only count as nick being there, their words aren't
+ * worth finding.
+ */
+void sr_add(int chan, time_t when, uint32_t off, const char *nick, int nicklen,
+		const char *text, int textlen)
+{
+	uint64_t hashes[SR_LINETERMS];
+	struct sr_mem_t *m;
+	struct sr_mpost_t *mp;
+	struct sr_slot_t *slot;
+	int i, n;
+
+	if (chan < 0 || !running)
+		return;
+
+	hashes[0] = sr_nickterm(nick, nicklen);
+	n = 1;
+	if (textlen > 0 && text[0] != '!')
+		n += sr_words(text, textlen, hashes + 1, SR_LINETERMS - 1);
+
+	for (i = 0; i < n; i++)
+		hashes[i] = sr_mix(hashes[i], chan);
+
+	pthread_rwlock_wrlock(&srlock);
+
+	m = &mems[cur];
+
+	if (m->nposts + n > SR_MEMPOSTS || m->nterms + n > SR_MEMTERMS * 3 / 4) {
+		/* still writing the last one out, this line goes unindexed */
+		if (frozen) {
+			pthread_rwlock_unlock(&srlock);
+			met_inc(MET_SEARCH_DROPPED);
+			return;
+		}
+
+		sr_freeze();
+		m = &mems[cur];
+	}
+
+	if (!m->slots && sr_memalloc(m) < 0) {
+		pthread_rwlock_unlock(&srlock);
+		met_inc(MET_SEARCH_DROPPED);
+		return;
+	}
+
+	if (m->nposts == 0)
+		m->since = now_ms();
+
+	for (i = 0; i < n; i++) {
+		slot = &m->slots[sr_memslot(m, hashes[i])];
+		if (slot->count++ == 0) {
+			slot->hash = hashes[i];
+			slot->head = -1;
+			m->nterms++;
+		}
+
+		mp = &m->posts[m->nposts];
+		mp->p.time = when;
+		mp->p.off = off;
+		mp->next = slot->head;
+		slot->head = m->nposts++;
+	}
+
+	pthread_rwlock_unlock(&srlock);
+
+	met_inc(MET_SEARCH_LINES);
+}
+
+/* sr_tick : hands the postings in memory to the indexer, if they're old enough */
+void sr_tick(uint64_t now)
+{
+	/* only the writer changes mems[cur], and we're it */
+	if (!running || mems[cur].nposts == 0 || now - mems[cur].since < SR_FLUSH_MS)
+		return;
+
+	pthread_rwlock_wrlock(&srlock);
+	if (!frozen)
+		sr_freeze();
+	pthread_rwlock_unlock(&srlock);
+}
+
+/*
+ * sr_grep : the newest lines (up to max of them) in the channel with the
+ * chat log key, that have every word of query in them, newest first
+ */
+int sr_grep(const char *key, const char *query, sr_hit_t *hits, int max)
+{
+	struct sr_list_t lists[SR_MAXTERMS];
+	uint64_t hashes[SR_MAXTERMS];
+	int i, n, src, nsrcs, chan, found;
+
+	if (!running || (n = sr_words(query, strlen(query), hashes, SR_MAXTERMS)) == 0)
+		return 0;
+
+	pthread_rwlock_rdlock(&srlock);
+
+	if ((chan = sr_findchan(key)) < 0) {
+		pthread_rwlock_unlock(&srlock);
+		return 0;
+	}
+
+	for (i = 0; i < n; i++)
+		hashes[i] = sr_mix(hashes[i], chan);
+
+	nsrcs = nsegs + (frozen ? 2 : 1);
+
+	for (src = 0, found = 0; src < nsrcs && found < max; src++) {
+		for (i = 0; i < n; i++)
+			sr_list(src, hashes[i], &lists[i]);
+
+		found += sr_intersect(lists, n, chan, hits + found, max - found);
+
+		for (i = 0; i < n; i++) {
+			if (lists[i].owned)
+				free(lists[i].posts);
+		}
+	}
+
+	pthread_rwlock_unlock(&srlock);
+
+	return found;
+}
+
+/* sr_seen : the last line nick said in the channel with the key, 1 if there is one */
+int sr_seen(const char *key, const char *nick, int nicklen, sr_hit_t *hit)
+{
+	struct sr_list_t list;
+	uint64_t hash;
+	int src, nsrcs, chan, found;
+
+	if (!running)
+		return 0;
+
+	pthread_rwlock_rdlock(&srlock);
+
+	if ((chan = sr_findchan(key)) < 0) {
+		pthread_rwlock_unlock(&srlock);
+		return 0;
+	}
+
+	hash = sr_mix(sr_nickterm(nick, nicklen), chan);
+	nsrcs = nsegs + (frozen ? 2 : 1);
+
+	for (src = 0, found = 0; src < nsrcs && !found; src++) {
+		sr_list(src, hash, &list);
+
+		if (list.n > 0) {
+			hit->time = list.posts[list.n - 1].time;
+			hit->off = list.posts[list.n - 1].off;
+			hit->chan = chan;
+			found = 1;
+		}
+
+		if (list.owned)
+			free(list.posts);
+	}
+
+	pthread_rwlock_unlock(&srlock);
+
+	return found;
+}
+
+/*
+ * sr_line : the line a hit points at, out of the day's .log or its frame of
+ * the .log.gz, into buf without the newline. -1 if it's not there (or not
+ * written out yet).
+ */
+int sr_line(sr_hit_t *hit, char *buf, int len)
+{
+	char key[PATH_MAX], path[PATH_MAX], date[16];
+	lz_index_t ix;
+	lz_frame_t *f;
+	struct tm tm;
+	time_t when;
+	char *raw, *nl;
+	int fd, n, lo, hi, mid;
+
+	pthread_rwlock_rdlock(&srlock);
+	n = hit->chan < nchans ? snprintf(key, sizeof(key), "%s", chans[hit->chan]) : -1;
+	pthread_rwlock_unlock(&srlock);
+
+	if (n < 0 || len < 2)
+		return -1;
+
+	when = hit->time;
+	localtime_r(&when, &tm);
+	strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+
+	/* with room for the .gz */
+	if (snprintf(path, sizeof(path), "%s/%s/%s.log", logdir, key, date) >= sizeof(path) - 3)
+		return -1;
+
+	n = -1;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) >= 0) {
+		n = pread(fd, buf, len - 1, hit->off);
+		close(fd);
+	} else if (lz_loadindex(path, &ix) == 0) {
+		/* the last frame starting at or before the line */
+		for (lo = 0, hi = ix.nframes; lo < hi;) {
+			mid = lo + (hi - lo) / 2;
+			if (ix.frames[mid].rawoff <= hit->off)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		f = lo > 0 ? &ix.frames[lo - 1] : NULL;
+		strcat(path, ".gz");
+
+		if (f && hit->off < f->rawoff + f->rawlen &&
+				(fd = open(path, O_RDONLY | O_CLOEXEC)) >= 0) {
+			if ((raw = malloc(f->rawlen)) && lz_readframe(fd, f, raw) >= 0) {
+				n = f->rawoff + f->rawlen - hit->off;
+				if (n > len - 1)
+					n = len - 1;
+				memcpy(buf, raw + (hit->off - f->rawoff), n);
+			}
+			free(raw);
+			close(fd);
+		}
+
+		lz_freeindex(&ix);
+	}
+
+	if (n <= 0)
+		return -1;
+
+	buf[n] = '\0';
+	if ((nl = memchr(buf, '\n', n)))
+		*nl = '\0';
+
+	return nl ? nl - buf : n;
+}
+
+/* sr_thread : the indexer, writes out frozen postings and merges segments */
+static void *sr_thread(void *arg)
+{
+	int stop;
+
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+
+	for (;;) {
+		pthread_mutex_lock(&wlock);
+		while (!pending && !stopping)
+			pthread_cond_wait(&wwake, &wlock);
+		pending = 0;
+		stop = stopping;
+		pthread_mutex_unlock(&wlock);
+
+		if (frozen)
+			sr_flush();
+
+		if (stop) {
+			/* the writer's gone, what it had left goes out too */
+			if (mems[cur].nposts > 0) {
+				pthread_rwlock_wrlock(&srlock);
+				sr_freeze();
+				pthread_rwlock_unlock(&srlock);
+				sr_flush();
+			}
+			break;
+		}
+
+		while (sr_merge() > 0)
+			;
+	}
+
+	return NULL;
+}
+
+/* sr_freeze : swaps the postings in memory for the empty set, srlock held */
+static void sr_freeze(void)
+{
+	frozen = 1;
+	cur ^= 1;
+
+	pthread_mutex_lock(&wlock);
+	pending = 1;
+	pthread_cond_signal(&wwake);
+	pthread_mutex_unlock(&wlock);
+}
+
+/* sr_flush : writes the frozen postings out as the newest segment */
+static void sr_flush(void)
+{
+	struct sr_build_t b;
+	struct sr_mem_t *m;
+	struct sr_slot_t *terms;
+	struct sr_post_t *buf;
+	struct sr_seg_t seg;
+	char path[PATH_MAX];
+	uint64_t gen;
+	int i, j, n, nterms, ok;
+
+	m = &mems[cur ^ 1];
+	ok = 0;
+
+	/* sr_pick always finds one this far past SR_MERGESEGS */
+	while (nsegs >= SR_MAXSEGS && sr_merge() > 0)
+		;
+
+	if (m->nposts > 0) {
+		gen = nextgen++;
+		sr_segpath(path, sizeof(path), gen, gen);
+
+		terms = malloc(m->nterms * sizeof(*terms));
+		buf = malloc(m->nposts * sizeof(*buf));
+
+		if (terms && buf && sr_buildopen(&b, path) == 0) {
+			for (i = 0, nterms = 0; i < SR_MEMTERMS; i++) {
+				if (m->slots[i].count)
+					terms[nterms++] = m->slots[i];
+			}
+			qsort(terms, nterms, sizeof(*terms), sr_slotcmp);
+
+			for (i = 0, ok = 1; i < nterms && ok; i++) {
+				for (n = 0, j = terms[i].head; j >= 0; j = m->posts[j].next)
+					buf[n++] = m->posts[j].p;
+				qsort(buf, n, sizeof(*buf), sr_keycmp);
+				ok = sr_buildterm(&b, terms[i].hash, buf, n) == 0;
+			}
+
+			ok = sr_buildclose(&b, path, ok) == 0 && sr_segload(&seg, gen, gen) == 0;
+		}
+
+		free(terms);
+		free(buf);
+
+		if (!ok)
+			FIO_PRINTF(FIO_WRN, "Couldn't Write Index Segment %s", path);
+	}
+
+	pthread_rwlock_wrlock(&srlock);
+
+	if (ok && nsegs < SR_MAXSEGS) {
+		segs[nsegs++] = seg;
+		met_inc(MET_SEARCH_FLUSHES);
+	} else if (ok) {
+		/* merges keep failing, the file's there for the next start */
+		munmap(seg.map, seg.size);
+		FIO_PRINTF(FIO_WRN, "Index is Full, Segment %s isn't Searchable", path);
+	}
+
+	if (m->slots)
+		memset(m->slots, 0, SR_MEMTERMS * sizeof(*m->slots));
+	m->nterms = 0;
+	m->nposts = 0;
+	frozen = 0;
+
+	pthread_rwlock_unlock(&srlock);
+}
+
+/*
+ * sr_merge : merges the SR_FANIN segments sr_pick chose into one, 1 if it
+ * did. Only the indexer changes segs, so it can read them without the
+ * lock, and only needs it to swap them.
+ */
+static int sr_merge(void)
+{
+	struct sr_build_t b;
+	struct sr_seg_t *in, seg;
+	struct sr_post_t *buf, *tmp;
+	struct sr_term_t *t;
+	char path[PATH_MAX];
+	uint64_t idx[SR_FANIN], min, n, cap;
+	int i, j, at, forced, ok, sorted;
+
+	if ((at = sr_pick(&forced)) < 0)
+		return 0;
+
+	in = &segs[at];
+
+	sr_segpath(path, sizeof(path), in[0].lo, in[SR_FANIN - 1].hi);
+
+	if (sr_buildopen(&b, path) < 0)
+		return -1;
+
+	memset(idx, 0, sizeof(idx));
+	buf = NULL;
+	cap = 0;
+
+	for (ok = 1; ok;) {
+		/* the smallest term left, out of every segment */
+		for (i = 0, j = -1, min = 0; i < SR_FANIN; i++) {
+			if (idx[i] < in[i].nterms && (j < 0 || in[i].terms[idx[i]].hash < min)) {
+				min = in[i].terms[idx[i]].hash;
+				j = i;
+			}
+		}
+
+		if (j < 0)
+			break;
+
+		/* older segments first, so it's usually sorted already */
+		for (i = 0, n = 0, sorted = 1; i < SR_FANIN; i++) {
+			if (idx[i] >= in[i].nterms || in[i].terms[idx[i]].hash != min)
+				continue;
+
+			t = &in[i].terms[idx[i]++];
+
+			if (n + t->count > cap) {
+				cap = (n + t->count) * 2;
+				if (!(tmp = realloc(buf, cap * sizeof(*buf)))) {
+					ok = 0;
+					break;
+				}
+				buf = tmp;
+			}
+
+			if (n > 0 && sr_keycmp(&buf[n - 1], &in[i].posts[t->first]) > 0)
+				sorted = 0;
+
+			memcpy(buf + n, in[i].posts + t->first, t->count * sizeof(*buf));
+			n += t->count;
+		}
+
+		if (!ok)
+			break;
+
+		if (!sorted)
+			qsort(buf, n, sizeof(*buf), sr_keycmp);
+
+		ok = sr_buildterm(&b, min, buf, n) == 0;
+	}
+
+	free(buf);
+
+	if (sr_buildclose(&b, path, ok) < 0 || sr_segload(&seg, in[0].lo, in[SR_FANIN - 1].hi) < 0) {
+		FIO_PRINTF(FIO_WRN, "Couldn't Merge Index Segments into %s", path);
+		return -1;
+	}
+
+	pthread_rwlock_wrlock(&srlock);
+
+	for (i = 0; i < SR_FANIN; i++) {
+		munmap(in[i].map, in[i].size);
+		sr_segpath(path, sizeof(path), in[i].lo, in[i].hi);
+		unlink(path);
+	}
+
+	segs[at] = seg;
+	memmove(&segs[at + 1], &segs[at + SR_FANIN],
+			(nsegs - at - SR_FANIN) * sizeof(*segs));
+	nsegs -= SR_FANIN - 1;
+
+	pthread_rwlock_unlock(&srlock);
+
+	met_inc(MET_SEARCH_MERGES);
+	if (forced)
+		met_inc(MET_SEARCH_FORCED);
+
+	return 1;
+}
+
+/*
+ * sr_pick : where the SR_FANIN segments to merge next start, -1 if none need
+ * it. The smallest size class with that many in a row goes first, newest
+ * first between equals. With none, and more than SR_MERGESEGS segments, the
+ * run with the fewest postings goes, and *forced says so.
+ */
+static int sr_pick(int *forced)
+{
+	uint64_t n, best;
+	int i, j, at, level, min, run;
+
+	*forced = 0;
+
+	if (nsegs < SR_FANIN)
+		return -1;
+
+	for (i = nsegs - 1, at = -1, min = INT_MAX, run = 0; i >= 0; i--) {
+		level = sr_level(&segs[i]);
+		run = i < nsegs - 1 && level == sr_level(&segs[i + 1]) ? run + 1 : 1;
+		if (run >= SR_FANIN && level < min) {
+			min = level;
+			at = i;
+		}
+	}
+
+	if (at >= 0 || nsegs <= SR_MERGESEGS)
+		return at;
+
+	for (i = 0, best = UINT64_MAX; i + SR_FANIN <= nsegs; i++) {
+		for (j = 0, n = 0; j < SR_FANIN; j++)
+			n += segs[i + j].nposts;
+		if (n < best) {
+			best = n;
+			at = i;
+		}
+	}
+
+	*forced = 1;
+
+	return at;
+}
+
+/* sr_level : a segment's size class, every level is SR_FANIN times the last */
+static int sr_level(struct sr_seg_t *s)
+{
+	uint64_t lim;
+	int level;
+
+	for (level = 0, lim = SR_BASE; s->nposts > lim; level++)
+		lim *= SR_FANIN;
+
+	return level;
+}
+
+/* sr_buildopen : starts a segment, it's written to a temporary name */
+static int sr_buildopen(struct sr_build_t *b, const char *path)
+{
+	struct sr_hdr_t hdr;
+
+	memset(b, 0, sizeof(*b));
+	snprintf(b->tmp, sizeof(b->tmp), "%s.tmp", path);
+
+	if (!(b->fp = fopen(b->tmp, "w")))
+		return -1;
+
+	/* the real one goes in at the end */
+	memset(&hdr, 0, sizeof(hdr));
+	if (fwrite(&hdr, sizeof(hdr), 1, b->fp) != 1) {
+		fclose(b->fp);
+		unlink(b->tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* sr_buildterm : adds a term and its postings, terms have to come in order */
+static int sr_buildterm(struct sr_build_t *b, uint64_t hash,
+		struct sr_post_t *posts, uint64_t n)
+{
+	struct sr_term_t *tmp;
+
+	if (b->nterms == b->cap) {
+		b->cap = b->cap ? b->cap * 2 : 1024;
+		if (!(tmp = realloc(b->terms, b->cap * sizeof(*tmp))))
+			return -1;
+		b->terms = tmp;
+	}
+
+	if (fwrite(posts, sizeof(*posts), n, b->fp) != n)
+		return -1;
+
+	b->terms[b->nterms].hash = hash;
+	b->terms[b->nterms].first = b->nposts;
+	b->terms[b->nterms].count = n;
+	b->nterms++;
+	b->nposts += n;
+
+	return 0;
+}
+
+/* sr_buildclose : writes the terms and the header, and renames it into place */
+static int sr_buildclose(struct sr_build_t *b, const char *path, int ok)
+{
+	static const char pad[8];
+	struct sr_hdr_t hdr;
+	long off;
+
+	off = ftell(b->fp);
+
+	memcpy(hdr.magic, SR_MAGIC, sizeof(hdr.magic));
+	hdr.nterms = b->nterms;
+	hdr.nposts = b->nposts;
+	hdr.termoff = (off + 7) & ~7L;
+
+	ok = ok && off >= 0 &&
+		fwrite(pad, 1, hdr.termoff - off, b->fp) == hdr.termoff - off &&
+		fwrite(b->terms, sizeof(*b->terms), b->nterms, b->fp) == b->nterms &&
+		fseek(b->fp, 0, SEEK_SET) == 0 &&
+		fwrite(&hdr, sizeof(hdr), 1, b->fp) == 1 &&
+		fflush(b->fp) == 0 && fdatasync(fileno(b->fp)) == 0;
+
+	fclose(b->fp);
+	free(b->terms);
+
+	if (!ok || rename(b->tmp, path) < 0) {
+		unlink(b->tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* sr_segload : maps the segment for flushes lo through hi */
+static int sr_segload(struct sr_seg_t *s, uint64_t lo, uint64_t hi)
+{
+	struct sr_hdr_t *hdr;
+	char path[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	memset(s, 0, sizeof(*s));
+	s->lo = lo;
+	s->hi = hi;
+
+	sr_segpath(path, sizeof(path), lo, hi);
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -1;
+	}
+
+	s->size = st.st_size;
+	s->map = mmap(NULL, s->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (s->map == MAP_FAILED)
+		return -1;
+
+	hdr = (struct sr_hdr_t *)s->map;
+
+	if (memcmp(hdr->magic, SR_MAGIC, sizeof(hdr->magic)) != 0 ||
+			hdr->termoff < sizeof(*hdr) + hdr->nposts * sizeof(struct sr_post_t) ||
+			hdr->termoff + hdr->nterms * sizeof(struct sr_term_t) != s->size) {
+		FIO_PRINTF(FIO_WRN, "Index Segment %s is Corrupt", path);
+		munmap(s->map, s->size);
+		return -1;
+	}
+
+	/* lookups jump around, don't read ahead for them */
+	madvise(s->map, s->size, MADV_RANDOM);
+
+	s->posts = (struct sr_post_t *)(s->map + sizeof(*hdr));
+	s->nposts = hdr->nposts;
+	s->terms = (struct sr_term_t *)(s->map + hdr->termoff);
+	s->nterms = hdr->nterms;
+
+	return 0;
+}
+
+/* sr_segpath : the file for flushes lo through hi */
+static void sr_segpath(char *buf, int len, uint64_t lo, uint64_t hi)
+{
+	snprintf(buf, len, "%s/seg-%016llx-%016llx.ix", srdir,
+			(unsigned long long)lo, (unsigned long long)hi);
+}
+
+/*
+ * sr_loadsegs : maps every segment in the index directory, oldest first.
+ * One that's covered by another is left from a merge that didn't finish
+ * cleaning up, and so is a .tmp.
+ */
+static int sr_loadsegs(void)
+{
+	struct dirent **names;
+	unsigned long long lo, hi;
+	char path[PATH_MAX];
+	uint64_t los[SR_MAXSEGS * 2], his[SR_MAXSEGS * 2], t;
+	int i, j, n, len, end, nfound;
+
+	if ((n = scandir(srdir, &names, NULL, alphasort)) < 0)
+		return -1;
+
+	for (i = 0, nfound = 0; i < n; i++) {
+		len = strlen(names[i]->d_name);
+		end = -1;
+
+		if (len > 4 && strcmp(names[i]->d_name + len - 4, ".tmp") == 0) {
+			snprintf(path, sizeof(path), "%s/%s", srdir, names[i]->d_name);
+			unlink(path);
+		} else if (sscanf(names[i]->d_name, "seg-%llx-%llx.ix%n", &lo, &hi, &end) == 2 &&
+				end == len && nfound < ARRSIZE(los)) {
+			los[nfound] = lo;
+			his[nfound] = hi;
+			nfound++;
+		}
+
+		free(names[i]);
+	}
+
+	free(names);
+
+	/* by where they start, and the widest first */
+	for (i = 1; i < nfound; i++) {
+		for (j = i; j > 0 && (los[j - 1] > los[j] ||
+					(los[j - 1] == los[j] && his[j - 1] < his[j])); j--) {
+			t = los[j], los[j] = los[j - 1], los[j - 1] = t;
+			t = his[j], his[j] = his[j - 1], his[j - 1] = t;
+		}
+	}
+
+	for (i = 0, nextgen = 0; i < nfound; i++) {
+		if (nsegs > 0 && los[i] <= segs[nsegs - 1].hi) {
+			sr_segpath(path, sizeof(path), los[i], his[i]);
+			unlink(path);
+			continue;
+		}
+
+		if (nsegs < SR_MAXSEGS && sr_segload(&segs[nsegs], los[i], his[i]) == 0)
+			nsegs++;
+
+		if (his[i] >= nextgen)
+			nextgen = his[i] + 1;
+	}
+
+	return 0;
+}
+
+/* sr_loadchans : reads the channel list, a line's number is its id */
+static int sr_loadchans(void)
+{
+	char path[PATH_MAX], line[PATH_MAX];
+	FILE *fp;
+	int slot;
+	char *nl;
+
+	snprintf(path, sizeof(path), "%s/chans", srdir);
+
+	if (!(fp = fopen(path, "r")))
+		return errno == ENOENT ? 0 : -1;
+
+	while (fgets(line, sizeof(line), fp) && nchans < SR_CHANSLOTS / 2) {
+		if ((nl = strchr(line, '\n')))
+			*nl = '\0';
+
+		/* keep the numbering even if a name turns up twice */
+		slot = sr_chanslot(line);
+		if (!(chans[nchans] = strdup(line)))
+			break;
+		if (!chanslots[slot])
+			chanslots[slot] = nchans + 1;
+		nchans++;
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+/* sr_chanslot : key's slot in the channel table, or the empty one it'd go in */
+static int sr_chanslot(const char *key)
+{
+	uint64_t h;
+	const char *p;
+	int i;
+
+	for (h = FNV_OFFSET, p = key; *p; p++)
+		h = (h ^ (unsigned char)*p) * FNV_PRIME;
+
+	for (i = h & (SR_CHANSLOTS - 1); chanslots[i]; i = (i + 1) & (SR_CHANSLOTS - 1)) {
+		if (strcmp(chans[chanslots[i] - 1], key) == 0)
+			break;
+	}
+
+	return i;
+}
+
+/* sr_findchan : the id of the channel with key, or -1, srlock held */
+static int sr_findchan(const char *key)
+{
+	return chanslots ? chanslots[sr_chanslot(key)] - 1 : -1;
+}
+
+/* sr_memalloc : the tables for postings in memory, they're big, so not until needed */
+static int sr_memalloc(struct sr_mem_t *m)
+{
+	m->slots = calloc(SR_MEMTERMS, sizeof(*m->slots));
+	m->posts = malloc(SR_MEMPOSTS * sizeof(*m->posts));
+
+	if (!m->slots || !m->posts) {
+		free(m->slots);
+		free(m->posts);
+		m->slots = NULL;
+		m->posts = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* sr_memslot : hash's slot in m, or the empty one it'd go in */
+static int sr_memslot(struct sr_mem_t *m, uint64_t hash)
+{
+	int i;
+
+	for (i = (hash ^ hash >> 29) & (SR_MEMTERMS - 1); m->slots[i].count;
+			i = (i + 1) & (SR_MEMTERMS - 1)) {
+		if (m->slots[i].hash == hash)
+			break;
+	}
+
+	return i;
+}
+
+/* sr_memlist : a sorted copy of hash's postings in m */
+static void sr_memlist(struct sr_mem_t *m, uint64_t hash, struct sr_list_t *l)
+{
+	struct sr_slot_t *slot;
+	int i;
+
+	memset(l, 0, sizeof(*l));
+
+	if (!m->slots || !(slot = &m->slots[sr_memslot(m, hash)])->count)
+		return;
+
+	if (!(l->posts = malloc(slot->count * sizeof(*l->posts))))
+		return;
+
+	for (i = slot->head; i >= 0; i = m->posts[i].next)
+		l->posts[l->n++] = m->posts[i].p;
+
+	qsort(l->posts, l->n, sizeof(*l->posts), sr_keycmp);
+	l->owned = 1;
+}
+
+/* sr_seglist : hash's postings in s, straight out of the map */
+static void sr_seglist(struct sr_seg_t *s, uint64_t hash, struct sr_list_t *l)
+{
+	uint64_t lo, hi, mid;
+
+	memset(l, 0, sizeof(*l));
+
+	for (lo = 0, hi = s->nterms; lo < hi;) {
+		mid = lo + (hi - lo) / 2;
+		if (s->terms[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < s->nterms && s->terms[lo].hash == hash) {
+		l->posts = s->posts + s->terms[lo].first;
+		l->n = s->terms[lo].count;
+	}
+}
+
+/*
+ * sr_list : hash's postings from source src, newest first: the postings
+ * still coming in, the ones being written out, then the segments
+ */
+static void sr_list(int src, uint64_t hash, struct sr_list_t *l)
+{
+	if (src == 0) {
+		sr_memlist(&mems[cur], hash, l);
+		return;
+	}
+
+	if (frozen && src == 1) {
+		sr_memlist(&mems[cur ^ 1], hash, l);
+		return;
+	}
+
+	src -= frozen ? 2 : 1;
+	sr_seglist(&segs[nsegs - 1 - src], hash, l);
+}
+
+/*
+ * sr_intersect : the postings in every list, as hits in chan, newest first,
+ * up to max. The shortest list is walked, and the rest binary searched.
+ */
+static int sr_intersect(struct sr_list_t *lists, int n, int chan,
+		sr_hit_t *hits, int max)
+{
+	struct sr_post_t *p;
+	uint64_t k;
+	int i, j, r, found;
+
+	for (i = 1, r = 0; i < n; i++) {
+		if (lists[i].n < lists[r].n)
+			r = i;
+	}
+
+	for (k = lists[r].n, found = 0; k-- > 0 && found < max;) {
+		p = &lists[r].posts[k];
+
+		for (j = 0; j < n; j++) {
+			if (j != r && !sr_contains(&lists[j], p))
+				break;
+		}
+
+		if (j == n) {
+			hits[found].time = p->time;
+			hits[found].off = p->off;
+			hits[found].chan = chan;
+			found++;
+		}
+	}
+
+	return found;
+}
+
+/* sr_contains : true if l has the posting p */
+static int sr_contains(struct sr_list_t *l, struct sr_post_t *p)
+{
+	uint64_t lo, hi, mid;
+	int c;
+
+	for (lo = 0, hi = l->n; lo < hi;) {
+		mid = lo + (hi - lo) / 2;
+		if ((c = sr_keycmp(&l->posts[mid], p)) == 0)
+			return 1;
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return 0;
+}
+
+/* sr_keycmp : postings in time order, then by place in the file */
+static int sr_keycmp(const void *a, const void *b)
+{
+	const struct sr_post_t *x = a, *y = b;
+
+	if (x->time != y->time)
+		return x->time < y->time ? -1 : 1;
+	if (x->off != y->off)
+		return x->off < y->off ? -1 : 1;
+	return 0;
+}
+
+/* sr_slotcmp : terms in hash order */
+static int sr_slotcmp(const void *a, const void *b)
+{
+	const struct sr_slot_t *x = a, *y = b;
+
+	return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+/*
+ * sr_words : hashes of the words in s, each once, up to max. A word is a
+ * run of letters and digits (anything not ASCII counts, so UTF-8 stays in
+ * one piece), at least 2 long, and case doesn't matter.
+ */
+static int sr_words(const char *s, int len, uint64_t *hashes, int max)
+{
+	uint64_t h;
+	unsigned char c;
+	int i, j, k, n;
+
+	for (i = 0, n = 0; i < len && n < max;) {
+		for (h = FNV_OFFSET, k = 0; i < len; i++, k++) {
+			c = s[i];
+			if (c >= 'A' && c <= 'Z')
+				c += 32;
+			else if (!(c >= 'a' && c <= 'z') && !(c >= '0' && c <= '9') && c < 0x80)
+				break;
+			if (k < SR_TERMLEN)
+				h = (h ^ c) * FNV_PRIME;
+		}
+
+		i++;
+
+		if (k < 2)
+			continue;
+
+		for (j = 0; j < n && hashes[j] != h; j++)
+			;
+		if (j == n)
+			hashes[n++] = h;
+	}
+
+	return n;
+}
+
+/* sr_nickterm : the term for a nick having said something, casemapped */
+static uint64_t sr_nickterm(const char *nick, int len)
+{
+	uint64_t h;
+	unsigned char c;
+	int i;
+
+	/* a 1 in front, no word starts with one */
+	h = (FNV_OFFSET ^ 1) * FNV_PRIME;
+
+	for (i = 0; i < len; i++) {
+		c = nick[i];
+		if (c >= 'A' && c <= '^')
+			c += 32;
+		h = (h ^ c) * FNV_PRIME;
+	}
+
+	return h;
+}
+
+/* sr_mix : a term, for just one channel */
+static uint64_t sr_mix(uint64_t hash, int chan)
+{
+	return hash ^ (uint64_t)(chan + 1) * 0x9e3779b97f4a7c15ull;
+}
@@ -0,0 +1,53 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 15:40
+ *
+ * Chat Log Search
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#define SR_DIR       ".index"  /* under the chat log directory */
+#define SR_MEMTERMS  (1 << 16) /* terms the newest postings can have, a power of two */
+#define SR_MEMPOSTS  (1 << 18) /* postings kept in memory before they're written */
+#define SR_FLUSH_MS  300000    /* and the longest they're kept */
+#define SR_BASE      (1 << 16) /* postings in a level 0 segment, at most */
+#define SR_FANIN     4         /* segments of one level that get merged */
+#define SR_MAXSEGS   128
+#define SR_CHANSLOTS (1 << 16) /* channels, a power of two, half can be used */
+#define SR_MAXTERMS  8         /* words a query looks at */
+#define SR_TERMLEN   32        /* longer words are only told apart this far */
+
+/* where a line is, in which day's file, the channel's in the term */
+struct sr_post_t {
+	uint32_t time;
+	uint32_t off;
+};
+
+/* a line a search turned up */
+struct sr_hit_t {
+	uint32_t time;
+	uint32_t off;
+	uint32_t chan;
+};
+
+typedef struct sr_hit_t sr_hit_t;
+
+int sr_open(const char *logdir);
+void sr_close(void);
+
+/* the chat log writer's, as it writes lines */
+int sr_chan(const char *key);
+void sr_add(int chan, time_t when, uint32_t off, const char *nick, int nicklen,
+		const char *text, int textlen);
+void sr_tick(uint64_t now);
+
+int sr_grep(const char *key, const char *query, sr_hit_t *hits, int max);
+int sr_seen(const char *key, const char *nick, int nicklen, sr_hit_t *hit);
+int sr_line(sr_hit_t *hit, char *buf, int len);
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 02:40
+ *
+ * Outbound Send Queue
+ *
+ * Every line we send gets queued here first, and sq_flush writes as many
+ * as it can in one writev. There are two lanes: control traffic (PONG,
+ * registration, JOINs) always goes first and is never held back, while
+ * everything else is paced by a token bucket shaped like the server's own
+ * flood limit, so we never give it a reason to kick us.
+ *
+ * Lines are charged to the pacer when their first byte gets written, so a
+ * line the kernel only took half of doesn't get charged twice. The rest of
+ * a line like that goes out before anything else, control or not, since
+ * the server can't tell where one line stops and the other starts.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "sendq.h"
+
+/* lines of one lane, in the order a flush gathered them */
+struct sq_run_t {
+	int lane;
+	int n;
+};
+
+static void sq_refill(sendq_t *sq, uint64_t now);
+static int sq_gather(sendq_t *sq, int lane, int from, int max,
+		struct iovec *iov, int *niov, int64_t *budget);
+static int sq_addiov(struct iovec *iov, struct sq_lane_t *l, int off, int n);
+
+/* sq_init : empties the queue, and fills the pacer up */
+void sq_init(sendq_t *sq, uint64_t now)
+{
+	memset(sq, 0, sizeof(*sq));
+
+	sq->burst_ms = SQ_BURST_MS;
+	sq->line_ms = SQ_LINE_MS;
+	sq->tokens = sq->burst_ms;
+	sq->refilled = now;
+}
+
+/* sq_setpace : changes the pacer, a burst_ms of 0 turns it off */
+void sq_setpace(sendq_t *sq, int burst_ms, int line_ms)
+{
+	sq->burst_ms = burst_ms;
+	sq->line_ms = line_ms;
+	sq->tokens = burst_ms;
+}
+
+/* sq_clear : throws out everything queued, keeps the counters */
+void sq_clear(sendq_t *sq)
+{
+	int i;
+
+	for (i = 0; i < SQ_LANES; i++) {
+		sq->lanes[i].head = 0;
+		sq->lanes[i].used = 0;
+		sq->lanes[i].lhead = 0;
+		sq->lanes[i].lcount = 0;
+		sq->lanes[i].sent = 0;
+	}
+
+	sq->depth = 0;
+}
+
+/* sq_push : queues a line on lane, -1 (and counted) if there's no room */
+int sq_push(sendq_t *sq, int lane, const char *line, int len, uint64_t now)
+{
+	struct sq_lane_t *l;
+	int tail, n;
+
+	l = &sq->lanes[lane];
+
+	if (len <= 0)
+		return 0;
+
+	if (l->lcount == SQ_MAXLINES || l->used + len > SQ_LANESIZE) {
+		sq->dropped++;
+		return -1;
+	}
+
+	/* the bytes might wrap around the end of the ring */
+	tail = (l->head + l->used) % SQ_LANESIZE;
+	n = SQ_LANESIZE - tail < len ? SQ_LANESIZE - tail : len;
+	memcpy(l->buf + tail, line, n);
+	memcpy(l->buf, line + n, len - n);
+	l->used += len;
+
+	l->lines[(l->lhead + l->lcount) % SQ_MAXLINES].len = len;
+	l->lines[(l->lhead + l->lcount) % SQ_MAXLINES].queued = now;
+	l->lcount++;
+
+	sq->queued++;
+	if (++sq->depth > sq->maxdepth)
+		sq->maxdepth = sq->depth;
+
+	return len;
+}
+
+/* sq_flush : writes what the pacer allows, returns bytes, 0 if it'd block */
+int sq_flush(sendq_t *sq, int fd, uint64_t now)
+{
+	struct iovec iov[SQ_MAXIOV];
+	struct sq_run_t runs[SQ_LANES + 1];
+	struct sq_lane_t *l;
+	struct sq_line_t *line;
+	int64_t budget;
+	int niov, nruns, lane, partial, r, i, left, rc;
+
+	sq_refill(sq, now);
+	budget = sq->tokens;
+	niov = 0;
+	nruns = 0;
+
+	/* finish a line the last write left halfway, only one lane can have one */
+	for (lane = 0, partial = -1; lane < SQ_LANES; lane++) {
+		if (sq->lanes[lane].lcount > 0 && sq->lanes[lane].sent > 0) {
+			runs[nruns].lane = partial = lane;
+			runs[nruns++].n = sq_gather(sq, lane, 0, 1, iov, &niov, &budget);
+		}
+	}
+
+	/* then whole lines, control lane first */
+	for (lane = 0; lane < SQ_LANES; lane++) {
+		runs[nruns].lane = lane;
+		runs[nruns++].n = sq_gather(sq, lane, lane == partial ? runs[0].n : 0,
+				SQ_MAXLINES, iov, &niov, &budget);
+	}
+
+	if (niov == 0)
+		return 0;
+
+	if ((rc = writev(fd, iov, niov)) < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		return -1;
+	}
+
+	if (rc > 0)
+		sq->writes++;
+
+	/* now retire what actually made it out, in the order it went */
+	for (r = 0, left = rc; r < nruns && left > 0; r++) {
+		l = &sq->lanes[runs[r].lane];
+
+		for (i = 0; i < runs[r].n && left > 0; i++) {
+			line = &l->lines[l->lhead];
+
+			if (l->sent == 0 && sq->burst_ms)
+				sq->tokens -= sq->line_ms;
+
+			if (left < line->len - l->sent) { /* partial write */
+				l->sent += left;
+				left = 0;
+				break;
+			}
+
+			left -= line->len - l->sent;
+
+			l->head = (l->head + line->len) % SQ_LANESIZE;
+			l->used -= line->len;
+			l->lhead = (l->lhead + 1) % SQ_MAXLINES;
+			l->lcount--;
+			l->sent = 0;
+
+			sq->sent++;
+			sq->depth--;
+			sq->latsum += now - line->queued;
+			if (now - line->queued > sq->latmax)
+				sq->latmax = now - line->queued;
+		}
+	}
+
+	return rc;
+}
+
+/* sq_wantwrite : returns true if sq_flush has something it could send now */
+int sq_wantwrite(sendq_t *sq, uint64_t now)
+{
+	struct sq_lane_t *l;
+
+	if (sq->lanes[SQ_CTRL].lcount > 0)
+		return 1;
+
+	l = &sq->lanes[SQ_NORMAL];
+
+	if (l->lcount == 0)
+		return 0;
+
+	if (!sq->burst_ms || l->sent > 0)
+		return 1;
+
+	sq_refill(sq, now);
+
+	return sq->tokens >= sq->line_ms;
+}
+
+/* sq_nextdue : ms until the pacer lets the next line go, -1 if none queued */
+int sq_nextdue(sendq_t *sq, uint64_t now)
+{
+	if (sq->lanes[SQ_CTRL].lcount == 0 && sq->lanes[SQ_NORMAL].lcount == 0)
+		return -1;
+
+	if (sq_wantwrite(sq, now))
+		return 0;
+
+	return sq->line_ms - sq->tokens;
+}
+
+/* sq_refill : tops the bucket up with the time that's passed */
+static void sq_refill(sendq_t *sq, uint64_t now)
+{
+	if (!sq->burst_ms || now <= sq->refilled)
+		return;
+
+	sq->tokens += now - sq->refilled;
+	if (sq->tokens > sq->burst_ms)
+		sq->tokens = sq->burst_ms;
+
+	sq->refilled = now;
+}
+
+/*
+ * sq_gather : adds up to max of lane's lines, from its from'th on, to iov,
+ * as far as the pacer and the iovecs go, returns how many it added
+ */
+static int sq_gather(sendq_t *sq, int lane, int from, int max,
+		struct iovec *iov, int *niov, int64_t *budget)
+{
+	struct sq_lane_t *l;
+	struct sq_line_t *line;
+	int i, off, skip;
+
+	l = &sq->lanes[lane];
+	off = l->head;
+
+	for (i = 0; i < from; i++)
+		off = (off + l->lines[(l->lhead + i) % SQ_MAXLINES].len) % SQ_LANESIZE;
+
+	/* lines can take two iovecs if they wrap */
+	for (; i < l->lcount && i - from < max && *niov <= SQ_MAXIOV - 2; i++) {
+		line = &l->lines[(l->lhead + i) % SQ_MAXLINES];
+		skip = i == 0 ? l->sent : 0;
+
+		if (sq->burst_ms && skip == 0) {
+			if (lane != SQ_CTRL && *budget < sq->line_ms)
+				break;
+			*budget -= sq->line_ms;
+		}
+
+		*niov += sq_addiov(iov + *niov, l, off + skip, line->len - skip);
+		off = (off + line->len) % SQ_LANESIZE;
+	}
+
+	return i - from;
+}
+
+/* sq_addiov : points iovecs at n bytes of the ring from off, returns count */
+static int sq_addiov(struct iovec *iov, struct sq_lane_t *l, int off, int n)
+{
+	off %= SQ_LANESIZE;
+
+	iov[0].iov_base = l->buf + off;
+
+	if (off + n <= SQ_LANESIZE) {
+		iov[0].iov_len = n;
+		return 1;
+	}
+
+	iov[0].iov_len = SQ_LANESIZE - off;
+	iov[1].iov_base = l->buf;
+	iov[1].iov_len = n - (SQ_LANESIZE - off);
+
+	return 2;
+}
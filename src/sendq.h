@@ -0,0 +1,77 @@
+#ifndef SENDQ_H
+#define SENDQ_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 02:40
+ *
+ * Outbound Send Queue
+ */
+
+#include <stdint.h>
+
+enum {
+	SQ_CTRL,   /* PONG, NICK, JOIN, ... skip the line, and aren't paced */
+	SQ_NORMAL, /* everything we say, paced to stay under the flood limit */
+	SQ_LANES
+};
+
+#define SQ_LANESIZE 8192 /* bytes of queued lines per lane */
+#define SQ_MAXLINES 128  /* lines per lane */
+#define SQ_MAXIOV   64   /* lines per writev */
+
+/*
+ * The classic ircd flood rule (RFC 1459, 8.10): every line pushes your
+ * penalty clock two seconds ahead, and once it's more than ten seconds
+ * ahead of the real clock you're excess flooding. That's a token bucket
+ * that holds ten seconds, where a line costs two.
+ */
+#define SQ_BURST_MS 10000
+#define SQ_LINE_MS  2000
+
+struct sq_line_t {
+	int len;
+	uint64_t queued; /* when it was pushed, for the drain latency */
+};
+
+struct sq_lane_t {
+	char buf[SQ_LANESIZE]; /* a ring of line bytes */
+	int head;
+	int used;
+	struct sq_line_t lines[SQ_MAXLINES]; /* a ring of line lengths */
+	int lhead;
+	int lcount;
+	int sent; /* bytes of the first line already written */
+};
+
+struct sendq_t {
+	struct sq_lane_t lanes[SQ_LANES];
+
+	/* the pacer, in milliseconds of flood budget */
+	int64_t tokens;
+	uint64_t refilled;
+	int burst_ms; /* 0 turns pacing off */
+	int line_ms;
+
+	/* counters */
+	int depth; /* lines queued right now, every lane */
+	int maxdepth;
+	unsigned long queued;
+	unsigned long sent;
+	unsigned long dropped;
+	unsigned long writes; /* writev calls that wrote something */
+	uint64_t latsum; /* ms between queued and fully written, summed */
+	uint64_t latmax;
+};
+
+typedef struct sendq_t sendq_t;
+
+void sq_init(sendq_t *sq, uint64_t now);
+void sq_setpace(sendq_t *sq, int burst_ms, int line_ms);
+void sq_clear(sendq_t *sq);
+int sq_push(sendq_t *sq, int lane, const char *line, int len, uint64_t now);
+int sq_flush(sendq_t *sq, int fd, uint64_t now);
+int sq_wantwrite(sendq_t *sq, uint64_t now);
+int sq_nextdue(sendq_t *sq, uint64_t now);
+
+#endif
@@ -14,44 +14,279 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <netdb.h>
+#include <fcntl.h>
+#include <errno.h>
 
+#include "socket.h"
+#include "metrics.h"
+#include "common.h"
+
+static void sck_raceorder(sck_race_t *r, struct addrinfo *res);
+static int sck_raceattempt(sck_race_t *r, uint64_t now);
+static void sck_racewon(sck_race_t *r, int i);
+
+/* get_socket : connects to host:port, with the default deadline */
 int get_socket(const char* host, const char* port)
 {
+	return sck_connect(host, port, SCK_DEADLINE_MS, NULL);
+}
+
+/* sck_resolve : getaddrinfo for a TCP client, res gets freeaddrinfo'd later */
+int sck_resolve(const char *host, const char *port, struct addrinfo **res)
+{
+	struct addrinfo hints;
+	uint64_t start;
 	int rc;
-	int s;
-	struct addrinfo hints, *res;
 
 	memset(&hints, 0, sizeof(hints));
 
 	hints.ai_family = AF_UNSPEC;
 	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_flags = AI_PASSIVE;
+	hints.ai_flags = AI_ADDRCONFIG;
+
+	start = now_us();
+	rc = getaddrinfo(host, port, &hints, res);
+
+	met_inc(MET_DNS_LOOKUPS);
+	met_observe(MET_H_DNS, now_us() - start);
 
-	if ((rc = getaddrinfo(host, port, &hints, &res)) < 0) {
+	if (rc != 0) {
 		fprintf(stderr, "getaddrinfo error: %s\n", gai_strerror(rc));
+		met_inc(MET_DNS_FAILURES);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* sck_connect : races every address for host:port, returns a non-blocking fd */
+int sck_connect(const char *host, const char *port, int deadline_ms, int *elapsed)
+{
+	struct pollfd pfds[SCK_MAXADDRS];
+	struct addrinfo *res;
+	sck_race_t race;
+	uint64_t start;
+	int rc, n, i;
+
+	start = now_ms();
+
+	if (sck_resolve(host, port, &res) < 0)
+		return -1;
+
+	sck_racestart(&race, res, start, deadline_ms);
+
+	while ((rc = sck_racestep(&race, now_ms())) == 0) {
+		/* sleep until an attempt finishes, or it's time for another one */
+		for (i = 0, n = 0; i < race.naddrs; i++) {
+			if (race.fds[i] >= 0) {
+				pfds[n].fd = race.fds[i];
+				pfds[n].events = POLLOUT;
+				n++;
+			}
+		}
+
+		if (poll(pfds, n, sck_racetimeout(&race, now_ms())) < 0 && errno != EINTR)
+			break;
+	}
+
+	sck_raceabort(&race);
+	freeaddrinfo(res);
+
+	if (rc <= 0) {
+		fprintf(stderr, "Couldn't connect: %s\n", strerror(race.err));
+		return -1;
+	}
+
+	if (elapsed)
+		*elapsed = now_ms() - start;
+
+	return race.fd;
+}
+
+/* sck_racestart : lines up the addresses in res, res has to outlive r */
+void sck_racestart(sck_race_t *r, struct addrinfo *res, uint64_t now, int deadline_ms)
+{
+	int i;
+
+	memset(r, 0, sizeof(*r));
+
+	for (i = 0; i < SCK_MAXADDRS; i++)
+		r->fds[i] = -1;
+
+	r->fd = -1;
+	r->err = ECONNREFUSED;
+	r->start = now;
+	r->deadline = now + deadline_ms;
+
+	sck_raceorder(r, res);
+}
+
+/* sck_racestep : moves the race along, 1 when r->fd is connected, -1 if lost */
+int sck_racestep(sck_race_t *r, uint64_t now)
+{
+	struct pollfd pfd;
+	socklen_t len;
+	int i, err;
+
+	if (r->fd >= 0)
+		return 1;
+
+	/* see if any attempt in flight finished */
+	for (i = 0; i < r->next; i++) {
+		if (r->fds[i] < 0)
+			continue;
+
+		pfd.fd = r->fds[i];
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, 0) <= 0)
+			continue;
+
+		len = sizeof(err);
+		if (getsockopt(r->fds[i], SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+			err = errno;
+
+		if (err == 0) {
+			sck_racewon(r, i);
+			return 1;
+		}
+
+		close(r->fds[i]);
+		r->fds[i] = -1;
+		r->inflight--;
+		r->err = err;
+	}
+
+	if (now >= r->deadline) {
+		sck_raceabort(r);
+		r->err = ETIMEDOUT;
+		met_inc(MET_CONNECT_FAILURES);
+		return -1;
+	}
+
+	/*
+	 * Start the next address once the last one's had its head start, or
+	 * right away if nothing's in flight anymore (RFC 8305, section 5).
+	 */
+	while (r->next < r->naddrs &&
+			(r->inflight == 0 || now - r->lastattempt >= SCK_STAGGER_MS)) {
+		if (sck_raceattempt(r, now) > 0)
+			return 1;
+		if (r->inflight > 0)
+			break;
+	}
+
+	if (r->inflight == 0 && r->next == r->naddrs) {
+		met_inc(MET_CONNECT_FAILURES);
 		return -1;
 	}
 
-	s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	return 0;
+}
+
+/* sck_racetimeout : ms until sck_racestep has something new to do */
+int sck_racetimeout(sck_race_t *r, uint64_t now)
+{
+	int64_t ms;
 
+	ms = (int64_t)(r->deadline - now);
+
+	if (r->next < r->naddrs && (int64_t)(r->lastattempt + SCK_STAGGER_MS - now) < ms)
+		ms = (int64_t)(r->lastattempt + SCK_STAGGER_MS - now);
+
+	return ms < 0 ? 0 : ms;
+}
+
+/* sck_raceabort : closes every attempt still in flight */
+void sck_raceabort(sck_race_t *r)
+{
+	int i;
+
+	for (i = 0; i < r->naddrs; i++) {
+		if (r->fds[i] >= 0)
+			close(r->fds[i]);
+		r->fds[i] = -1;
+	}
+
+	r->inflight = 0;
+}
+
+/* sck_raceorder : alternates address families, starting with the first one */
+static void sck_raceorder(sck_race_t *r, struct addrinfo *res)
+{
+	struct addrinfo *first[SCK_MAXADDRS], *other[SCK_MAXADDRS], *ai;
+	int nfirst, nother, i, j;
+
+	nfirst = nother = 0;
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		if (ai->ai_family == res->ai_family) {
+			if (nfirst < SCK_MAXADDRS)
+				first[nfirst++] = ai;
+		} else if (nother < SCK_MAXADDRS) {
+			other[nother++] = ai;
+		}
+	}
+
+	for (i = 0, j = 0; r->naddrs < SCK_MAXADDRS && (i < nfirst || j < nother); ) {
+		if (i < nfirst)
+			r->addrs[r->naddrs++] = first[i++];
+		if (j < nother && r->naddrs < SCK_MAXADDRS)
+			r->addrs[r->naddrs++] = other[j++];
+	}
+}
+
+/* sck_raceattempt : starts a connect to the next address, 1 if it's done */
+static int sck_raceattempt(sck_race_t *r, uint64_t now)
+{
+	struct addrinfo *ai;
+	int i, s;
+
+	i = r->next++;
+	ai = r->addrs[i];
+	r->lastattempt = now;
+
+	met_inc(MET_CONNECT_ATTEMPTS);
+
+	s = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			ai->ai_protocol);
 	if (s < 0) {
-		fprintf(stderr, "Couldn't get socket.\n");
-		goto error;
+		r->err = errno;
+		return -1;
 	}
 
-	if (connect(s, res->ai_addr, res->ai_addrlen) < 0) {
-		fprintf(stderr, "Couldn't connect.\n");
-		goto error;
+	r->fds[i] = s;
+	r->inflight++;
+
+	if (connect(s, ai->ai_addr, ai->ai_addrlen) == 0) {
+		sck_racewon(r, i);
+		return 1;
 	}
 
-	freeaddrinfo(res);
-	return s;
+	if (errno != EINPROGRESS) {
+		r->err = errno;
+		close(s);
+		r->fds[i] = -1;
+		r->inflight--;
+		return -1;
+	}
 
-error:
-	freeaddrinfo(res);
-	return -1;
+	return 0;
+}
+
+/* sck_racewon : keeps attempt i, and closes every other one */
+static void sck_racewon(sck_race_t *r, int i)
+{
+	r->fd = r->fds[i];
+	r->fds[i] = -1;
+	r->winner = r->addrs[i];
 
+	sck_raceabort(r);
+
+	met_observe(MET_H_CONNECT, (now_ms() - r->start) * 1000);
 }
 
 int sck_send(int s, const char* data, size_t size)
@@ -60,12 +295,16 @@ int sck_send(int s, const char* data, size_t size)
 	int rc;
 
 	for (written = 0, rc = 0; written < size; written += rc) {
-		rc = send(s, data + written, size - written, 0);
+		rc = send(s, data + written, size - written, MSG_NOSIGNAL);
 
 		if (rc <= 0)
 			return -1;
+
+		met_add(MET_TX_BYTES, rc);
 	}
 
+	met_inc(MET_TX_WRITES);
+
 	return written;
 }
 
@@ -95,14 +334,53 @@ int sck_sendf(int s, const char *fmt, ...)
 	return 0;
 }
 
+/* sck_trysend : sends what the socket will take now, 0 if it'd block */
+int sck_trysend(int s, const char* data, size_t size)
+{
+	int rc;
+
+	rc = send(s, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		return -1;
+	}
+
+	met_add(MET_TX_BYTES, rc);
+	met_inc(MET_TX_WRITES);
+
+	return rc;
+}
+
+/* sck_recv : receives into buffer, 0 if it'd block, -1 on close or error */
 int sck_recv(int s, char* buffer, size_t size)
 {
 	int rc;
 
 	rc = recv(s, buffer, size, 0);
-	if (rc <= 0)
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
 		return -1;
+	}
+
+	if (rc == 0) {
+		errno = ECONNRESET; /* orderly shutdown, still the end of us */
+		return -1;
+	}
+
+	met_add(MET_RX_BYTES, rc);
 
 	return rc;
 }
 
+/* sck_setnonblock : puts the socket in non-blocking mode */
+int sck_setnonblock(int s)
+{
+	int flags;
+
+	if ((flags = fcntl(s, F_GETFL, 0)) < 0)
+		return -1;
+
+	return fcntl(s, F_SETFL, flags | O_NONBLOCK);
+}
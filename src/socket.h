@@ -2,10 +2,42 @@
 #define IRC_SOCKET_H
 
 #include <stdlib.h>
+#include <stdint.h>
+
+#include <netdb.h>
+
+#define SCK_STAGGER_MS  250   /* head start each address gets, RFC 8305 */
+#define SCK_DEADLINE_MS 10000 /* default limit on the whole connect */
+#define SCK_MAXADDRS    16    /* addresses we'll try per host */
+
+/* a happy eyeballs connect in progress */
+struct sck_race_t {
+	struct addrinfo *addrs[SCK_MAXADDRS]; /* in the order we try them */
+	int naddrs;
+	int next;
+	int fds[SCK_MAXADDRS]; /* attempts in flight, -1 once they're done */
+	int inflight;
+	int fd; /* the winner */
+	struct addrinfo *winner;
+	int err; /* why the last attempt failed */
+	uint64_t start;
+	uint64_t lastattempt;
+	uint64_t deadline;
+};
+
+typedef struct sck_race_t sck_race_t;
 
 int get_socket(const char* host, const char* port);
+int sck_resolve(const char *host, const char *port, struct addrinfo **res);
+int sck_connect(const char *host, const char *port, int deadline_ms, int *elapsed);
+void sck_racestart(sck_race_t *r, struct addrinfo *res, uint64_t now, int deadline_ms);
+int sck_racestep(sck_race_t *r, uint64_t now);
+int sck_racetimeout(sck_race_t *r, uint64_t now);
+void sck_raceabort(sck_race_t *r);
 int sck_send(int socket, const char* data, size_t size);
 int sck_sendf(int socket, const char* fmt, ...);
+int sck_trysend(int socket, const char* data, size_t size);
 int sck_recv(int socket, char* buffer, size_t size);
+int sck_setnonblock(int socket);
 
 #endif
@@ -3,58 +3,38 @@
  * Mon Oct 01, 2018 20:00
  *
  * String extension functions. Things like regular expression parsing
- * regular expression functions taken and modified from
- * "The Practice of Programming"
+ * (which lives in regex.c these days)
  */
 
 #include <ctype.h>
+#include <stdio.h>
 #include <string.h>
 #include "string.h"
-
-static int re_matchhere(char *regexp, char *text);
-static int re_matchstar(int c, char *regexp, char *text);
+#include "regex.h"
+#include "stringext.h"
 
 /* re_match : search for regexp anywhere in text */
 int re_match(char *regexp, char *text)
 {
-	if (regexp[0] == '^') {
-		return re_matchhere(regexp + 1, text);
-	}
-
-	do {
-		if (re_matchhere(regexp, text))
-			return 1;
-	} while (*text++ != '\0');
-
-	return 0;
-}
-
-/* re_matchhere : search for regex at the beginning of text */
-static int re_matchhere(char *regexp, char *text)
-{
-	if (regexp[0] == '\0')
-		return 1;
+	/*
+	 * This used to be the recursive matcher out of "The Practice of
+	 * Programming", which could be made to go exponential by the right bit of
+	 * channel text. It's the linear time engine in regex.c now. Compiling on
+	 * every call keeps the old signature, anything hot should hang on to its
+	 * own re_t.
+	 */
 
-	if (regexp[1] == '*')
-		return re_matchstar(regexp[0], regexp + 2, text);
+	re_t re;
+	int rc;
 
-	if (regexp[0] == '$' && regexp[1] == '\0')
-		return *text == '\0';
+	if (re_compile(&re, regexp, 0) < 0)
+		return 0;
 
-	if (*text != '\0' && (regexp[0] == '.' || regexp[0] == *text))
-		return re_matchhere(regexp + 1, text + 1);
-	return 0;
-}
+	rc = re_exec(&re, text, strlen(text));
 
-/* re_matchstar : recursively match a star character */
-static int re_matchstar(int c, char *regexp, char *text)
-{
-	do { // a * matches zero or more instances
-		if (re_matchhere(regexp, text))
-			return 1;
-	} while (*text != '\0' && (*text++ == c || c == '.'));
+	re_free(&re);
 
-	return 0;
+	return rc;
 }
 
 /* bstrtok : Brian's (Better) strtok */
@@ -101,3 +81,69 @@ int strisupper(char *str)
 	return 1;
 }
 
+/*
+ * Which bytes go through untouched, a bit per encoding set (1 << URL_*).
+ * Everything in the RFC 3986 unreserved set passes in all of them. Paths
+ * also keep the sub-delims and ':' '@' '/', queries those and '?' too, and
+ * forms keep just the unreserved bytes, with ' ' written out as '+'.
+ */
+#define URL_ALL ((1 << URL_QUERY) | (1 << URL_PATH) | (1 << URL_FORM))
+#define URL_PQ  ((1 << URL_QUERY) | (1 << URL_PATH))
+
+static const unsigned char url_class[256] = {
+	['0' ... '9'] = URL_ALL,
+	['A' ... 'Z'] = URL_ALL,
+	['a' ... 'z'] = URL_ALL,
+	['-'] = URL_ALL, ['.'] = URL_ALL, ['_'] = URL_ALL, ['~'] = URL_ALL,
+	['!'] = URL_PQ, ['$'] = URL_PQ, ['&'] = URL_PQ, ['\''] = URL_PQ,
+	['('] = URL_PQ, [')'] = URL_PQ, ['*'] = URL_PQ, ['+'] = URL_PQ,
+	[','] = URL_PQ, [';'] = URL_PQ, ['='] = URL_PQ, [':'] = URL_PQ,
+	['@'] = URL_PQ, ['/'] = URL_PQ,
+	['?'] = 1 << URL_QUERY,
+	[' '] = 1 << URL_FORM,
+};
+
+static const char url_hex[] = "0123456789ABCDEF";
+
+/* url_encodelen : bytes url_encode needs for len bytes of src, no NUL */
+int url_encodelen(const char *src, int len, int set)
+{
+	const unsigned char *s;
+	int i, n;
+
+	s = (const unsigned char *)src;
+
+	for (i = 0, n = 0; i < len; i++)
+		n += url_class[s[i]] & (1 << set) ? 1 : 3;
+
+	return n;
+}
+
+/* url_encode : percent encodes src into buf, returns the length or -1 */
+int url_encode(char *buf, int buflen, const char *src, int len, int set)
+{
+	const unsigned char *s;
+	char *p;
+	int i, bit;
+
+	s = (const unsigned char *)src;
+	bit = 1 << set;
+
+	/* we know exactly how much we'll write, so there's no checking in the loop */
+	if (url_encodelen(src, len, set) >= buflen)
+		return -1;
+
+	for (i = 0, p = buf; i < len; i++) {
+		if (url_class[s[i]] & bit) {
+			*p++ = s[i] == ' ' ? '+' : s[i];
+		} else {
+			*p++ = '%';
+			*p++ = url_hex[s[i] >> 4];
+			*p++ = url_hex[s[i] & 0x0f];
+		}
+	}
+
+	*p = '\0';
+
+	return p - buf;
+}
@@ -6,5 +6,15 @@ int re_match(char *regexp, char *text);
 /* bstrtok : tokenize strings with other strings, reentrantly */
 char *bstrtok(char **str, char *delim);
 int strisupper(char *str);
+/* which bytes url_encode leaves alone */
+enum {
+	URL_QUERY, /* a whole query string, keeps '&', '=' and '+' */
+	URL_PATH,  /* a path, keeps '/' */
+	URL_FORM   /* one form value, only the unreserved bytes, ' ' is '+' */
+};
+
+/* url_encode : percent encodes len bytes of src into buf */
+int url_encode(char *buf, int buflen, const char *src, int len, int set);
+int url_encodelen(const char *src, int len, int set);
 
 #endif
@@ -0,0 +1,261 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 17:05
+ *
+ * Hierarchical Timing Wheel
+ *
+ * Every timer the process has, keepalives, reminders, table sweeps, lives in
+ * one of these, and the event loop sleeps until the soonest one's up.
+ *
+ * The deadline is split into bytes, and there's a level of 256 slots for
+ * each. A timer goes in the level of the highest byte where its deadline
+ * differs from the wheel's clock, in the slot for that byte, so adding and
+ * cancelling are a list link and a bit, however many are pending. When the
+ * clock gets to a slot, what's in it is within one slot of the level below,
+ * so it's handed down (cascaded) and the ones in a level 0 slot are due.
+ * A timer gets cascaded once per level at most, and most never leave the
+ * level they went in at.
+ *
+ * The lowest level with anything in it always has the soonest slot, and a
+ * bitmap per level finds that slot, so the loop's timeout is a couple of
+ * word scans too.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "wheel.h"
+
+static void tw_place(tw_t *tw, tw_timer_t *t);
+static void tw_link(tw_timer_t **head, tw_timer_t *t, int where);
+static void tw_unlink(tw_t *tw, tw_timer_t *t);
+static uint64_t tw_next(tw_t *tw, int *level, int *slot);
+static int tw_scan(const uint64_t *bits, int from);
+
+/* tw_init : an empty wheel, with its clock at now */
+void tw_init(tw_t *tw, uint64_t now)
+{
+	memset(tw, 0, sizeof(*tw));
+	pthread_mutex_init(&tw->lock, NULL);
+	tw->now = now;
+}
+
+/* tw_free : releases the wheel, the timers still in it belong to their owners */
+void tw_free(tw_t *tw)
+{
+	pthread_mutex_destroy(&tw->lock);
+	memset(tw, 0, sizeof(*tw));
+}
+
+/*
+ * tw_add : runs func(tw, t, arg) at when, from tw_advance. A pending t just
+ * moves, and a when that's already gone runs on the next advance. Safe from
+ * any thread, the loop just won't notice a sooner deadline until it wakes.
+ */
+void tw_add(tw_t *tw, tw_timer_t *t, uint64_t when, tw_func_t func, void *arg)
+{
+	pthread_mutex_lock(&tw->lock);
+
+	if (t->where != TW_IDLE)
+		tw_unlink(tw, t);
+	else
+		tw->count++;
+
+	t->when = when;
+	t->func = func;
+	t->arg = arg;
+	tw_place(tw, t);
+
+	pthread_mutex_unlock(&tw->lock);
+}
+
+/* tw_del : cancels t, true if it was still pending */
+int tw_del(tw_t *tw, tw_timer_t *t)
+{
+	pthread_mutex_lock(&tw->lock);
+
+	if (t->where == TW_IDLE) {
+		pthread_mutex_unlock(&tw->lock);
+		return 0;
+	}
+
+	tw_unlink(tw, t);
+	tw->count--;
+
+	pthread_mutex_unlock(&tw->lock);
+
+	return 1;
+}
+
+/* tw_timeout : ms from now until the wheel has work, at most max (-1, none) */
+int tw_timeout(tw_t *tw, uint64_t now, int max)
+{
+	uint64_t next, wait;
+	int level, slot;
+
+	pthread_mutex_lock(&tw->lock);
+	next = tw_next(tw, &level, &slot);
+	pthread_mutex_unlock(&tw->lock);
+
+	if (next == UINT64_MAX)
+		return max;
+
+	wait = next > now ? next - now : 0;
+	if (wait > INT_MAX)
+		wait = INT_MAX;
+
+	return max < 0 || wait < (uint64_t)max ? (int)wait : max;
+}
+
+/*
+ * tw_advance : moves the clock up to now, running every timer that's due on
+ * the way, without the lock held, so they can add and cancel timers. Returns
+ * how many ran.
+ */
+int tw_advance(tw_t *tw, uint64_t now)
+{
+	tw_timer_t *t, *list;
+	tw_func_t func;
+	uint64_t next;
+	void *arg;
+	int level, slot, n;
+
+	pthread_mutex_lock(&tw->lock);
+
+	for (n = 0;; ) {
+		while ((t = tw->due)) {
+			tw_unlink(tw, t);
+			tw->count--;
+			tw->fired++;
+			n++;
+
+			/* t's its owner's again, it may well be freed in here */
+			func = t->func;
+			arg = t->arg;
+			pthread_mutex_unlock(&tw->lock);
+			func(tw, t, arg);
+			pthread_mutex_lock(&tw->lock);
+		}
+
+		if ((next = tw_next(tw, &level, &slot)) > now)
+			break;
+
+		tw->now = next;
+
+		list = tw->slots[level][slot];
+		tw->slots[level][slot] = NULL;
+		tw->bits[level][slot / 64] &= ~((uint64_t)1 << (slot % 64));
+
+		/* all of these are due inside the slot, the levels below sort them */
+		while ((t = list)) {
+			list = t->next;
+			tw_place(tw, t);
+			tw->cascaded++;
+		}
+	}
+
+	if (tw->now < now)
+		tw->now = now;
+
+	pthread_mutex_unlock(&tw->lock);
+
+	return n;
+}
+
+/* tw_place : puts t in the slot its deadline belongs in, relative to the clock */
+static void tw_place(tw_t *tw, tw_timer_t *t)
+{
+	int level, slot;
+
+	if (t->when <= tw->now) {
+		tw_link(&tw->due, t, TW_DUE);
+		return;
+	}
+
+	level = (63 - __builtin_clzll(t->when ^ tw->now)) / TW_BITS;
+	slot = (t->when >> (level * TW_BITS)) & (TW_SLOTS - 1);
+
+	tw_link(&tw->slots[level][slot], t, level * TW_SLOTS + slot + 1);
+	tw->bits[level][slot / 64] |= (uint64_t)1 << (slot % 64);
+}
+
+/* tw_link : pushes t on the front of a slot's list */
+static void tw_link(tw_timer_t **head, tw_timer_t *t, int where)
+{
+	t->next = *head;
+	if (t->next)
+		t->next->pprev = &t->next;
+	t->pprev = head;
+	*head = t;
+	t->where = where;
+}
+
+/* tw_unlink : takes t out of whatever list it's in, and idles it */
+static void tw_unlink(tw_t *tw, tw_timer_t *t)
+{
+	int level, slot;
+
+	*t->pprev = t->next;
+	if (t->next)
+		t->next->pprev = t->pprev;
+
+	if (t->where != TW_DUE) {
+		level = (t->where - 1) / TW_SLOTS;
+		slot = (t->where - 1) % TW_SLOTS;
+		if (!tw->slots[level][slot])
+			tw->bits[level][slot / 64] &= ~((uint64_t)1 << (slot % 64));
+	}
+
+	t->next = NULL;
+	t->pprev = NULL;
+	t->where = TW_IDLE;
+}
+
+/*
+ * tw_next : when the clock gets to the next slot with anything in it, and
+ * which one, UINT64_MAX if the wheel's empty. A level's slots are all ahead
+ * of the clock's byte for it, and all before the next slot of the level
+ * above, so the lowest level with anything wins.
+ */
+static uint64_t tw_next(tw_t *tw, int *level, int *slot)
+{
+	uint64_t base;
+	int l, s, cur;
+
+	if (tw->due)
+		return tw->now;
+
+	for (l = 0; l < TW_LEVELS; l++) {
+		cur = (tw->now >> (l * TW_BITS)) & (TW_SLOTS - 1);
+		if ((s = tw_scan(tw->bits[l], cur + 1)) < 0)
+			continue;
+
+		base = l == TW_LEVELS - 1 ? 0 :
+			tw->now & ~(((uint64_t)1 << ((l + 1) * TW_BITS)) - 1);
+
+		*level = l;
+		*slot = s;
+
+		return base | (uint64_t)s << (l * TW_BITS);
+	}
+
+	return UINT64_MAX;
+}
+
+/* tw_scan : the first slot from from on with anything in it, -1 if none */
+static int tw_scan(const uint64_t *bits, int from)
+{
+	uint64_t m;
+	int w;
+
+	for (w = from / 64; w < TW_SLOTS / 64; w++) {
+		m = bits[w];
+		if (w == from / 64)
+			m &= ~(uint64_t)0 << (from % 64);
+		if (m)
+			return w * 64 + __builtin_ctzll(m);
+	}
+
+	return -1;
+}
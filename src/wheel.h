@@ -0,0 +1,62 @@
+#ifndef WHEEL_H
+#define WHEEL_H
+
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 17:05
+ *
+ * Hierarchical Timing Wheel
+ */
+
+#include <stdint.h>
+
+#include <pthread.h>
+
+#define TW_BITS   8
+#define TW_SLOTS  (1 << TW_BITS)  /* per level, a byte of the deadline */
+#define TW_LEVELS (64 / TW_BITS)  /* enough for any uint64_t ms */
+#define TW_IDLE   0               /* where a timer that isn't pending is */
+#define TW_DUE    (TW_LEVELS * TW_SLOTS + 1) /* and one that's ready to run */
+
+struct tw_t;
+struct tw_timer_t;
+
+typedef void (*tw_func_t)(struct tw_t *tw, struct tw_timer_t *t, void *arg);
+
+/*
+ * a timer, embedded in whatever it's for, the wheel never allocates one. A
+ * zeroed one is idle.
+ */
+struct tw_timer_t {
+	struct tw_timer_t *next;
+	struct tw_timer_t **pprev;
+	uint64_t when; /* ms, on the now_ms() clock */
+	tw_func_t func;
+	void *arg;
+	int where;     /* level * TW_SLOTS + slot + 1, TW_DUE or TW_IDLE */
+};
+
+struct tw_t {
+	pthread_mutex_t lock; /* timers get added from the command workers too */
+	uint64_t now;         /* everything up to here has been run */
+	struct tw_timer_t *slots[TW_LEVELS][TW_SLOTS];
+	struct tw_timer_t *due;
+	uint64_t bits[TW_LEVELS][TW_SLOTS / 64]; /* which slots have anything */
+	unsigned long count;
+
+	/* counters */
+	unsigned long fired;
+	unsigned long cascaded;
+};
+
+typedef struct tw_timer_t tw_timer_t;
+typedef struct tw_t tw_t;
+
+void tw_init(tw_t *tw, uint64_t now);
+void tw_free(tw_t *tw);
+void tw_add(tw_t *tw, tw_timer_t *t, uint64_t when, tw_func_t func, void *arg);
+int tw_del(tw_t *tw, tw_timer_t *t);
+int tw_timeout(tw_t *tw, uint64_t now, int max);
+int tw_advance(tw_t *tw, uint64_t now);
+
+#endif
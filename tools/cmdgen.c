@@ -0,0 +1,427 @@
+/*
+ * Brian Chrzanowski
+ * Sat Oct 17, 2026 22:50
+ *
+ * Bot Command Table Generator
+ *
+ * USAGE: cmdgen [-p prefix] [-i header] botcmd.def > botcmd_tab.c
+ *
+ * Reads the command definitions (see src/botcmd.def) and writes out the C
+ * table for them, along with a perfect hash over every name and alias so
+ * looking a command up is two hashes and a memcmp, however long the table
+ * gets.
+ *
+ * The hash is "hash and displace": every key lands in a bucket with one
+ * hash, then each bucket (biggest first) gets a seed picked so all of its
+ * keys land in empty slots under the seeded hash. Lookup is
+ *
+ *     slot = phash(key, disp[phash(key, 0) % nbuckets]) % nslots
+ *
+ * which can only ever be the right key or a miss.
+ *
+ * The rate lines become the rates table, the limits for each rate class.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+
+#include "../src/phash.h"
+
+#define MAXTOK 512
+#define MAXSEED 1000000
+#define MAXRATES 16
+
+struct cmd_t {
+	char name[MAXTOK];
+	char func[MAXTOK];
+	char usage[MAXTOK];
+	char rate[MAXTOK];
+	int minargs;
+	int maxargs;
+};
+
+/* one rate class's limits, bursts and the ms to earn another */
+struct rate_t {
+	char class[MAXTOK];
+	int user_burst, user_ms;
+	int chan_burst, chan_ms;
+};
+
+struct key_t {
+	char name[MAXTOK];
+	int cmd; /* which command this name (or alias) resolves to */
+	int bucket;
+};
+
+static struct cmd_t *cmds;
+static struct key_t *keys;
+static int ncmds, nkeys;
+static struct rate_t rates[MAXRATES];
+static int nrates;
+
+static int parse_def(FILE *fp, char *path);
+static int next_tok(char **p, char *buf);
+static int add_key(char *name, int cmd);
+static int build(int nslots, int nbuckets, uint32_t *disp, int *slots);
+
+int main(int argc, char **argv)
+{
+	FILE *fp;
+	char *prefix, *header, *path, *p;
+	uint32_t *disp;
+	int *slots;
+	int nslots, nbuckets, i;
+
+	prefix = "irc";
+	header = "botcmd.h";
+	path = NULL;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			prefix = argv[++i];
+		} else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			header = argv[++i];
+		} else {
+			path = argv[i];
+		}
+	}
+
+	if (!path) {
+		fprintf(stderr, "USAGE: %s [-p prefix] [-i header] file.def\n", argv[0]);
+		return 1;
+	}
+
+	if (!(fp = fopen(path, "r"))) {
+		fprintf(stderr, "%s: couldn't open %s\n", argv[0], path);
+		return 1;
+	}
+
+	if (parse_def(fp, path) < 0) {
+		fclose(fp);
+		return 1;
+	}
+
+	fclose(fp);
+
+	/* keep the slots ~80% full, grow them if we can't find the seeds */
+	for (nslots = nkeys + nkeys / 4 + 1; ; nslots += nslots / 8 + 1) {
+		nbuckets = nkeys / 4 + 1;
+		disp = calloc(nbuckets, sizeof(*disp));
+		slots = malloc(nslots * sizeof(*slots));
+
+		if (!disp || !slots) {
+			fprintf(stderr, "%s: out of memory\n", argv[0]);
+			return 1;
+		}
+
+		if (build(nslots, nbuckets, disp, slots) == 0)
+			break;
+
+		free(disp);
+		free(slots);
+	}
+
+	printf("/* generated by tools/cmdgen from %s, don't edit */\n\n", path);
+	printf("#include <string.h>\n\n");
+	printf("#include \"phash.h\"\n");
+	printf("#include \"%s\"\n\n", header);
+
+	printf("struct ircrate_t %srates[CMD_RATES] = {\n", prefix);
+	for (i = 0; i < nrates; i++) {
+		for (p = rates[i].class; *p; p++)
+			*p = toupper(*p);
+		printf("\t[CMD_RATE_%s] = {{%d, %d}, {%d, %d}},\n", rates[i].class,
+				rates[i].user_burst, rates[i].user_ms,
+				rates[i].chan_burst, rates[i].chan_ms);
+	}
+	if (nrates == 0) /* no limits on anything */
+		printf("\t{{0, 0}, {0, 0}},\n");
+	printf("};\n\n");
+
+	printf("struct ircfunc_t %sfuncs[] = {\n", prefix);
+	for (i = 0; i < ncmds; i++) {
+		for (p = cmds[i].rate; *p; p++)
+			*p = toupper(*p);
+		printf("\t{\"%s\", \"%s\", %s, %d, %d, CMD_RATE_%s},\n",
+				cmds[i].name, cmds[i].usage, cmds[i].func,
+				cmds[i].minargs, cmds[i].maxargs, cmds[i].rate);
+	}
+	printf("};\n\n");
+	printf("int %sfuncs_len = %d;\n\n", prefix, ncmds);
+
+	printf("static const uint32_t %sfuncs_disp[%d] = {", prefix, nbuckets);
+	for (i = 0; i < nbuckets; i++)
+		printf("%s%u", i == 0 ? "\n\t" : i % 8 ? ", " : ",\n\t", disp[i]);
+	printf("\n};\n\n");
+
+	printf("static const struct {\n\tconst char *name;\n\tint len;\n"
+			"\tint func;\n} %sfuncs_keys[%d] = {\n", prefix, nslots);
+	for (i = 0; i < nslots; i++) {
+		if (slots[i] < 0) {
+			printf("\t{NULL, -1, 0},\n");
+		} else {
+			printf("\t{\"%s\", %d, %d},\n", keys[slots[i]].name,
+					(int)strlen(keys[slots[i]].name), keys[slots[i]].cmd);
+		}
+	}
+	printf("};\n\n");
+
+	printf("/* %sfunc_lookup : finds a command or alias, NULL if there isn't one */\n", prefix);
+	printf("struct ircfunc_t *%sfunc_lookup(const char *name, int len)\n", prefix);
+	printf("{\n");
+	printf("\tuint32_t d, slot;\n\n");
+	printf("\td = %sfuncs_disp[phash(name, len, 0) %% %d];\n", prefix, nbuckets);
+	printf("\tslot = phash(name, len, d) %% %d;\n\n", nslots);
+	printf("\tif (%sfuncs_keys[slot].len != len ||\n", prefix);
+	printf("\t\t\tmemcmp(%sfuncs_keys[slot].name, name, len) != 0)\n", prefix);
+	printf("\t\treturn NULL;\n\n");
+	printf("\treturn &%sfuncs[%sfuncs_keys[slot].func];\n", prefix, prefix);
+	printf("}\n");
+
+	free(disp);
+	free(slots);
+	free(cmds);
+	free(keys);
+
+	return 0;
+}
+
+/* parse_def : reads every cmd and alias line out of the definition file */
+static int parse_def(FILE *fp, char *path)
+{
+	char line[MAXTOK * 4], tok[MAXTOK], tok2[MAXTOK], *p;
+	char nums[4][MAXTOK];
+	struct cmd_t *cmd;
+	struct rate_t *rate;
+	int lineno, i;
+
+	for (lineno = 1; fgets(line, sizeof(line), fp); lineno++) {
+		p = line;
+
+		if (!next_tok(&p, tok) || tok[0] == '#')
+			continue;
+
+		if (strcmp(tok, "cmd") == 0) {
+			cmds = realloc(cmds, (ncmds + 1) * sizeof(*cmds));
+			cmd = &cmds[ncmds];
+
+			if (!next_tok(&p, cmd->name) || !next_tok(&p, cmd->func) ||
+					!next_tok(&p, tok) || !next_tok(&p, tok2) ||
+					!next_tok(&p, cmd->rate) || !next_tok(&p, cmd->usage)) {
+				fprintf(stderr, "%s:%d: want cmd <name> <handler> <minargs> "
+						"<maxargs> <rate> \"<usage>\"\n", path, lineno);
+				return -1;
+			}
+
+			cmd->minargs = atoi(tok);
+			cmd->maxargs = atoi(tok2);
+
+			if (add_key(cmd->name, ncmds) < 0) {
+				fprintf(stderr, "%s:%d: \"%s\" defined twice\n",
+						path, lineno, cmd->name);
+				return -1;
+			}
+
+			ncmds++;
+
+		} else if (strcmp(tok, "alias") == 0) {
+			if (!next_tok(&p, tok) || !next_tok(&p, tok2)) {
+				fprintf(stderr, "%s:%d: want alias <name> <command>\n",
+						path, lineno);
+				return -1;
+			}
+
+			for (i = 0; i < ncmds; i++) {
+				if (strcmp(cmds[i].name, tok2) == 0)
+					break;
+			}
+
+			if (i == ncmds) {
+				fprintf(stderr, "%s:%d: alias for unknown command \"%s\"\n",
+						path, lineno, tok2);
+				return -1;
+			}
+
+			if (add_key(tok, i) < 0) {
+				fprintf(stderr, "%s:%d: \"%s\" defined twice\n",
+						path, lineno, tok);
+				return -1;
+			}
+
+		} else if (strcmp(tok, "rate") == 0) {
+			if (nrates == MAXRATES) {
+				fprintf(stderr, "%s:%d: too many rates\n", path, lineno);
+				return -1;
+			}
+
+			rate = &rates[nrates];
+
+			if (!next_tok(&p, rate->class) || !next_tok(&p, nums[0]) ||
+					!next_tok(&p, nums[1]) || !next_tok(&p, nums[2]) ||
+					!next_tok(&p, nums[3])) {
+				fprintf(stderr, "%s:%d: want rate <class> <user burst> <user ms> "
+						"<chan burst> <chan ms>\n", path, lineno);
+				return -1;
+			}
+
+			rate->user_burst = atoi(nums[0]);
+			rate->user_ms = atoi(nums[1]);
+			rate->chan_burst = atoi(nums[2]);
+			rate->chan_ms = atoi(nums[3]);
+			nrates++;
+
+		} else {
+			fprintf(stderr, "%s:%d: unknown directive \"%s\"\n",
+					path, lineno, tok);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* next_tok : copies the next word, or "quoted string" (sans quotes), to buf */
+static int next_tok(char **p, char *buf)
+{
+	char *s;
+	int len;
+
+	s = *p;
+
+	while (isspace(*s))
+		s++;
+
+	if (*s == '\0')
+		return 0;
+
+	len = 0;
+
+	if (*s == '"') {
+		for (s++; *s && *s != '"' && len < MAXTOK - 1; s++) {
+			if (*s == '\\' && s[1])
+				buf[len++] = *s++;
+			buf[len++] = *s;
+		}
+		if (*s == '"')
+			s++;
+	} else {
+		while (*s && !isspace(*s) && len < MAXTOK - 1)
+			buf[len++] = *s++;
+	}
+
+	buf[len] = '\0';
+	*p = s;
+
+	return 1;
+}
+
+/* add_key : adds a name to the hash keys, -1 if it's already there */
+static int add_key(char *name, int cmd)
+{
+	int i;
+
+	for (i = 0; i < nkeys; i++) {
+		if (strcmp(keys[i].name, name) == 0)
+			return -1;
+	}
+
+	keys = realloc(keys, (nkeys + 1) * sizeof(*keys));
+	snprintf(keys[nkeys].name, sizeof(keys[nkeys].name), "%s", name);
+	keys[nkeys].cmd = cmd;
+	nkeys++;
+
+	return 0;
+}
+
+/* build : finds a seed for every bucket, -1 if some bucket can't be placed */
+static int build(int nslots, int nbuckets, uint32_t *disp, int *slots)
+{
+	int *order, *start, *members, *pending;
+	int i, j, k, b, n, slot, ok;
+	uint32_t d;
+
+	order = malloc(nbuckets * sizeof(*order));
+	start = calloc(nbuckets + 1, sizeof(*start));
+	members = malloc((nkeys + 1) * sizeof(*members));
+	pending = malloc((nkeys + 1) * sizeof(*pending));
+
+	for (i = 0; i < nslots; i++)
+		slots[i] = -1;
+
+	/* group the keys by bucket, members[start[b] .. start[b + 1]] */
+	for (i = 0; i < nkeys; i++) {
+		keys[i].bucket = phash(keys[i].name, strlen(keys[i].name), 0) % nbuckets;
+		start[keys[i].bucket + 1]++;
+	}
+
+	for (i = 0; i < nbuckets; i++)
+		start[i + 1] += start[i];
+
+	for (i = 0; i < nbuckets; i++)
+		order[i] = start[i];
+
+	for (i = 0; i < nkeys; i++)
+		members[order[keys[i].bucket]++] = i;
+
+	/* biggest buckets first, while there's the most room to place them */
+	for (i = 0; i < nbuckets; i++)
+		order[i] = i;
+
+#define BSIZE(x) (start[(x) + 1] - start[(x)])
+	for (i = 1; i < nbuckets; i++) {
+		for (j = i; j > 0 && BSIZE(order[j - 1]) < BSIZE(order[j]); j--) {
+			k = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = k;
+		}
+	}
+
+	ok = 0;
+
+	for (i = 0; i < nbuckets && BSIZE(order[i]) > 0; i++) {
+		b = order[i];
+
+		for (d = 1; d < MAXSEED; d++) {
+			for (j = start[b], n = 0; j < start[b + 1]; j++) {
+				slot = phash(keys[members[j]].name,
+						strlen(keys[members[j]].name), d) % nslots;
+
+				/* taken by an earlier bucket, or by this one */
+				if (slots[slot] >= 0)
+					break;
+				for (k = 0; k < n; k++) {
+					if (pending[k] == slot)
+						break;
+				}
+				if (k < n)
+					break;
+
+				pending[n++] = slot;
+			}
+
+			if (j == start[b + 1])
+				break;
+		}
+
+		if (d == MAXSEED) {
+			ok = -1;
+			break;
+		}
+
+		disp[b] = d;
+
+		for (j = start[b], n = 0; j < start[b + 1]; j++)
+			slots[pending[n++]] = members[j];
+	}
+#undef BSIZE
+
+	free(order);
+	free(start);
+	free(members);
+	free(pending);
+
+	return ok;
+}
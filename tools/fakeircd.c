@@ -0,0 +1,419 @@
+/*
+ * Brian Chrzanowski
+ * Sun Oct 18, 2026 05:20
+ *
+ * Loopback IRC Server Stand-In
+ *
+ * USAGE: fakeircd [-p port] [-f script] [-n lines] [-r rate] [-k probes]
+ *                 [-c channel] [-t tag]
+ *
+ * Waits for one bot to connect, registers it, and lets it join. Then it
+ * replays traffic at the bot: the lines of script over and over, or a
+ * built-in mix of channel chatter, commands and server noise, n lines in
+ * all, at rate lines/sec (0 is as fast as the bot takes them). Spread
+ * through that are k "!ping" probes, and the time until each "pong" comes
+ * back is the command latency.
+ *
+ * The last thing sent is a PING, and since the bot answers those in order
+ * with everything else it reads, its PONG marks the point where every line
+ * has gone through the bot's read and parse path. That's the throughput.
+ *
+ * Results go to stdout as tag.key=value lines, so they diff.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define MAXLINE   512
+#define MAXSCRIPT 65536      /* lines we'll take from a script */
+#define MAXPROBES 1000000
+#define OUTSIZE   (1 << 20)  /* bytes we keep ahead of the bot */
+#define INSIZE    (64 << 10)
+#define DRAIN_MS  5000       /* wait for stragglers after the last PONG */
+
+#define DONETOKEN "fakeircd-done"
+
+static char *builtin[] = {
+	":alice!a@example.com PRIVMSG %s :hello there, how is everyone doing today",
+	":bob!b@example.com PRIVMSG %s :did anyone see the game last night, it was something else",
+	":carol!c@example.com PRIVMSG %s :I think the build is broken again, can someone look",
+	":dave!d@example.com NOTICE %s :this is a notice, the bot ignores these",
+	":erin!e@example.com JOIN %s",
+	":alice!a@example.com PRIVMSG %s :lol",
+	":frank!f@example.com PART %s :gone fishing",
+	":irc.example.com 372 bench :- a message of the day line the bot doesn't care about",
+	":bob!b@example.com PRIVMSG %s :!8ball will the benchmark finish",
+	":carol!c@example.com PRIVMSG %s :a longer line, the kind of thing people paste into a channel when they're trying to explain a stack trace to someone who isn't listening"
+};
+
+static char **script;
+static int nscript;
+
+static char outbuf[OUTSIZE];
+static int outhead, outlen;
+static char inbuf[INSIZE];
+static int inlen;
+
+static uint64_t *probes; /* send times of the probes still waiting */
+static uint64_t *lat;    /* the latencies of the ones that came back */
+static int probehead, probetail, nlat;
+static int gotdone;
+static int welcomed, joined;
+static char *chan;
+
+static uint64_t now_us(void);
+static int load_script(char *path);
+static int serve(int port);
+static int handshake(int fd, char *channel);
+static int queue_line(char *line);
+static int pump(int fd, int timeout);
+static void on_line(char *line);
+static int cmp_u64(const void *a, const void *b);
+static uint64_t pct(double p);
+
+int main(int argc, char **argv)
+{
+	char line[MAXLINE], *channel, *path, *tag;
+	uint64_t start, end, due, t;
+	long nlines, nprobes, every, sent, rate;
+	int port, fd, i;
+
+	port = 16667;
+	path = NULL;
+	nlines = 100000;
+	nprobes = 1000;
+	rate = 0;
+	channel = "#bench";
+	tag = "bench";
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			port = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			path = argv[++i];
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			nlines = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			rate = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			nprobes = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			channel = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			tag = argv[++i];
+		} else {
+			fprintf(stderr, "USAGE: %s [-p port] [-f script] [-n lines] "
+					"[-r rate] [-k probes] [-c channel] [-t tag]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (nprobes > MAXPROBES)
+		nprobes = MAXPROBES;
+	if (nprobes > nlines)
+		nprobes = nlines;
+
+	if (path && load_script(path) < 0) {
+		fprintf(stderr, "Couldn't read script %s\n", path);
+		return 1;
+	}
+
+	probes = calloc(nprobes + 1, sizeof(*probes));
+	lat = calloc(nprobes + 1, sizeof(*lat));
+
+	if (!probes || !lat || (fd = serve(port)) < 0)
+		return 1;
+
+	if (handshake(fd, channel) < 0) {
+		fprintf(stderr, "The bot never registered.\n");
+		return 1;
+	}
+
+	every = nprobes ? nlines / nprobes : 0;
+	start = now_us();
+
+	for (sent = 0; sent < nlines; sent++) {
+		/* hold off until the schedule says this line's due */
+		if (rate > 0) {
+			due = start + sent * 1000000 / rate;
+			while ((t = now_us()) < due) {
+				if (pump(fd, (due - t) / 1000) < 0)
+					goto lost;
+			}
+		}
+
+		if (every && sent % every == 0 && probetail < nprobes) {
+			snprintf(line, sizeof(line),
+					":prober!p@example.com PRIVMSG %s :!ping", channel);
+			probes[probetail++] = now_us();
+		} else if (nscript) {
+			snprintf(line, sizeof(line), "%s", script[sent % nscript]);
+		} else {
+			snprintf(line, sizeof(line),
+					builtin[sent % (sizeof(builtin) / sizeof(builtin[0]))], channel);
+		}
+
+		/* out of room means the bot's behind, let it catch up */
+		while (queue_line(line) < 0) {
+			if (pump(fd, 100) < 0)
+				goto lost;
+		}
+
+		/* keep reading, a bot that can't write its replies stalls */
+		if ((sent % 64 == 0 || outlen > OUTSIZE / 2) && pump(fd, 0) < 0)
+			goto lost;
+	}
+
+	queue_line("PING :" DONETOKEN);
+
+	while (!gotdone) {
+		if (pump(fd, 1000) < 0)
+			goto lost;
+	}
+
+	end = now_us();
+
+	/* replies to commands come back from the bot's workers, maybe after */
+	while (probehead < probetail && now_us() < end + DRAIN_MS * 1000) {
+		if (pump(fd, 100) < 0)
+			break;
+	}
+
+	qsort(lat, nlat, sizeof(*lat), cmp_u64);
+
+	printf("%s.lines=%ld\n", tag, nlines);
+	printf("%s.rate=%ld\n", tag, rate);
+	printf("%s.seconds=%.3f\n", tag, (end - start) / 1e6);
+	printf("%s.lines_per_sec=%.0f\n", tag, nlines / ((end - start) / 1e6));
+	printf("%s.ping.sent=%d\n", tag, probetail);
+	printf("%s.ping.answered=%d\n", tag, nlat);
+	printf("%s.ping.p50_us=%llu\n", tag, (unsigned long long)pct(0.50));
+	printf("%s.ping.p90_us=%llu\n", tag, (unsigned long long)pct(0.90));
+	printf("%s.ping.p99_us=%llu\n", tag, (unsigned long long)pct(0.99));
+	printf("%s.ping.max_us=%llu\n", tag, (unsigned long long)pct(1.00));
+
+	close(fd);
+	return 0;
+
+lost:
+	fprintf(stderr, "Lost the bot after %ld lines.\n", sent);
+	close(fd);
+	return 1;
+}
+
+/* now_us : monotonic microseconds */
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* load_script : reads the traffic to replay, one line a line */
+static int load_script(char *path)
+{
+	char line[MAXLINE];
+	FILE *fp;
+	int len;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+
+	script = calloc(MAXSCRIPT, sizeof(*script));
+
+	while (script && nscript < MAXSCRIPT && fgets(line, sizeof(line), fp)) {
+		len = strcspn(line, "\r\n");
+		line[len] = '\0';
+
+		if (len > 0)
+			script[nscript++] = strdup(line);
+	}
+
+	fclose(fp);
+
+	return nscript > 0 ? 0 : -1;
+}
+
+/* serve : waits for the bot on 127.0.0.1:port */
+static int serve(int port)
+{
+	struct sockaddr_in addr;
+	int ls, fd, one;
+
+	if ((ls = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return -1;
+
+	one = 1;
+	setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(ls, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(ls, 1) < 0) {
+		fprintf(stderr, "Couldn't listen on %d: %s\n", port, strerror(errno));
+		close(ls);
+		return -1;
+	}
+
+	fd = accept(ls, NULL, NULL);
+	close(ls);
+
+	if (fd < 0)
+		return -1;
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	return fd;
+}
+
+/* handshake : welcomes the bot, and waits for it to join the channel */
+static int handshake(int fd, char *channel)
+{
+	uint64_t end;
+
+	chan = channel;
+	end = now_us() + 10000000;
+
+	while (!joined && now_us() < end) {
+		if (pump(fd, 100) < 0)
+			return -1;
+	}
+
+	return joined ? 0 : -1;
+}
+
+/* queue_line : adds a line (and CRLF) to the output, -1 if there's no room */
+static int queue_line(char *line)
+{
+	int len;
+
+	len = strlen(line);
+
+	if (outhead + outlen + len + 2 > OUTSIZE) {
+		memmove(outbuf, outbuf + outhead, outlen);
+		outhead = 0;
+	}
+
+	if (outlen + len + 2 > OUTSIZE)
+		return -1;
+
+	memcpy(outbuf + outhead + outlen, line, len);
+	memcpy(outbuf + outhead + outlen + len, "\r\n", 2);
+	outlen += len + 2;
+
+	return 0;
+}
+
+/* pump : writes what the bot takes, reads what it says, for up to timeout ms */
+static int pump(int fd, int timeout)
+{
+	struct pollfd pfd;
+	char *p, *eol;
+	int rc;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN | (outlen ? POLLOUT : 0);
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, timeout) < 0)
+		return errno == EINTR ? 0 : -1;
+
+	if (pfd.revents & POLLOUT) {
+		if ((rc = write(fd, outbuf + outhead, outlen)) < 0) {
+			if (errno != EAGAIN && errno != EINTR)
+				return -1;
+		} else {
+			outhead += rc;
+			outlen -= rc;
+			if (outlen == 0)
+				outhead = 0;
+		}
+	}
+
+	if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+		if ((rc = read(fd, inbuf + inlen, sizeof(inbuf) - inlen)) <= 0) {
+			if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+				return 0;
+			return -1;
+		}
+		inlen += rc;
+
+		for (p = inbuf; (eol = memchr(p, '\n', inlen - (p - inbuf))) != NULL; p = eol + 1) {
+			*eol = '\0';
+			if (eol > p && eol[-1] == '\r')
+				eol[-1] = '\0';
+			on_line(p);
+		}
+
+		memmove(inbuf, p, inlen - (p - inbuf));
+		inlen -= p - inbuf;
+	}
+
+	return 0;
+}
+
+/* on_line : handles one line from the bot */
+static void on_line(char *line)
+{
+	char reply[MAXLINE];
+
+	if (strncmp(line, "USER ", 5) == 0 && !welcomed) {
+		queue_line(":irc.example.com 001 bench :Welcome to the bench");
+		welcomed = 1;
+	} else if (strncmp(line, "JOIN ", 5) == 0) {
+		snprintf(reply, sizeof(reply), ":bench!b@example.com JOIN %s", chan);
+		queue_line(reply);
+		joined = 1;
+	} else if (strncmp(line, "PING ", 5) == 0) {
+		snprintf(reply, sizeof(reply), "PONG %s", line + 5);
+		queue_line(reply);
+	} else if (strncmp(line, "PONG ", 5) == 0 && strstr(line, DONETOKEN)) {
+		gotdone = 1;
+	} else if (strncmp(line, "PRIVMSG ", 8) == 0 && strstr(line, " :pong")) {
+		/* the bot answers probes in order, so this is the oldest one */
+		if (probehead < probetail)
+			lat[nlat++] = now_us() - probes[probehead++];
+	}
+}
+
+/* cmp_u64 : qsort comparison */
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x, y;
+
+	x = *(const uint64_t *)a;
+	y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* pct : the p'th percentile latency, 0 if none came back */
+static uint64_t pct(double p)
+{
+	int i;
+
+	if (nlat == 0)
+		return 0;
+
+	i = p * nlat;
+	if (i >= nlat)
+		i = nlat - 1;
+
+	return lat[i];
+}